@@ -0,0 +1,248 @@
+#include <new>
+#include <cstdlib>
+#include "../include/arena-defs.hpp"
+
+/**
+ * Heap allocations are counted per thread by replacing the global
+ * operator new. The count is a thread local increment, cheap enough to be
+ * made in every build
+ **/
+static thread_local long thread_allocations = 0;
+
+void *operator new(size_t size)
+{
+    thread_allocations++;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+long allocation_count()
+{
+    return thread_allocations;
+}
+
+static thread_local MessageArena *current_arena = NULL;
+
+MessageArena::MessageArena(size_t size)
+    : buffer(size > 0 ? size : 1),
+      resource(buffer.data(), buffer.size())
+{
+    allocated = 0;
+    allocations = 0;
+}
+
+void *MessageArena::allocate(size_t bytes, size_t alignment)
+{
+    allocated += bytes;
+    allocations++;
+    return resource.allocate(bytes, alignment);
+}
+
+void MessageArena::reset()
+{
+    resource.release();
+    allocated = 0;
+    allocations = 0;
+}
+
+size_t MessageArena::used()
+{
+    return allocated;
+}
+
+long MessageArena::blocks()
+{
+    return allocations;
+}
+
+MessageArena *MessageArena::current()
+{
+    return current_arena;
+}
+
+ArenaScope::ArenaScope(MessageArena *a)
+{
+    arena = a;
+    previous = current_arena;
+    current_arena = a;
+}
+
+ArenaScope::~ArenaScope()
+{
+    current_arena = previous;
+    if (arena != NULL)
+    {
+        arena->reset();
+    }
+}
+
+MessageStats::MessageStats()
+{
+    messages = 0;
+    allocations = 0;
+    max_allocations = 0;
+    arena_allocations = 0;
+    max_arena_bytes = 0;
+}
+
+void MessageStats::record(long message_allocations, long arena_blocks, size_t arena_bytes)
+{
+    messages++;
+    allocations += message_allocations;
+    arena_allocations += arena_blocks;
+    long max = max_allocations.load();
+    while (message_allocations > max && !max_allocations.compare_exchange_weak(max, message_allocations))
+    {
+    }
+    long bytes = (long)arena_bytes;
+    max = max_arena_bytes.load();
+    while (bytes > max && !max_arena_bytes.compare_exchange_weak(max, bytes))
+    {
+    }
+}
+
+json MessageStats::to_json()
+{
+    json result;
+    long n = messages.load();
+    result["messages"] = n;
+    result["allocationsPerMessage"] = n > 0 ? (double)allocations.load() / n : 0.0;
+    result["maxAllocations"] = max_allocations.load();
+    result["arenaAllocationsPerMessage"] = n > 0 ? (double)arena_allocations.load() / n : 0.0;
+    result["maxArenaBytes"] = max_arena_bytes.load();
+    return result;
+}
+
+/**
+ * Reads a point ({"coordinates":[...]}) reserving its coordinates at once
+ **/
+static bool point_from_json(const arena_json &node, Point &point)
+{
+    arena_json::const_iterator coordinates = node.find("coordinates");
+    if (!node.is_object() || coordinates == node.end() || !coordinates->is_array())
+    {
+        return false;
+    }
+    point.coordinates.reserve(coordinates->size());
+    for (const arena_json &c : *coordinates)
+    {
+        if (!c.is_number())
+        {
+            return false;
+        }
+        point.coordinates.push_back(c.get<double>());
+    }
+    return true;
+}
+
+/**
+ * Reads a trace context from its node (TraceContext::from_json), without
+ * leaving the arena. The integer fields that are missing stay 0
+ **/
+static TraceContext trace_from_json(const arena_json &node)
+{
+    TraceContext result = TraceContext();
+    const char *names[] = {"seq", "clientSent", "received", "receivedMonotonic", "dispatched",
+                           "motionStarted", "motionEnded", "published"};
+    long long *fields[] = {&result.seq, &result.client_sent, &result.received, &result.received_monotonic,
+                           &result.dispatched, &result.motion_started, &result.motion_ended, &result.published};
+    for (int i = 0; i < 8; i++)
+    {
+        arena_json::const_iterator field = node.find(names[i]);
+        if (field != node.end() && field->is_number_integer())
+        {
+            *fields[i] = field->get<long long>();
+        }
+    }
+    return result;
+}
+
+bool command_from_json(const arena_json &message, CommandObject &command)
+{
+    if (!message.is_object())
+    {
+        return false;
+    }
+    arena_json::const_iterator signal = message.find("signal");
+    if (signal == message.end() || !signal->is_number_integer())
+    {
+        return false;
+    }
+    command.signal = (CommandsSignal)signal->get<int>();
+
+    arena_json::const_iterator client = message.find("client");
+    if (client != message.end())
+    {
+        arena_json::const_iterator id = client->is_object() ? client->find("id") : client->end();
+        if (id == client->end() || !id->is_string())
+        {
+            return false;
+        }
+        command.client.id = id->get_ref<const std::string &>();
+    }
+
+    arena_json::const_iterator trace = message.find("trace");
+    if (trace != message.end())
+    {
+        arena_json::const_iterator seq = trace->is_object() ? trace->find("seq") : trace->end();
+        if (seq == trace->end() || !seq->is_number_integer())
+        {
+            return false;
+        }
+        command.trace = trace_from_json(*trace);
+    }
+
+    arena_json::const_iterator point = message.find("point");
+    if (point != message.end())
+    {
+        return point_from_json(*point, command.point);
+    }
+
+    arena_json::const_iterator trajectory = message.find("trajectory");
+    if (trajectory != message.end())
+    {
+        arena_json::const_iterator points = trajectory->is_object() ? trajectory->find("points") : trajectory->end();
+        if (points == trajectory->end() || !points->is_array())
+        {
+            return false;
+        }
+        for (const arena_json &node : *points)
+        {
+            command.trajectory.points.push_back(Point());
+            if (!point_from_json(node, command.trajectory.points.back()))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#include <cstring>
+#include <iostream>
+#include "../include/capture-defs.hpp"
+
+SessionCapture::SessionCapture()
+{
+    captured = 0;
+    file = NULL;
+    running = false;
+}
+
+SessionCapture::~SessionCapture()
+{
+    close();
+}
+
+bool SessionCapture::open(const std::string &path)
+{
+    close();
+    file = fopen(path.c_str(), "wbx");
+    if (file == NULL)
+    {
+        std::cout << "Cannot create capture file " << path << " (it must not exist)" << std::endl;
+        return false;
+    }
+
+    CaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.started_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+    fwrite(&header, sizeof(header), 1, file);
+    fflush(file);
+
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        started = std::chrono::steady_clock::now();
+        pending.clear();
+    }
+    running = true;
+    writer = std::thread(&SessionCapture::write_loop, this);
+
+    std::cout << "Capturing messages into " << path << std::endl;
+    return true;
+}
+
+bool SessionCapture::is_open()
+{
+    return running.load(std::memory_order_relaxed);
+}
+
+void SessionCapture::record(const char *topic, const void *payload, size_t length)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(pending_mutex);
+    if (!running.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    CaptureRecord record;
+    record.time_us = std::chrono::duration_cast<std::chrono::microseconds>(now - started).count();
+    record.topic_length = strlen(topic);
+    record.payload_length = payload == NULL ? 0 : length;
+    pending.append((const char *)&record, sizeof(record));
+    pending.append(topic, record.topic_length);
+    if (record.payload_length > 0)
+    {
+        pending.append((const char *)payload, record.payload_length);
+    }
+    captured++;
+}
+
+void SessionCapture::write_loop()
+{
+    while (running.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(CAPTURE_FLUSH_MS));
+        flush();
+    }
+}
+
+void SessionCapture::flush()
+{
+    // the buffer is swapped, so messages are recorded while the file is written
+    std::string writing;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        writing.swap(pending);
+    }
+    if (!writing.empty())
+    {
+        fwrite(writing.data(), 1, writing.size(), file);
+        fflush(file);
+    }
+}
+
+void SessionCapture::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if (!running.exchange(false))
+        {
+            return;
+        }
+    }
+    writer.join();
+
+    // messages recorded after the last flush of the writer
+    flush();
+    fclose(file);
+    file = NULL;
+}
+
+bool read_capture_header(FILE *file, CaptureHeader &header)
+{
+    return fread(&header, sizeof(header), 1, file) == 1 &&
+           memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) == 0;
+}
+
+bool read_captured_message(FILE *file, CapturedMessage &message)
+{
+    CaptureRecord record;
+    if (fread(&record, sizeof(record), 1, file) != 1)
+    {
+        return false;
+    }
+    message.time_us = record.time_us;
+    message.topic.resize(record.topic_length);
+    message.payload.resize(record.payload_length);
+    return fread(&message.topic[0], 1, record.topic_length, file) == record.topic_length &&
+           fread(&message.payload[0], 1, record.payload_length, file) == record.payload_length;
+}
@@ -0,0 +1,273 @@
+#include <cmath>
+#include <cstring>
+#include "../include/codec-defs.hpp"
+
+CodecInfo compact_codec()
+{
+    CodecInfo result = CodecInfo();
+    result.name = CODEC_NAME;
+    result.version = CODEC_VERSION;
+    for (size_t j = 0; j < EDScorbotModel::joints; j++)
+    {
+        // one reference of the joint (angle_to_ref), if it has references
+        result.resolution.push_back(EDScorbotModel::actionable(j) ? std::fabs(EDScorbotModel::ref_to_angle(j, 1))
+                                                                  : CODEC_DEFAULT_RESOLUTION);
+    }
+    return result;
+}
+
+bool is_encoded(const void *payload, size_t length)
+{
+    return length >= 2 && ((const unsigned char *)payload)[0] == CODEC_MAGIC;
+}
+
+static void put_varint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static void put_signed(std::string &out, int64_t value)
+{
+    // zigzag: small negative and positive values take few bytes
+    put_varint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/**
+ * A cursor over an encoded payload. Every read checks the end of the payload
+ **/
+struct CodecReader
+{
+    const unsigned char *next;
+    const unsigned char *end;
+
+    bool byte(uint8_t &value)
+    {
+        if (next == end)
+        {
+            return false;
+        }
+        value = *next++;
+        return true;
+    }
+
+    bool varint(uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (next == end)
+            {
+                return false;
+            }
+            uint8_t b = *next++;
+            value |= (uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool zigzag(int64_t &value)
+    {
+        uint64_t raw;
+        if (!varint(raw))
+        {
+            return false;
+        }
+        value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+        return true;
+    }
+
+    bool bytes(void *out, size_t length)
+    {
+        if ((size_t)(end - next) < length)
+        {
+            return false;
+        }
+        memcpy(out, next, length);
+        next += length;
+        return true;
+    }
+};
+
+static void put_header(std::string &out, int kind)
+{
+    out.push_back((char)CODEC_MAGIC);
+    out.push_back((char)kind);
+}
+
+static void put_client(std::string &out, const Client &client, bool error)
+{
+    out.push_back(error ? 1 : 0);
+    put_varint(out, client.id.size());
+    out.append(client.id);
+}
+
+static bool put_points(std::string &out, const std::list<Point> &points, const CodecInfo &codec)
+{
+    size_t joints = points.empty() ? 0 : points.front().coordinates.size();
+    put_varint(out, joints);
+    put_varint(out, points.size());
+
+    std::vector<double> resolution = std::vector<double>(joints);
+    for (size_t j = 0; j < joints; j++)
+    {
+        // quantized with the same (float) resolution read by the decoder
+        float r = j < codec.resolution.size() ? codec.resolution[j] : CODEC_DEFAULT_RESOLUTION;
+        out.append((const char *)&r, sizeof(r));
+        resolution[j] = r;
+    }
+
+    std::vector<int64_t> previous = std::vector<int64_t>(joints, 0);
+    for (const Point &p : points)
+    {
+        if (p.coordinates.size() != joints)
+        {
+            return false;
+        }
+        for (size_t j = 0; j < joints; j++)
+        {
+            int64_t q = std::llround(p.coordinates[j] / resolution[j]);
+            put_signed(out, q - previous[j]);
+            previous[j] = q;
+        }
+    }
+    return true;
+}
+
+static bool read_client(CodecReader &in, Client &client, bool &error)
+{
+    uint8_t e;
+    uint64_t length;
+    if (!in.byte(e) || !in.varint(length) || (uint64_t)(in.end - in.next) < length)
+    {
+        return false;
+    }
+    error = e != 0;
+    client.id.assign((const char *)in.next, length);
+    in.next += length;
+    return true;
+}
+
+static bool read_points(CodecReader &in, std::list<Point> &points)
+{
+    uint64_t joints;
+    uint64_t count;
+    // every coordinate takes at least one byte
+    if (!in.varint(joints) || !in.varint(count) || joints > 64 ||
+        (count > 0 && (uint64_t)(in.end - in.next) / (joints > 0 ? joints : 1) < count))
+    {
+        return false;
+    }
+
+    std::vector<double> resolution = std::vector<double>(joints);
+    for (size_t j = 0; j < joints; j++)
+    {
+        float r;
+        if (!in.bytes(&r, sizeof(r)))
+        {
+            return false;
+        }
+        resolution[j] = r;
+    }
+
+    std::vector<int64_t> current = std::vector<int64_t>(joints, 0);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        points.push_back(Point());
+        std::vector<double> &coordinates = points.back().coordinates;
+        coordinates.resize(joints);
+        for (size_t j = 0; j < joints; j++)
+        {
+            int64_t delta;
+            if (!in.zigzag(delta))
+            {
+                return false;
+            }
+            current[j] += delta;
+            coordinates[j] = current[j] * resolution[j];
+        }
+    }
+    return true;
+}
+
+bool encode_command(CommandObject &command, const CodecInfo &codec, std::string &payload)
+{
+    payload.clear();
+    put_header(payload, CODEC_COMMAND);
+    put_varint(payload, command.signal);
+    put_client(payload, command.client, command.error);
+
+    // a single point is sent as a trajectory of one point
+    bool ok = command.signal == ARM_MOVE_TO_POINT
+                  ? put_points(payload, command.point.is_empty() ? std::list<Point>() : std::list<Point>(1, command.point), codec)
+                  : put_points(payload, command.trajectory.points, codec);
+    if (!ok)
+    {
+        payload.clear();
+    }
+    return ok;
+}
+
+bool encode_moved_batch(const Client &client, bool error, const std::list<Point> &points,
+                        const CodecInfo &codec, std::string &payload)
+{
+    payload.clear();
+    put_header(payload, CODEC_MOVED_BATCH);
+    put_client(payload, client, error);
+    if (!put_points(payload, points, codec))
+    {
+        payload.clear();
+        return false;
+    }
+    return true;
+}
+
+bool decode_command(const char *payload, size_t length, CommandObject &command)
+{
+    CodecReader in = {(const unsigned char *)payload, (const unsigned char *)payload + length};
+    uint8_t magic;
+    uint8_t kind;
+    uint64_t signal;
+    if (!in.byte(magic) || !in.byte(kind) || magic != CODEC_MAGIC || kind != CODEC_COMMAND ||
+        !in.varint(signal) || !read_client(in, command.client, command.error))
+    {
+        return false;
+    }
+    command.signal = (CommandsSignal)signal;
+
+    std::list<Point> points;
+    if (!read_points(in, points))
+    {
+        return false;
+    }
+    if (command.signal == ARM_MOVE_TO_POINT)
+    {
+        command.point = points.empty() ? Point() : points.front();
+    }
+    else
+    {
+        command.trajectory.points.swap(points);
+    }
+    return true;
+}
+
+bool decode_moved_batch(const char *payload, size_t length, Client &client, bool &error,
+                        std::list<Point> &points)
+{
+    CodecReader in = {(const unsigned char *)payload, (const unsigned char *)payload + length};
+    uint8_t magic;
+    uint8_t kind;
+    if (!in.byte(magic) || !in.byte(kind) || magic != CODEC_MAGIC || kind != CODEC_MOVED_BATCH)
+    {
+        return false;
+    }
+    return read_client(in, client, error) && read_points(in, points);
+}
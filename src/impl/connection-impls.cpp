@@ -0,0 +1,32 @@
+#include <algorithm>
+#include <chrono>
+#include "../include/connection-defs.hpp"
+
+ReconnectBackoff::ReconnectBackoff(long initial_ms, long max_ms)
+{
+    initial = std::max(1L, initial_ms);
+    maximum = std::max(initial, max_ms);
+    backoff = initial;
+    attempt = 0;
+    random.seed((unsigned)std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+long ReconnectBackoff::next_delay()
+{
+    std::uniform_int_distribution<long> jitter(backoff / 2, backoff);
+    long delay = jitter(random);
+    backoff = std::min(maximum, backoff * 2);
+    attempt++;
+    return delay;
+}
+
+int ReconnectBackoff::attempts()
+{
+    return attempt;
+}
+
+void ReconnectBackoff::reset()
+{
+    backoff = initial;
+    attempt = 0;
+}
@@ -0,0 +1,140 @@
+#include <thread>
+#include "../include/homing-defs.hpp"
+
+ArmHoming::ArmHoming(const std::vector<std::vector<int>> &p)
+{
+    prerequisites = p;
+    joint_states = std::vector<JointHomingState>(prerequisites.size(), HOMING_WAITING);
+}
+
+bool ArmHoming::run(JointHomer homer, HomingListener listener)
+{
+    std::vector<std::thread> searches;
+    std::unique_lock<std::mutex> lock(mutex);
+    joint_states.assign(prerequisites.size(), HOMING_WAITING);
+
+    while (true)
+    {
+        // the joints that can start (or can never start) now
+        std::vector<std::pair<int, JointHomingState>> started;
+        int searching = 0;
+        for (size_t j = 0; j < joint_states.size(); j++)
+        {
+            if (joint_states[j] == HOMING_SEARCHING)
+            {
+                searching++;
+            }
+            if (joint_states[j] != HOMING_WAITING)
+            {
+                continue;
+            }
+            JointHomingState next = HOMING_SEARCHING;
+            for (int p : prerequisites[j])
+            {
+                JointHomingState before = p >= 0 && p < (int)joint_states.size() ? joint_states[p] : HOMING_FAILED;
+                if (before == HOMING_FAILED)
+                {
+                    next = HOMING_FAILED;
+                    break;
+                }
+                if (before != HOMING_DONE)
+                {
+                    next = HOMING_WAITING;
+                }
+            }
+            if (next != HOMING_WAITING)
+            {
+                joint_states[j] = next;
+                started.push_back(std::make_pair((int)j, next));
+            }
+        }
+
+        if (!started.empty())
+        {
+            // notified before the searches start, so they are notified in order
+            lock.unlock();
+            for (std::pair<int, JointHomingState> &s : started)
+            {
+                listener(s.first, s.second);
+            }
+            lock.lock();
+            for (std::pair<int, JointHomingState> &s : started)
+            {
+                if (s.second == HOMING_SEARCHING)
+                {
+                    searches.push_back(std::thread(&ArmHoming::search, this, s.first, homer, listener));
+                }
+            }
+            continue;
+        }
+
+        if (searching == 0)
+        {
+            break;
+        }
+        changed.wait(lock);
+    }
+
+    // joints still waiting are in a cycle of prerequisites
+    std::vector<int> stuck;
+    bool all_homed = true;
+    for (size_t j = 0; j < joint_states.size(); j++)
+    {
+        if (joint_states[j] == HOMING_WAITING)
+        {
+            joint_states[j] = HOMING_FAILED;
+            stuck.push_back((int)j);
+        }
+        all_homed = all_homed && joint_states[j] == HOMING_DONE;
+    }
+    lock.unlock();
+
+    for (int j : stuck)
+    {
+        listener(j, HOMING_FAILED);
+    }
+    for (std::thread &search : searches)
+    {
+        search.join();
+    }
+    return all_homed;
+}
+
+void ArmHoming::search(int joint, JointHomer homer, HomingListener listener)
+{
+    JointHomingState result = homer(joint) ? HOMING_DONE : HOMING_FAILED;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        joint_states[joint] = result;
+    }
+    changed.notify_all();
+    listener(joint, result);
+}
+
+JointHomingState ArmHoming::state(int joint)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return joint_states[joint];
+}
+
+std::vector<int> ArmHoming::states()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<int>(joint_states.begin(), joint_states.end());
+}
+
+int ArmHoming::homed()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int result = 0;
+    for (JointHomingState s : joint_states)
+    {
+        result += s == HOMING_DONE ? 1 : 0;
+    }
+    return result;
+}
+
+int ArmHoming::joints()
+{
+    return (int)prerequisites.size();
+}
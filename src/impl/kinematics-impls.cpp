@@ -0,0 +1,303 @@
+#include <cmath>
+#include <algorithm>
+#include "../include/kinematics-defs.hpp"
+
+static const double DEG = M_PI / 180.0;
+
+void forward_kinematics(const double *joints, double *pose)
+{
+    double t1 = joints[0] * DEG;
+    double t2 = joints[1] * DEG;
+    double t23 = t2 + joints[2] * DEG;
+    double t234 = t23 + joints[3] * DEG;
+
+    double r = KIN_BASE_OFFSET + KIN_UPPER_ARM * std::cos(t2) + KIN_FOREARM * std::cos(t23) + KIN_TOOL * std::cos(t234);
+    pose[0] = r * std::cos(t1);
+    pose[1] = r * std::sin(t1);
+    pose[2] = KIN_BASE_HEIGHT + KIN_UPPER_ARM * std::sin(t2) + KIN_FOREARM * std::sin(t23) + KIN_TOOL * std::sin(t234);
+    pose[3] = joints[1] + joints[2] + joints[3];
+    pose[4] = joints[4];
+}
+
+void forward_kinematics_batch(const double *joint_columns, size_t count, double *pose_columns)
+{
+    const double *j1 = joint_columns;
+    const double *j2 = joint_columns + count;
+    const double *j3 = joint_columns + 2 * count;
+    const double *j4 = joint_columns + 3 * count;
+    const double *j5 = joint_columns + 4 * count;
+    double *x = pose_columns;
+    double *y = pose_columns + count;
+    double *z = pose_columns + 2 * count;
+    double *pitch = pose_columns + 3 * count;
+    double *roll = pose_columns + 4 * count;
+
+    // angles of the links in the vertical plane (pitch is kept in DEGREES)
+    for (size_t i = 0; i < count; i++)
+    {
+        pitch[i] = j2[i] + j3[i] + j4[i];
+        roll[i] = j5[i];
+    }
+
+    // radius and height of the tool (x and y are used as scratch for the angles)
+    for (size_t i = 0; i < count; i++)
+    {
+        double t2 = j2[i] * DEG;
+        double t23 = t2 + j3[i] * DEG;
+        double t234 = pitch[i] * DEG;
+        x[i] = KIN_BASE_OFFSET + KIN_UPPER_ARM * std::cos(t2) + KIN_FOREARM * std::cos(t23) + KIN_TOOL * std::cos(t234);
+        z[i] = KIN_BASE_HEIGHT + KIN_UPPER_ARM * std::sin(t2) + KIN_FOREARM * std::sin(t23) + KIN_TOOL * std::sin(t234);
+    }
+
+    // projection of the radius on the base rotation
+    for (size_t i = 0; i < count; i++)
+    {
+        double t1 = j1[i] * DEG;
+        double r = x[i];
+        x[i] = r * std::cos(t1);
+        y[i] = r * std::sin(t1);
+    }
+}
+
+/**
+ * Solves the 4x4 system a * x = b (Gaussian elimination with partial
+ * pivoting). a and b are destroyed. Returns false if a is singular
+ **/
+static bool solve4(double a[4][4], double b[4], double x[4])
+{
+    for (int c = 0; c < 4; c++)
+    {
+        int pivot = c;
+        for (int r = c + 1; r < 4; r++)
+        {
+            if (std::fabs(a[r][c]) > std::fabs(a[pivot][c]))
+            {
+                pivot = r;
+            }
+        }
+        if (std::fabs(a[pivot][c]) < 1e-12)
+        {
+            return false;
+        }
+        if (pivot != c)
+        {
+            std::swap(a[pivot], a[c]);
+            std::swap(b[pivot], b[c]);
+        }
+        for (int r = c + 1; r < 4; r++)
+        {
+            double f = a[r][c] / a[c][c];
+            for (int k = c; k < 4; k++)
+            {
+                a[r][k] -= f * a[c][k];
+            }
+            b[r] -= f * b[c];
+        }
+    }
+    for (int r = 3; r >= 0; r--)
+    {
+        double sum = b[r];
+        for (int k = r + 1; k < 4; k++)
+        {
+            sum -= a[r][k] * x[k];
+        }
+        x[r] = sum / a[r][r];
+    }
+    return true;
+}
+
+/**
+ * Normalizes an angle difference (DEGREES) into [-180, 180)
+ **/
+static double angle_difference(double a, double b)
+{
+    double d = std::fmod(a - b + 180.0, 360.0);
+    if (d < 0)
+    {
+        d += 360.0;
+    }
+    return d - 180.0;
+}
+
+bool inverse_kinematics(const double *pose, double *joints, int *iterations)
+{
+    // limits of J1..J4 (constants of the model of the arm)
+    static const double low[4] = {EDScorbotModel::lower(0), EDScorbotModel::lower(1),
+                                  EDScorbotModel::lower(2), EDScorbotModel::lower(3)};
+    static const double high[4] = {EDScorbotModel::upper(0), EDScorbotModel::upper(1),
+                                   EDScorbotModel::upper(2), EDScorbotModel::upper(3)};
+
+    // the roll of the tool is the last joint itself: a roll beyond its limits cannot be reached
+    if (pose[4] < EDScorbotModel::lower(4) || pose[4] > EDScorbotModel::upper(4))
+    {
+        if (iterations != NULL)
+        {
+            *iterations = 0;
+        }
+        return false;
+    }
+    joints[4] = pose[4];
+    if (std::fabs(joints[2]) < IK_STRAIGHT_ELBOW)
+    {
+        joints[2] = IK_ELBOW_BEND;
+    }
+
+    // errors in pitch are weighted by the tool length, so they are comparable to millimetres
+    const double pitch_weight = KIN_TOOL * DEG;
+    bool converged = false;
+    int iteration = 0;
+    for (; iteration <= IK_MAX_ITERATIONS; iteration++)
+    {
+        double t1 = joints[0] * DEG;
+        double t2 = joints[1] * DEG;
+        double t23 = t2 + joints[2] * DEG;
+        double t234 = t23 + joints[3] * DEG;
+        double c1 = std::cos(t1), s1 = std::sin(t1);
+        double c2 = std::cos(t2), s2 = std::sin(t2);
+        double c23 = std::cos(t23), s23 = std::sin(t23);
+        double c234 = std::cos(t234), s234 = std::sin(t234);
+
+        double r = KIN_BASE_OFFSET + KIN_UPPER_ARM * c2 + KIN_FOREARM * c23 + KIN_TOOL * c234;
+        double z = KIN_BASE_HEIGHT + KIN_UPPER_ARM * s2 + KIN_FOREARM * s23 + KIN_TOOL * s234;
+
+        double error[4];
+        error[0] = pose[0] - r * c1;
+        error[1] = pose[1] - r * s1;
+        error[2] = pose[2] - z;
+        double pitch_error = angle_difference(pose[3], joints[1] + joints[2] + joints[3]);
+        error[3] = pitch_weight * pitch_error;
+
+        double position_error = std::sqrt(error[0] * error[0] + error[1] * error[1] + error[2] * error[2]);
+        if (position_error < IK_POSITION_TOLERANCE && std::fabs(pitch_error) < IK_PITCH_TOLERANCE)
+        {
+            converged = true;
+            break;
+        }
+        if (iteration == IK_MAX_ITERATIONS)
+        {
+            break;
+        }
+
+        // jacobian (per DEGREE) of x, y, z and weighted pitch over J1..J4
+        double dr[4];
+        double dz[4];
+        dr[1] = -(KIN_UPPER_ARM * s2 + KIN_FOREARM * s23 + KIN_TOOL * s234);
+        dz[1] = KIN_UPPER_ARM * c2 + KIN_FOREARM * c23 + KIN_TOOL * c234;
+        dr[2] = -(KIN_FOREARM * s23 + KIN_TOOL * s234);
+        dz[2] = KIN_FOREARM * c23 + KIN_TOOL * c234;
+        dr[3] = -KIN_TOOL * s234;
+        dz[3] = KIN_TOOL * c234;
+
+        double jac[4][4];
+        jac[0][0] = -r * s1 * DEG;
+        jac[1][0] = r * c1 * DEG;
+        jac[2][0] = 0.0;
+        jac[3][0] = 0.0;
+        for (int k = 1; k < 4; k++)
+        {
+            jac[0][k] = dr[k] * c1 * DEG;
+            jac[1][k] = dr[k] * s1 * DEG;
+            jac[2][k] = dz[k] * DEG;
+            jac[3][k] = pitch_weight;
+        }
+
+        // damped least squares: step = J^T (J J^T + damping I)^-1 error
+        double damping = IK_DAMPING * std::sqrt(position_error * position_error + error[3] * error[3]);
+        double m[4][4];
+        for (int a = 0; a < 4; a++)
+        {
+            for (int b = 0; b < 4; b++)
+            {
+                double sum = 0.0;
+                for (int k = 0; k < 4; k++)
+                {
+                    sum += jac[a][k] * jac[b][k];
+                }
+                m[a][b] = sum + (a == b ? damping : 0.0);
+            }
+        }
+        double w[4];
+        if (!solve4(m, error, w))
+        {
+            break;
+        }
+        for (int k = 0; k < 4; k++)
+        {
+            double step = 0.0;
+            for (int a = 0; a < 4; a++)
+            {
+                step += jac[a][k] * w[a];
+            }
+            joints[k] = std::max(low[k], std::min(high[k], joints[k] + step));
+        }
+    }
+
+    if (iterations != NULL)
+    {
+        *iterations = iteration;
+    }
+    return converged;
+}
+
+bool expand_cartesian_trajectory(const std::vector<double> &current, const std::list<Point> &waypoints,
+                                 FlatTrajectory &trajectory)
+{
+    size_t joints = METAINFOS.size();
+    std::vector<double> solution = current;
+    solution.resize(std::max(joints, (size_t)KIN_JOINTS), 0.0);
+
+    double pose[KIN_POSE];
+    forward_kinematics(solution.data(), pose);
+    double gripper = joints > KIN_JOINTS ? solution[KIN_JOINTS] : 0.0;
+
+    FlatTrajectory result = FlatTrajectory();
+    result.joints = joints > KIN_JOINTS ? KIN_JOINTS + 1 : KIN_JOINTS;
+    for (const Point &waypoint : waypoints)
+    {
+        if (waypoint.coordinates.size() < 3)
+        {
+            return false;
+        }
+
+        // missing pitch, roll or gripper keep their previous values
+        double target[KIN_POSE];
+        for (int k = 0; k < KIN_POSE; k++)
+        {
+            target[k] = k < (int)waypoint.coordinates.size() ? waypoint.coordinates[k] : pose[k];
+        }
+        double target_gripper = waypoint.coordinates.size() > KIN_POSE ? waypoint.coordinates[KIN_POSE] : gripper;
+
+        double dx = target[0] - pose[0];
+        double dy = target[1] - pose[1];
+        double dz = target[2] - pose[2];
+        double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        double rotation = std::max(std::fabs(target[3] - pose[3]), std::fabs(target[4] - pose[4]));
+        int steps = std::max(1, (int)std::ceil(std::max(distance, rotation) / CARTESIAN_STEP));
+
+        for (int s = 1; s <= steps; s++)
+        {
+            double u = (double)s / steps;
+            double sample[KIN_POSE];
+            for (int k = 0; k < KIN_POSE; k++)
+            {
+                sample[k] = pose[k] + (target[k] - pose[k]) * u;
+            }
+            if (!inverse_kinematics(sample, solution.data(), NULL))
+            {
+                return false;
+            }
+
+            result.coordinates.insert(result.coordinates.end(), solution.begin(), solution.begin() + KIN_JOINTS);
+            if (joints > KIN_JOINTS)
+            {
+                result.coordinates.push_back(gripper + (target_gripper - gripper) * u);
+            }
+        }
+
+        std::copy(target, target + KIN_POSE, pose);
+        gripper = target_gripper;
+    }
+
+    trajectory = std::move(result);
+    return true;
+}
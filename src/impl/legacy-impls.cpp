@@ -0,0 +1,218 @@
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include "../include/legacy-defs.hpp"
+
+/**
+ * Removes the blank characters around a field of an old format command
+ **/
+static std::string_view trim_legacy_field(std::string_view field)
+{
+    const char *blanks = " \t\r\n";
+    size_t begin = field.find_first_not_of(blanks);
+    if (begin == std::string_view::npos)
+    {
+        return std::string_view();
+    }
+    size_t end = field.find_last_not_of(blanks);
+    return field.substr(begin, end - begin + 1);
+}
+
+/**
+ * Converts a field into an integer. The whole field must be a number.
+ **/
+static bool parse_legacy_int(std::string_view field, int &value)
+{
+    const char *first = field.data();
+    const char *last = field.data() + field.size();
+    std::from_chars_result res = std::from_chars(first, last, value);
+    return res.ec == std::errc() && res.ptr == last;
+}
+
+bool parse_legacy_command(const char *payload, size_t length, LegacyCommand &command)
+{
+    if (payload == NULL)
+    {
+        return false;
+    }
+
+    // mosquitto terminates payloads with '\0', but it is not part of the message
+    length = strnlen(payload, length);
+    std::string_view text = trim_legacy_field(std::string_view(payload, length));
+    if (text.size() < 2 || text.front() != '[' || text.back() != ']')
+    {
+        return false;
+    }
+    text = text.substr(1, text.size() - 2);
+
+    // [type,mode,url,n,sleep]
+    const size_t max_fields = 5;
+    std::string_view fields[max_fields];
+    size_t count = 0;
+    while (true)
+    {
+        if (count == max_fields)
+        {
+            // more fields than expected
+            return false;
+        }
+        size_t comma = text.find(',');
+        fields[count++] = trim_legacy_field(text.substr(0, comma));
+        if (comma == std::string_view::npos)
+        {
+            break;
+        }
+        text.remove_prefix(comma + 1);
+    }
+
+    LegacyCommand result = LegacyCommand();
+    if (!parse_legacy_int(fields[0], result.type))
+    {
+        return false;
+    }
+    if (count > 1 && !fields[1].empty())
+    {
+        result.mode = fields[1][0];
+    }
+    if (count > 2)
+    {
+        result.url = fields[2];
+    }
+    if (count > 3 && !fields[3].empty() && !parse_legacy_int(fields[3], result.n))
+    {
+        return false;
+    }
+    if (count > 4 && !fields[4].empty() && !parse_legacy_int(fields[4], result.sleep))
+    {
+        return false;
+    }
+
+    command = result;
+    return true;
+}
+
+bool load_legacy_trajectory(std::string_view url, Trajectory &trajectory)
+{
+    if (url.empty())
+    {
+        return false;
+    }
+
+    // the file name must be terminated with '\0' to be opened
+    std::ifstream file{std::string(url)};
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    json json_obj = json::parse(file, nullptr, false);
+    if (json_obj.is_discarded())
+    {
+        return false;
+    }
+
+    json points = json_obj;
+    if (json_obj.is_object())
+    {
+        if (!json_obj.contains("points"))
+        {
+            return false;
+        }
+        points = json_obj["points"];
+    }
+    if (!points.is_array())
+    {
+        return false;
+    }
+
+    Trajectory result = Trajectory();
+    for (json::iterator it = points.begin(); it != points.end(); ++it)
+    {
+        json item = it.value();
+        Point p = Point();
+        if (item.is_array())
+        {
+            for (json::iterator c = item.begin(); c != item.end(); ++c)
+            {
+                if (!c.value().is_number())
+                {
+                    return false;
+                }
+                p.coordinates.push_back(c.value());
+            }
+        }
+        else if (item.is_object() && item.contains("coordinates"))
+        {
+            p = Point::from_json(item);
+        }
+        else
+        {
+            return false;
+        }
+        result.points.push_back(p);
+    }
+
+    trajectory = result;
+    return true;
+}
+
+bool legacy_to_command(const LegacyCommand &legacy, const Point &position, CommandObject &command)
+{
+    Client legacy_client = Client(LEGACY_CLIENT_ID);
+
+    switch (legacy.type)
+    {
+    case LEGACY_HOME:
+    {
+        // in the async API the arm searches home when a client connects
+        CommandObject result = CommandObject(ARM_CONNECT);
+        result.client = legacy_client;
+        command = result;
+        return true;
+    }
+    case LEGACY_MOVE_JOINT:
+    {
+        // mode is the joint number and n is the reference to be sent to it
+        int joint = legacy.mode - '0';
+        int joints = METAINFOS.size();
+        if (joint < 1 || joint > joints)
+        {
+            return false;
+        }
+        Point target = position;
+        if (target.coordinates.size() < (size_t)joints)
+        {
+            target.coordinates.resize(joints, 0.0);
+        }
+        target.coordinates[joint - 1] = ref_to_angle(joint, legacy.n);
+
+        CommandObject result = CommandObject(ARM_MOVE_TO_POINT, target);
+        result.client = legacy_client;
+        command = result;
+        return true;
+    }
+    case LEGACY_TRAJECTORY:
+    {
+        // only mode 'S' (trajectory stored in a file of the controller) is supported
+        if (legacy.mode != 'S')
+        {
+            return false;
+        }
+        Trajectory trajectory = Trajectory();
+        if (!load_legacy_trajectory(legacy.url, trajectory))
+        {
+            return false;
+        }
+        CommandObject result = CommandObject(ARM_APPLY_TRAJECTORY, trajectory);
+        result.client = legacy_client;
+        command = result;
+        return true;
+    }
+    case LEGACY_RESET_SPID:
+    default:
+        // there is no equivalent command in the async API
+        return false;
+    }
+}
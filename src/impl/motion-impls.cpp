@@ -0,0 +1,315 @@
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include "../include/motion-defs.hpp"
+#include "timing-impls.cpp"
+
+PointToPointProfile::PointToPointProfile(std::vector<double> from, std::vector<double> to, double t)
+{
+    start = from;
+    target = to;
+    time = t;
+    if (start.size() < target.size())
+    {
+        start.resize(target.size(), 0.0);
+    }
+}
+
+double PointToPointProfile::duration()
+{
+    return time;
+}
+
+void PointToPointProfile::sample(double t, std::vector<double> &position)
+{
+    double s = 1.0;
+    if (time > 0 && t < time)
+    {
+        double u = std::max(0.0, t / time);
+        s = u * u * (3.0 - 2.0 * u);
+    }
+    position.resize(target.size());
+    for (size_t i = 0; i < target.size(); i++)
+    {
+        position[i] = start[i] + (target[i] - start[i]) * s;
+    }
+}
+
+ArmMotion::ArmMotion(size_t joints, long period_us, double decel) : timing(period_us)
+{
+    njoints = joints;
+    period = std::chrono::microseconds(period_us);
+    deceleration = decel;
+    cancel_flag = false;
+    current = std::vector<double>(joints, 0.0);
+    published_sequence = 0;
+    published.reset(new std::atomic<double>[joints]);
+    for (size_t i = 0; i < joints; i++)
+    {
+        published[i] = 0.0;
+    }
+    last_settle = 0.0;
+    settle_timeouts = 0;
+    settle_time = std::chrono::microseconds(0);
+    settle_timeout = std::chrono::microseconds(0);
+}
+
+void ArmMotion::set_settling(const std::vector<double> &t, long settle_us, long timeout_us)
+{
+    std::lock_guard<std::mutex> lock(motion_mutex);
+    tolerance = t;
+    tolerance.resize(t.empty() ? 0 : njoints, t.empty() ? 0.0 : t.back());
+    settle_time = std::chrono::microseconds(settle_us);
+    settle_timeout = std::chrono::microseconds(timeout_us);
+}
+
+void ArmMotion::set_reader(JointReader r)
+{
+    std::lock_guard<std::mutex> lock(motion_mutex);
+    reader = r;
+}
+
+void ArmMotion::set_range(const std::vector<double> &min, const std::vector<double> &max)
+{
+    std::lock_guard<std::mutex> lock(motion_mutex);
+    minimum = min;
+    maximum = max;
+}
+
+MotionResult ArmMotion::execute(MotionProfile &profile)
+{
+    return execute(profile, nullptr);
+}
+
+MotionResult ArmMotion::execute(MotionProfile &profile, std::function<void(double)> on_tick)
+{
+    std::lock_guard<std::mutex> motion_lock(motion_mutex);
+
+    std::vector<double> previous = position();
+    std::vector<double> next = previous;
+    double dt = std::chrono::duration<double>(period).count();
+    double duration = profile.duration();
+
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point tick = started;
+    std::chrono::steady_clock::time_point ended = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                               std::chrono::duration<double>(duration));
+    std::chrono::steady_clock::time_point settled = ended;
+    double sampled = 0.0;
+    while (true)
+    {
+        if (cancel_flag.load(std::memory_order_acquire))
+        {
+            preempt_time = std::chrono::steady_clock::now();
+
+            // velocity of each joint at the moment of the cancel request
+            std::vector<double> velocity = std::vector<double>(njoints, 0.0);
+            for (size_t i = 0; i < njoints && i < next.size(); i++)
+            {
+                velocity[i] = (next[i] - previous[i]) / dt;
+            }
+            decelerate(profile, sampled, velocity);
+            return MOTION_CANCELED;
+        }
+
+        std::chrono::steady_clock::time_point woken = std::chrono::steady_clock::now();
+        double t = std::chrono::duration<double>(tick - started).count();
+        previous = next;
+        sampled = std::min(t, duration);
+        profile.sample(sampled, next);
+        next.resize(njoints, 0.0);
+        write_position(next);
+        if (on_tick)
+        {
+            on_tick(std::min(t, duration));
+        }
+
+        // with settling, the final position is commanded until the joints settle
+        bool finished = t >= duration && tolerance.empty();
+        MotionResult result = MOTION_DONE;
+        if (t >= duration && !tolerance.empty())
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (!within_tolerance(next))
+            {
+                settled = now;
+            }
+            finished = now - settled >= settle_time || now - ended > settle_timeout;
+            if (finished)
+            {
+                result = now - settled >= settle_time ? MOTION_DONE : MOTION_TIMEOUT;
+                settle_timeouts += result == MOTION_TIMEOUT ? 1 : 0;
+                last_settle = std::chrono::duration<double>(now - ended).count();
+            }
+        }
+        timing.record_tick(tick, woken, std::chrono::steady_clock::now());
+
+        if (finished)
+        {
+            return result;
+        }
+
+        tick += period;
+        wait_tick(tick);
+    }
+}
+
+bool ArmMotion::wait_tick(std::chrono::steady_clock::time_point next)
+{
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    return wakeup.wait_until(lock, next, [this]
+                             { return cancel_flag.load(std::memory_order_acquire); });
+}
+
+void ArmMotion::decelerate(MotionProfile &profile, double t, const std::vector<double> &velocity)
+{
+    double dt = std::chrono::duration<double>(period).count();
+    double duration = profile.duration();
+    std::vector<double> next = position();
+
+    // the rate of the clock of the profile goes from 1 to 0, in the time the
+    // fastest joint needs to stop
+    double fastest = 0.0;
+    for (double v : velocity)
+    {
+        fastest = std::max(fastest, std::fabs(v));
+    }
+    double step = fastest > 0 ? deceleration * dt / fastest : 1.0;
+    double rate = 1.0;
+
+    std::chrono::steady_clock::time_point tick = std::chrono::steady_clock::now();
+    bool moving = true;
+    while (moving)
+    {
+        std::chrono::steady_clock::time_point woken = std::chrono::steady_clock::now();
+        double slower = std::max(0.0, rate - step);
+        t += (rate + slower) * dt / 2;
+        rate = slower;
+        moving = rate > 0 && t < duration;
+        if (fastest > 0)
+        {
+            profile.sample(std::min(t, duration), next);
+            next.resize(njoints, 0.0);
+        }
+        for (size_t i = 0; i < njoints; i++)
+        {
+            if (i < minimum.size() && i < maximum.size())
+            {
+                next[i] = std::min(std::max(next[i], minimum[i]), maximum[i]);
+            }
+        }
+        write_position(next);
+        timing.record_tick(tick, woken, std::chrono::steady_clock::now());
+
+        if (moving)
+        {
+            // the ramp itself cannot be cancelled, it only waits for the period
+            tick += period;
+            std::this_thread::sleep_until(tick);
+        }
+    }
+    stop_time = std::chrono::steady_clock::now();
+}
+
+void ArmMotion::cancel()
+{
+    cancel_time = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        cancel_flag.store(true, std::memory_order_release);
+    }
+    wakeup.notify_all();
+}
+
+void ArmMotion::reset_cancel()
+{
+    cancel_flag.store(false, std::memory_order_release);
+}
+
+bool ArmMotion::cancel_requested()
+{
+    return cancel_flag.load(std::memory_order_acquire);
+}
+
+std::vector<double> ArmMotion::position()
+{
+    std::lock_guard<std::mutex> lock(position_mutex);
+    return current;
+}
+
+std::vector<double> ArmMotion::read_joints()
+{
+    std::chrono::steady_clock::time_point reading = std::chrono::steady_clock::now();
+    std::vector<double> result;
+    if (reader)
+    {
+        reader(result);
+        result.resize(njoints, 0.0);
+    }
+    else
+    {
+        result = position();
+    }
+    timing.read_joints.record(std::chrono::steady_clock::now() - reading);
+    return result;
+}
+
+void ArmMotion::latest_position(double *position)
+{
+    // retried while the control loop writes (the sequence is odd or changes)
+    unsigned long before;
+    unsigned long after;
+    do
+    {
+        before = published_sequence.load();
+        for (size_t i = 0; i < njoints; i++)
+        {
+            position[i] = published[i].load();
+        }
+        after = published_sequence.load();
+    } while ((before & 1) != 0 || before != after);
+}
+
+bool ArmMotion::within_tolerance(const std::vector<double> &position)
+{
+    std::vector<double> measured = read_joints();
+    for (size_t i = 0; i < tolerance.size() && i < position.size(); i++)
+    {
+        if (std::fabs(measured[i] - position[i]) > tolerance[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t ArmMotion::joints()
+{
+    return njoints;
+}
+
+void ArmMotion::write_position(const std::vector<double> &position)
+{
+    /**
+     * TODO: This is the place to send the references to the real arm
+     * (angle_to_ref + EDScorbot::sendRef for each joint). The simulated arm
+     * simply assumes the commanded position.
+     **/
+    std::chrono::steady_clock::time_point sending = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(position_mutex);
+        for (size_t i = 0; i < njoints && i < position.size(); i++)
+        {
+            current[i] = position[i];
+        }
+    }
+    // only the control loop writes: the sequence is odd until every joint is written
+    unsigned long sequence = published_sequence.load(std::memory_order_relaxed);
+    published_sequence.store(sequence + 1);
+    for (size_t i = 0; i < njoints && i < position.size(); i++)
+    {
+        published[i].store(position[i]);
+    }
+    published_sequence.store(sequence + 2);
+    timing.send_ref.record(std::chrono::steady_clock::now() - sending);
+}
@@ -0,0 +1,592 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <deque>
+#include "../include/planner-defs.hpp"
+
+std::vector<JointInfo> joint_limits()
+{
+    return std::vector<JointInfo>(METAINFOS.begin(), METAINFOS.end());
+}
+
+double point_to_point_time(const std::vector<double> &from, const std::vector<double> &to,
+                           const std::vector<JointInfo> &limits)
+{
+    // the smoothstep profile reaches 1.5 times the average velocity and
+    // 6 * distance / time^2 of acceleration
+    double result = MINIMUM_SEGMENT_TIME;
+    for (size_t j = 0; j < to.size() && j < limits.size(); j++)
+    {
+        double distance = std::fabs(to[j] - (j < from.size() ? from[j] : 0.0));
+        if (limits[j].max_velocity > 0)
+        {
+            result = std::max(result, 1.5 * distance / limits[j].max_velocity);
+        }
+        if (limits[j].max_acceleration > 0)
+        {
+            result = std::max(result, std::sqrt(6 * distance / limits[j].max_acceleration));
+        }
+    }
+    return result;
+}
+
+/**
+ * The blend around a corner between a segment of distances c (covered at rate
+ * x, segments per second) and a segment of distances e (at rate y): the time
+ * the slowest joint needs to change its velocity (blend) and the largest
+ * change of velocity of a joint (change). Both grow linearly with the rates
+ **/
+static void corner_change(const double *c, const double *e, double x, double y, size_t joints,
+                          const std::vector<double> &inverse_acceleration, double &blend, double &change)
+{
+    blend = 0.0;
+    change = 0.0;
+    for (size_t j = 0; j < joints; j++)
+    {
+        double difference = std::fabs(y * e[j] - x * c[j]);
+        blend = std::max(blend, difference * inverse_acceleration[j]);
+        change = std::max(change, difference);
+    }
+}
+
+/**
+ * How much the corner between a segment of distances c at rate x and a
+ * segment of distances e at rate y exceeds what a blend allows: the blend
+ * must fit in the half of both segments next to the corner and the deviation
+ * from the corner (|velocity change| * blend / 8) must be under the
+ * tolerance. It is at most 1 if the corner can be blended, and it grows with
+ * the square of the rates (both of them scaled by s multiply it by s^2)
+ **/
+static double corner_excess(const double *c, const double *e, double x, double y, size_t joints,
+                            const std::vector<double> &inverse_acceleration, double tolerance)
+{
+    double blend;
+    double change;
+    corner_change(c, e, x, y, joints, inverse_acceleration, blend, change);
+    return std::max(blend * std::max(x, y), change * blend / (8 * tolerance));
+}
+
+/**
+ * The highest rate of the segment of distances own, between low (which fits)
+ * and rate (which does not), that lets the corner with the segment of
+ * distances other (at rate other_rate) be blended. If low is 0 the search
+ * starts from the highest rate found to fit among the ones keeping the
+ * velocity of some joint through the corner and the halvings of rate, and it
+ * returns 0 if there is none. first says if own is the first segment of the
+ * corner
+ **/
+static double fitting_rate(const double *own, const double *other, double rate, double other_rate, double low,
+                           bool first, size_t joints, const std::vector<double> &inverse_acceleration,
+                           double tolerance)
+{
+    const double *c = first ? own : other;
+    const double *e = first ? other : own;
+    auto fits = [&](double candidate) {
+        return corner_excess(c, e, first ? candidate : other_rate, first ? other_rate : candidate, joints,
+                             inverse_acceleration, tolerance) <= 1.0;
+    };
+    for (size_t j = 0; j < joints && low == 0.0; j++)
+    {
+        double candidate = own[j] != 0.0 ? other_rate * other[j] / own[j] : 0.0;
+        if (candidate > 0.0 && candidate < rate && fits(candidate))
+        {
+            low = candidate;
+        }
+    }
+    for (double candidate = rate / 2; candidate > low && candidate > rate * 1e-3; candidate /= 2)
+    {
+        if (fits(candidate))
+        {
+            low = candidate;
+            break;
+        }
+    }
+    if (low == 0.0)
+    {
+        return 0.0;
+    }
+    double high = rate;
+    for (int step = 0; step < RETIMING_SEARCH_STEPS; step++)
+    {
+        double middle = (low + high) / 2;
+        if (fits(middle))
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * Sweeps the corners of a trajectory (n segments of distances, whose rates
+ * are lowered from rates) so that each one is blended or stopped, and returns
+ * the duration of the trajectory. rest_blends[i] * rate is the blend bringing
+ * segment i to rest (or from rest), which fits in the segment up to the rate
+ * resting[i]. Lowering the rate of a segment only changes its two corners:
+ *
+ * - backward sweep: each corner is blended lowering the rate of the segment
+ *   before it (both rates if that is not enough) or it is stopped, whichever
+ *   costs less. The corners after it keep fitting, but the one before may not
+ * - forward sweep: the segment after a corner whose rate before has been
+ *   lowered follows it as much as the corner allows. The corner fitted with
+ *   the rate before it had then (fitted), so it fits with both rates scaled
+ *   down by the same factor, and the search starts there
+ **/
+static double sweep_corners(const std::vector<double> &distances, size_t joints,
+                            const std::vector<double> &inverse_acceleration, double tolerance,
+                            const std::vector<double> &rest_blends, const std::vector<double> &resting,
+                            std::vector<double> &rates, std::vector<bool> &stops)
+{
+    size_t n = rates.size();
+    stops.assign(n + 1, false);
+    std::vector<double> fitted(n + 1, 0.0);
+    const double slack = 1.0 - 1e-9;
+
+    // the arm starts and ends at rest
+    rates[0] = std::min(rates[0], resting[0]);
+    rates[n - 1] = std::min(rates[n - 1], resting[n - 1]);
+
+    for (size_t k = n - 1; k >= 1; k--)
+    {
+        const double *c = &distances[(k - 1) * joints];
+        const double *e = &distances[k * joints];
+        double x = rates[k - 1];
+        double y = rates[k];
+        double excess = corner_excess(c, e, x, y, joints, inverse_acceleration, tolerance);
+        if (excess > 1.0)
+        {
+            double blend_x = fitting_rate(c, e, x, y, 0.0, true, joints, inverse_acceleration, tolerance);
+            double blend_y = y;
+            if (blend_x == 0.0)
+            {
+                double scale = std::sqrt(1.0 / excess) * slack;
+                blend_x = x * scale;
+                blend_y = y * scale;
+            }
+            double stop_x = std::min(x, resting[k - 1]);
+            double stop_y = std::min(y, resting[k]);
+            double blending = 1.0 / blend_x + 1.0 / blend_y;
+            double stopping = 1.0 / stop_x + 1.0 / stop_y + (rest_blends[k - 1] * stop_x + rest_blends[k] * stop_y) / 2;
+            stops[k] = stopping < blending;
+            rates[k - 1] = stops[k] ? stop_x : blend_x;
+            rates[k] = stops[k] ? stop_y : blend_y;
+        }
+        fitted[k] = rates[k - 1];
+    }
+
+    for (size_t k = 1; k < n; k++)
+    {
+        const double *c = &distances[(k - 1) * joints];
+        const double *e = &distances[k * joints];
+        if (stops[k] || rates[k - 1] >= fitted[k] ||
+            corner_excess(c, e, rates[k - 1], rates[k], joints, inverse_acceleration, tolerance) <= 1.0)
+        {
+            continue;
+        }
+        double low = rates[k] * rates[k - 1] / fitted[k];
+        rates[k] = fitting_rate(e, c, rates[k], rates[k - 1], low, false, joints, inverse_acceleration, tolerance);
+    }
+
+    double total = (rest_blends[0] * rates[0] + rest_blends[n - 1] * rates[n - 1]) / 2;
+    for (size_t i = 0; i < n; i++)
+    {
+        total += 1.0 / rates[i];
+        if (i > 0 && stops[i])
+        {
+            total += (rest_blends[i - 1] * rates[i - 1] + rest_blends[i] * rates[i]) / 2;
+        }
+    }
+    return total;
+}
+
+void retime_trajectory(const std::vector<double> &start, const FlatTrajectory &points,
+                       const std::vector<JointInfo> &limits, double tolerance, TrajectoryTiming &timing)
+{
+    size_t n = points.size();
+    size_t joints = limits.size();
+    timing.segments.assign(n, MINIMUM_SEGMENT_TIME);
+    timing.blends.assign(n + 1, 0.0);
+    timing.restarts.assign(n + 1, 0.0);
+    timing.stops.assign(n + 1, false);
+    timing.total = 0.0;
+    timing.point_to_point_total = 0.0;
+    if (n == 0)
+    {
+        return;
+    }
+
+    // distance covered by each joint in each segment, in a contiguous buffer
+    std::vector<double> distances(n * joints);
+    std::vector<double> previous = start;
+    previous.resize(joints, 0.0);
+    std::vector<double> current = previous;
+    size_t given = std::min(joints, points.joints);
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        std::copy(points.point(i), points.point(i) + given, current.begin());
+        std::fill(current.begin() + given, current.end(), 0.0);
+        timing.point_to_point_total += point_to_point_time(previous, current, limits);
+        for (size_t j = 0; j < joints; j++)
+        {
+            distances[i * joints + j] = current[j] - previous[j];
+        }
+        previous.swap(current);
+    }
+
+    std::vector<double> inverse_acceleration(joints, 0.0);
+    for (size_t j = 0; j < joints; j++)
+    {
+        if (limits[j].max_acceleration > 0)
+        {
+            inverse_acceleration[j] = 1.0 / limits[j].max_acceleration;
+        }
+    }
+
+    // the rate of each segment (segments per second, the inverse of its time)
+    // starts at the velocity of its slowest joint. rest_blends[i] * rate is the
+    // blend bringing the segment to rest (or from rest), and it fits in the
+    // segment up to the rate resting[i]. The shortest segments take half of
+    // MINIMUM_SEGMENT_TIME, so stopping at both ends they do not take longer
+    std::vector<double> rates(n);
+    std::vector<double> rest_blends(n, 0.0);
+    std::vector<double> resting(n);
+    for (i = 0; i < n; i++)
+    {
+        const double *d = &distances[i * joints];
+        double time = MINIMUM_SEGMENT_TIME / 2;
+        double rest_blend = 0.0;
+        for (size_t j = 0; j < joints; j++)
+        {
+            if (limits[j].max_velocity > 0)
+            {
+                time = std::max(time, std::fabs(d[j]) / limits[j].max_velocity);
+            }
+            rest_blend = std::max(rest_blend, std::fabs(d[j]) * inverse_acceleration[j]);
+        }
+        rates[i] = 1.0 / time;
+        rest_blends[i] = rest_blend;
+        resting[i] = 1.0 / std::max(time, std::sqrt(rest_blend));
+    }
+
+    // stopping at every point (a trapezoidal movement on each segment) is
+    // never slower than point_to_point_time. Blending is swept from the
+    // fastest rates and from the rates of stopping at every point (where
+    // stops cost less), and the fastest of the three is kept
+    std::vector<double> best_rates = resting;
+    std::vector<bool> best_stops(n + 1, true);
+    double best_total = 0.0;
+    for (i = 0; i < n; i++)
+    {
+        best_total += 1.0 / resting[i] + rest_blends[i] * resting[i];
+    }
+    std::vector<bool> stops;
+    for (int sweep = 0; sweep < 2 && tolerance > 0; sweep++)
+    {
+        std::vector<double> swept = sweep == 0 ? rates : resting;
+        double total = sweep_corners(distances, joints, inverse_acceleration, tolerance, rest_blends, resting,
+                                     swept, stops);
+        if (total < best_total)
+        {
+            best_total = total;
+            best_rates.swap(swept);
+            best_stops.swap(stops);
+        }
+    }
+    rates.swap(best_rates);
+
+    // the blend of each corner, or the blends to and from rest where the arm stops
+    for (i = 0; i < n; i++)
+    {
+        timing.segments[i] = 1.0 / rates[i];
+    }
+    timing.blends[0] = rest_blends[0] * rates[0];
+    timing.blends[n] = rest_blends[n - 1] * rates[n - 1];
+    for (size_t k = 1; k < n; k++)
+    {
+        if (best_stops[k])
+        {
+            timing.stops[k] = true;
+            timing.blends[k] = rest_blends[k - 1] * rates[k - 1];
+            timing.restarts[k] = rest_blends[k] * rates[k];
+        }
+        else
+        {
+            double change;
+            corner_change(&distances[(k - 1) * joints], &distances[k * joints], rates[k - 1], rates[k], joints,
+                          inverse_acceleration, timing.blends[k], change);
+        }
+    }
+    timing.total = best_total;
+}
+
+/**
+ * The largest deviation of point from the segment a-b, each coordinate
+ * divided by its tolerance (scale). With timed, the deviation is measured at
+ * fraction of the segment, otherwise at the closest position
+ **/
+static double segment_deviation(const double *a, const double *b, const double *point,
+                                const std::vector<double> &scale, bool timed, double fraction)
+{
+    size_t n = scale.size();
+    double s = fraction;
+    if (!timed)
+    {
+        double along = 0.0;
+        double length = 0.0;
+        for (size_t j = 0; j < n; j++)
+        {
+            double d = (b[j] - a[j]) * scale[j];
+            along += (point[j] - a[j]) * scale[j] * d;
+            length += d * d;
+        }
+        s = length > 0.0 ? std::max(0.0, std::min(1.0, along / length)) : 0.0;
+    }
+    double result = 0.0;
+    for (size_t j = 0; j < n; j++)
+    {
+        result = std::max(result, std::fabs(point[j] - (a[j] + s * (b[j] - a[j]))) * scale[j]);
+    }
+    return result;
+}
+
+size_t simplify_trajectory(FlatTrajectory &points, const std::vector<double> &tolerance, bool timed)
+{
+    size_t n = points.size();
+    if (n < 3 || tolerance.empty())
+    {
+        return 0;
+    }
+
+    // deviations are compared in units of tolerance (a tolerance of 0 keeps
+    // every point off the segment)
+    size_t joints = points.joints;
+    std::vector<double> scale(joints);
+    for (size_t j = 0; j < joints; j++)
+    {
+        double tol = j < tolerance.size() ? tolerance[j] : tolerance.back();
+        scale[j] = 1.0 / std::max(tol, 1e-9);
+    }
+
+    // the segments still to check, without recursion (long trajectories
+    // could be split once per point)
+    std::vector<bool> keep(n, false);
+    std::vector<std::pair<size_t, size_t>> segments;
+    segments.push_back(std::make_pair((size_t)0, n - 1));
+    keep.front() = true;
+    keep.back() = true;
+    while (!segments.empty())
+    {
+        size_t first = segments.back().first;
+        size_t last = segments.back().second;
+        segments.pop_back();
+
+        double worst = 1.0;
+        size_t split = 0;
+        const double *a = points.point(first);
+        const double *b = points.point(last);
+        for (size_t k = first + 1; k < last; k++)
+        {
+            double fraction = (double)(k - first) / (double)(last - first);
+            double deviation = segment_deviation(a, b, points.point(k), scale, timed, fraction);
+            if (deviation > worst)
+            {
+                worst = deviation;
+                split = k;
+            }
+        }
+        if (split != 0)
+        {
+            keep[split] = true;
+            segments.push_back(std::make_pair(first, split));
+            segments.push_back(std::make_pair(split, last));
+        }
+    }
+
+    // the points kept are moved forward in the buffer, in order
+    size_t kept = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        if (keep[k])
+        {
+            if (kept != k)
+            {
+                std::copy(points.point(k), points.point(k) + joints, points.coordinates.begin() + kept * joints);
+            }
+            kept++;
+        }
+    }
+    points.coordinates.resize(kept * joints);
+    return n - kept;
+}
+
+BlendedProfile::BlendedProfile(std::vector<double> start, const FlatTrajectory &pts, size_t joints,
+                               const TrajectoryTiming &tim, size_t look)
+    : points(pts), timing(tim)
+{
+    njoints = joints;
+    lookahead = std::max(look, (size_t)3);
+    front_index = 0;
+    next_point = 0;
+
+    Waypoint first;
+    first.position = start;
+    first.position.resize(njoints, 0.0);
+    first.velocity_in = std::vector<double>(njoints, 0.0);
+    first.velocity_out = std::vector<double>(njoints, 0.0);
+    first.time = 0.0;
+    first.blend = 0.0;
+    first.restart = 0.0;
+    first.time_in = 0.0;
+    first.time_out = 0.0;
+    first.stop = false;
+    first.planned = false;
+    window.push_back(first);
+
+    fill_window();
+}
+
+void BlendedProfile::fill_window()
+{
+    while (window.size() < lookahead && next_point < points.size())
+    {
+        Waypoint &previous = window.back();
+        size_t previous_index = front_index + window.size() - 1;
+
+        Waypoint current;
+        current.position.assign(points.point(next_point), points.point(next_point) + points.joints);
+        current.position.resize(njoints, 0.0);
+        current.velocity_out = std::vector<double>(njoints, 0.0);
+        current.planned = false;
+
+        // the segment from the previous point is now known
+        previous.time_out = timing.segments[previous_index];
+        for (size_t j = 0; j < njoints; j++)
+        {
+            previous.velocity_out[j] = (current.position[j] - previous.position[j]) / previous.time_out;
+        }
+        previous.blend = timing.blends[previous_index];
+        previous.stop = timing.stops[previous_index];
+        previous.restart = timing.restarts[previous_index];
+        if (previous_index == 0)
+        {
+            // the arm starts moving at time 0
+            previous.time = previous.blend / 2;
+        }
+        previous.planned = true;
+
+        current.velocity_in = previous.velocity_out;
+        current.time_in = previous.time_out;
+        current.time_out = 0.0;
+        current.time = previous.departure() + previous.time_out;
+        current.blend = 0.0;
+        current.restart = 0.0;
+        current.stop = false;
+
+        window.push_back(current);
+        ++next_point;
+    }
+
+    // the last point of the trajectory: the arm stops there
+    Waypoint &last = window.back();
+    if (next_point == points.size() && !last.planned && window.size() > 1)
+    {
+        last.blend = timing.blends[front_index + window.size() - 1];
+        last.planned = true;
+    }
+}
+
+double BlendedProfile::duration()
+{
+    return timing.total;
+}
+
+void BlendedProfile::sample(double t, std::vector<double> &position)
+{
+    // moves to the point whose blend or outgoing segment contains t
+    while (window.size() >= 2 && window[1].planned && t >= window[1].time - window[1].blend / 2)
+    {
+        window.pop_front();
+        front_index++;
+        fill_window();
+    }
+
+    Waypoint &current = window.front();
+    position.resize(njoints);
+    if (!current.planned)
+    {
+        // empty trajectory
+        position = current.position;
+        return;
+    }
+
+    double half = current.blend / 2;
+    double s = std::max(t - current.time, -half);
+    bool last = window.size() == 1;
+    if (last)
+    {
+        s = std::min(s, half);
+    }
+
+    if (current.stop && s >= half)
+    {
+        // the arm has stopped at the point: it leaves from rest
+        double restart_half = current.restart / 2;
+        double r = std::max(t - current.departure(), -restart_half);
+        for (size_t j = 0; j < njoints; j++)
+        {
+            double value = current.position[j];
+            if (r < restart_half && current.restart > 0)
+            {
+                value += current.velocity_out[j] / (2 * current.restart) * (r + restart_half) * (r + restart_half);
+            }
+            else
+            {
+                value += current.velocity_out[j] * r;
+            }
+            position[j] = value;
+        }
+        return;
+    }
+
+    for (size_t j = 0; j < njoints; j++)
+    {
+        double value = current.position[j];
+        // where the arm stops, the blend brings it to rest at the point
+        double velocity_out = current.stop ? 0.0 : current.velocity_out[j];
+        if (s < half && current.blend > 0)
+        {
+            // parabolic blend from the incoming to the outgoing velocity
+            double change = velocity_out - current.velocity_in[j];
+            value += current.velocity_in[j] * s + change / (2 * current.blend) * (s + half) * (s + half);
+        }
+        else
+        {
+            value += velocity_out * s;
+        }
+        position[j] = value;
+    }
+}
+
+size_t BlendedProfile::reached(double t)
+{
+    // the last point is reached only when the arm stops there, at the end of
+    // the profile (its time and timing.total are sums of the same durations
+    // in different order, so they are not compared)
+    double passed = window.front().time;
+    bool last = window.size() == 1 && next_point == points.size();
+    if (last || window.front().stop)
+    {
+        // where the arm stops, the point is reached when it is at rest there
+        passed += window.front().blend / 2;
+    }
+    if (passed <= t || (last && t >= timing.total))
+    {
+        return front_index;
+    }
+    return front_index > 0 ? front_index - 1 : 0;
+}
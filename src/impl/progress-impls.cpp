@@ -0,0 +1,105 @@
+#include <cmath>
+#include <algorithm>
+#include "../include/progress-defs.hpp"
+
+ProgressThrottle::ProgressThrottle(double max_rate)
+{
+    suppressed = 0;
+    if (max_rate > 0)
+    {
+        min_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / max_rate));
+    }
+    else
+    {
+        min_interval = std::chrono::steady_clock::duration::zero();
+    }
+    started = std::chrono::steady_clock::now();
+    last_publish = started;
+    published_any = false;
+    total = 0;
+    last_index = 0;
+    max_tracking_error = 0.0;
+}
+
+void ProgressThrottle::start(int tot)
+{
+    started = std::chrono::steady_clock::now();
+    last_publish = started;
+    published_any = false;
+    total = tot;
+    last_index = 0;
+    max_tracking_error = 0.0;
+    suppressed = 0;
+}
+
+bool ProgressThrottle::update(int index, double track, ProgressObject &progress)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    max_tracking_error = std::max(max_tracking_error, track);
+    last_index = index;
+
+    bool publish = !published_any || index >= total || now - last_publish >= min_interval;
+    if (!publish)
+    {
+        suppressed++;
+        return false;
+    }
+
+    if (original_duration.valid() &&
+        (index >= total || original_duration.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+    {
+        simplification.original_duration = original_duration.get();
+        original_duration = std::shared_future<double>();
+    }
+
+    double elapsed = std::chrono::duration<double>(now - started).count();
+    double eta = 0.0;
+    if (index > 0 && index < total)
+    {
+        eta = elapsed / index * (total - index);
+    }
+
+    progress = ProgressObject(index, total, elapsed, eta, max_tracking_error);
+    progress.simplification = simplification;
+
+    published_any = true;
+    last_publish = now;
+    max_tracking_error = 0.0;
+    return true;
+}
+
+bool ProgressThrottle::cancelled(ProgressObject &progress)
+{
+    if (published_any && last_index >= total)
+    {
+        return false;
+    }
+    if (original_duration.valid() && original_duration.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        simplification.original_duration = original_duration.get();
+        original_duration = std::shared_future<double>();
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - started).count();
+    progress = ProgressObject(last_index, total, elapsed, 0.0, max_tracking_error);
+    progress.simplification = simplification;
+
+    published_any = true;
+    last_publish = now;
+    max_tracking_error = 0.0;
+    return true;
+}
+
+double tracking_error(const Point &commanded, const Point &measured)
+{
+    size_t joints = std::min(METAINFOS.size(),
+                             std::min(commanded.coordinates.size(), measured.coordinates.size()));
+    double result = 0.0;
+    for (size_t i = 0; i < joints; i++)
+    {
+        result = std::max(result, std::fabs(commanded.coordinates[i] - measured.coordinates[i]));
+    }
+    return result;
+}
@@ -0,0 +1,409 @@
+#include <iostream>
+#include <algorithm>
+#include "../include/publisher-defs.hpp"
+
+PublishPipeline::PublishPipeline(PublishSender s, long hw)
+{
+    sender = s;
+    high_water = hw > 0 ? hw : PUBLISH_HIGH_WATER;
+    published = 0;
+    coalesced = 0;
+    dropped = 0;
+    failed = 0;
+    max_in_flight = 0;
+    flight = 0;
+    backpressure = false;
+    pending_count = 0;
+    buffered = 0;
+    lost = 0;
+    connected = true;
+    outage_count = 0;
+    outage_limit = OUTAGE_BUFFER_MESSAGES;
+}
+
+void PublishPipeline::set_policy(const std::string &topic, TopicPolicy policy)
+{
+    policies[topic] = policy;
+}
+
+void PublishPipeline::set_high_water(long hw)
+{
+    high_water = hw > 0 ? hw : PUBLISH_HIGH_WATER;
+}
+
+void PublishPipeline::set_outage_limit(long messages)
+{
+    outage_limit = messages > 0 ? messages : OUTAGE_BUFFER_MESSAGES;
+}
+
+TopicPolicy PublishPipeline::policy_of(const std::string &topic)
+{
+    std::map<std::string, TopicPolicy>::iterator it = policies.find(topic);
+    if (it != policies.end())
+    {
+        return it->second;
+    }
+    return TopicPolicy();
+}
+
+int PublishPipeline::publish(const std::string &topic, const char *payload, size_t length)
+{
+    TopicPolicy policy = policy_of(topic);
+
+    // while the broker is unreachable, and until the messages kept meanwhile
+    // are sent, messages are kept in order
+    if (!connected.load() || outage_count.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(outage_mutex);
+        if (!connected.load() || !outage.empty())
+        {
+            keep(topic, payload, length, policy.droppable);
+            return 0;
+        }
+    }
+
+    // pending messages left after the queue drained
+    if (pending_count.load() > 0 && flight.load() <= high_water / 2)
+    {
+        flush_pending();
+    }
+
+    if (policy.droppable && flight.load() >= high_water)
+    {
+        if (!backpressure.exchange(true))
+        {
+            std::cout << "Publisher under backpressure: " << flight.load() << " messages in flight" << std::endl;
+        }
+
+        // keeps only the newest message of the topic
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        std::string &slot = pending[topic];
+        if (!slot.empty())
+        {
+            coalesced++;
+        }
+        else
+        {
+            pending_count++;
+        }
+        slot.assign(payload, length);
+        return 0;
+    }
+
+    return send(topic, payload, length, policy);
+}
+
+int PublishPipeline::send(const std::string &topic, const char *payload, size_t length, const TopicPolicy &policy)
+{
+    int rc = transmit(topic, payload, length, policy);
+    if (rc == PUBLISH_NO_CONNECTION || rc == PUBLISH_CONNECTION_LOST)
+    {
+        // the connection dropped before mosquitto notified it
+        disconnected();
+        std::lock_guard<std::mutex> lock(outage_mutex);
+        keep(topic, payload, length, policy.droppable);
+        return 0;
+    }
+    return rc;
+}
+
+int PublishPipeline::transmit(const std::string &topic, const char *payload, size_t length, const TopicPolicy &policy)
+{
+    // counted before sending: the callback may arrive before sender returns
+    long depth = ++flight;
+    long max = max_in_flight.load();
+    while (depth > max && !max_in_flight.compare_exchange_weak(max, depth))
+    {
+    }
+
+    int mid = 0;
+    int rc = sender(topic, payload, length, policy.qos, &mid);
+    if (rc != 0)
+    {
+        // the message will never be notified by the callback
+        flight--;
+        if (rc == PUBLISH_NO_CONNECTION || rc == PUBLISH_CONNECTION_LOST)
+        {
+            return rc;
+        }
+        if (policy.droppable)
+        {
+            dropped++;
+        }
+        else
+        {
+            failed++;
+            std::cout << "Cannot publish on " << topic << " (error " << rc << ")" << std::endl;
+        }
+        return rc;
+    }
+    published++;
+    return rc;
+}
+
+void PublishPipeline::on_published(int mid)
+{
+    // messages in flight are forgotten on reconnection, so late notifications
+    // must not take the count below zero
+    long depth = flight.load();
+    while (depth > 0 && !flight.compare_exchange_weak(depth, depth - 1))
+    {
+    }
+    depth = depth > 0 ? depth - 1 : 0;
+    if (depth <= high_water / 2 && pending_count.load() > 0)
+    {
+        flush_pending();
+    }
+}
+
+void PublishPipeline::flush_pending()
+{
+    std::map<std::string, std::string> messages;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        messages.swap(pending);
+        pending_count = 0;
+    }
+    if (backpressure.exchange(false))
+    {
+        std::cout << "Publisher recovered: " << coalesced.load() << " messages coalesced, "
+                  << dropped.load() << " dropped so far" << std::endl;
+    }
+    for (std::map<std::string, std::string>::iterator it = messages.begin(); it != messages.end(); ++it)
+    {
+        send(it->first, it->second.data(), it->second.size(), policies.find(it->first)->second);
+    }
+}
+
+void PublishPipeline::keep(const std::string &topic, const char *payload, size_t length, bool droppable)
+{
+    if ((long)outage.size() >= outage_limit)
+    {
+        // the oldest telemetry is discarded first, the oldest message otherwise
+        std::deque<KeptMessage>::iterator victim = std::find_if(outage.begin(), outage.end(),
+                                                                 [](const KeptMessage &m)
+                                                                 { return m.droppable; });
+        if (victim == outage.end())
+        {
+            victim = outage.begin();
+        }
+        outage.erase(victim);
+        outage_count--;
+        lost++;
+    }
+    KeptMessage message;
+    message.topic = topic;
+    message.payload.assign(payload, length);
+    message.droppable = droppable;
+    outage.push_back(std::move(message));
+    outage_count++;
+    buffered++;
+}
+
+void PublishPipeline::disconnected()
+{
+    connected = false;
+}
+
+void PublishPipeline::reconnected()
+{
+    std::lock_guard<std::mutex> lock(outage_mutex);
+    flight = 0;
+    long sent = 0;
+    while (!outage.empty())
+    {
+        KeptMessage &message = outage.front();
+        int rc = transmit(message.topic, message.payload.data(), message.payload.size(), policy_of(message.topic));
+        if (rc == PUBLISH_NO_CONNECTION || rc == PUBLISH_CONNECTION_LOST)
+        {
+            // lost again: the rest waits for the next connection
+            return;
+        }
+        if (rc == 0)
+        {
+            sent++;
+        }
+        outage.pop_front();
+        outage_count--;
+    }
+    connected = true;
+    if (sent > 0)
+    {
+        std::cout << "Publisher sent " << sent << " messages kept during the outage (" << lost.load()
+                  << " lost so far)" << std::endl;
+    }
+}
+
+bool PublishPipeline::is_connected()
+{
+    return connected.load();
+}
+
+long PublishPipeline::in_flight()
+{
+    return flight.load();
+}
+
+json PublishPipeline::to_json()
+{
+    json result;
+    result["published"] = published.load();
+    result["coalesced"] = coalesced.load();
+    result["dropped"] = dropped.load();
+    result["failed"] = failed.load();
+    result["inFlight"] = flight.load();
+    result["maxInFlight"] = max_in_flight.load();
+    result["buffered"] = buffered.load();
+    result["lost"] = lost.load();
+    return result;
+}
+
+PublisherThread::PublisherThread()
+{
+    posted = 0;
+    delivered = 0;
+    discarded = 0;
+    max_queued = 0;
+    limit = PUBLISH_QUEUE_MAX;
+    running = false;
+    sleeping = false;
+    stub.next = NULL;
+    head = &stub;
+    tail = &stub;
+}
+
+PublisherThread::~PublisherThread()
+{
+    stop();
+    while (OutboundMessage *message = pop())
+    {
+        delete message;
+    }
+}
+
+void PublisherThread::start(std::function<void(const std::string &, const std::string &)> d)
+{
+    deliver = d;
+    running = true;
+    consumer = std::thread(&PublisherThread::run, this);
+}
+
+void PublisherThread::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeup_mutex);
+    }
+    wakeup.notify_one();
+    consumer.join();
+}
+
+void PublisherThread::set_limit(long messages)
+{
+    limit = messages > 0 ? messages : PUBLISH_QUEUE_MAX;
+}
+
+bool PublisherThread::post(const std::string &topic, std::string &&payload, bool droppable)
+{
+    long queued = posted.load(std::memory_order_relaxed) - delivered.load(std::memory_order_relaxed);
+    if (droppable && queued >= limit)
+    {
+        discarded++;
+        return false;
+    }
+
+    OutboundMessage *message = new OutboundMessage();
+    message->topic = topic;
+    message->payload = std::move(payload);
+
+    queued = ++posted - delivered.load(std::memory_order_relaxed);
+    long max = max_queued.load(std::memory_order_relaxed);
+    while (queued > max && !max_queued.compare_exchange_weak(max, queued))
+    {
+    }
+
+    push(message);
+    // the link (push) and this load are sequentially consistent, as the store
+    // of sleeping and the loads of the consumer: either the consumer sees the
+    // message before sleeping or this producer sees it sleeping and wakes it up
+    if (sleeping.load())
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeup_mutex);
+        }
+        wakeup.notify_one();
+    }
+    return true;
+}
+
+void PublisherThread::push(OutboundMessage *message)
+{
+    message->next.store(NULL, std::memory_order_relaxed);
+    OutboundMessage *previous = head.exchange(message, std::memory_order_acq_rel);
+    previous->next.store(message);
+}
+
+OutboundMessage *PublisherThread::pop()
+{
+    OutboundMessage *first = tail;
+    OutboundMessage *next = first->next.load(std::memory_order_acquire);
+    if (first == &stub)
+    {
+        if (next == NULL)
+        {
+            return NULL;
+        }
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != NULL)
+    {
+        tail = next;
+        return first;
+    }
+    if (first != head.load(std::memory_order_acquire))
+    {
+        // a producer is linking a new message
+        return NULL;
+    }
+    // first is the last message: the stub is put behind it to detach it
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next != NULL)
+    {
+        tail = next;
+        return first;
+    }
+    return NULL;
+}
+
+void PublisherThread::run()
+{
+    while (true)
+    {
+        OutboundMessage *message = pop();
+        if (message != NULL)
+        {
+            deliver(message->topic, message->payload);
+            delivered++;
+            delete message;
+            continue;
+        }
+        if (!running.load() && posted.load() == delivered.load())
+        {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeup_mutex);
+        sleeping = true;
+        // a message whose link is not visible yet has been pushed by a producer
+        // that will find the consumer sleeping and notify it
+        wakeup.wait(lock, [this]
+                    { return tail->next.load() != NULL || (tail != &stub && tail == head.load()) || !running.load(); });
+        sleeping = false;
+    }
+}
@@ -0,0 +1,292 @@
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <dirent.h>
+#include "../include/recorder-defs.hpp"
+
+/**
+ * The current time in microseconds since the epoch
+ **/
+static int64_t recorder_now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * The index following the highest one of the recording files (prefix.N.rec)
+ * already in the directory of prefix, or 0 if there is none
+ **/
+static int next_recording_index(const std::string &prefix)
+{
+    size_t slash = prefix.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : prefix.substr(0, slash + 1);
+    std::string base = (slash == std::string::npos ? prefix : prefix.substr(slash + 1)) + ".";
+
+    int next = 0;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == NULL)
+    {
+        return next;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        std::string name = entry->d_name;
+        if (name.size() <= base.size() + 4 || name.compare(0, base.size(), base) != 0 ||
+            name.compare(name.size() - 4, 4, ".rec") != 0)
+        {
+            continue;
+        }
+        std::string number = name.substr(base.size(), name.size() - base.size() - 4);
+        if (number.find_first_not_of("0123456789") == std::string::npos && number.size() < 9)
+        {
+            next = std::max(next, atoi(number.c_str()) + 1);
+        }
+    }
+    closedir(dir);
+    return next;
+}
+
+EncoderRecorder::EncoderRecorder(EncoderReader r, double rate, std::string p)
+{
+    reader = r;
+    rate_hz = rate > 0 ? rate : RECORDER_RATE_HZ;
+    prefix = p;
+    running = false;
+    dropped = 0;
+    written = 0;
+    ring = std::vector<EncoderSample>(RECORDER_RING_SIZE);
+    head = 0;
+    tail = 0;
+    file = NULL;
+    file_size = 0;
+    file_index = 0;
+}
+
+EncoderRecorder::~EncoderRecorder()
+{
+    stop();
+}
+
+bool EncoderRecorder::start()
+{
+    if (running)
+    {
+        return false;
+    }
+    // the recordings of earlier runs with the same prefix are kept
+    file_index = next_recording_index(prefix);
+    if (!open_file())
+    {
+        return false;
+    }
+    running = true;
+    sampler = std::thread(&EncoderRecorder::sample_loop, this);
+    writer = std::thread(&EncoderRecorder::write_loop, this);
+    return true;
+}
+
+void EncoderRecorder::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    sampler.join();
+    writer.join();
+
+    // samples pushed after the last flush of the writer
+    flush();
+    if (file != NULL)
+    {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+void EncoderRecorder::sample_loop()
+{
+    // the wall clock is read once: samples are timed with the steady clock,
+    // so they are not affected by adjustments of the system time
+    int64_t wall_start = recorder_now_us();
+    std::chrono::steady_clock::time_point steady_start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / rate_hz));
+
+    std::chrono::steady_clock::time_point tick = steady_start;
+    while (running.load(std::memory_order_relaxed))
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == RECORDER_RING_SIZE)
+        {
+            // the writer is late: the sample is lost
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            EncoderSample &sample = ring[h & (RECORDER_RING_SIZE - 1)];
+            sample.time_us = wall_start + std::chrono::duration_cast<std::chrono::microseconds>(now - steady_start).count();
+            reader(sample.counts);
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        tick += period;
+        if (tick < now)
+        {
+            // the sampler has been delayed: skip the missed periods instead of bursting
+            tick = now + period;
+        }
+        std::this_thread::sleep_until(tick);
+    }
+}
+
+void EncoderRecorder::write_loop()
+{
+    while (running.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(RECORDER_FLUSH_MS));
+        flush();
+    }
+}
+
+size_t EncoderRecorder::flush()
+{
+    size_t total = 0;
+    std::vector<int64_t> times;
+    std::vector<int32_t> columns;
+    times.reserve(RECORDER_BLOCK_SAMPLES);
+    columns.resize(RECORDER_JOINTS * RECORDER_BLOCK_SAMPLES);
+
+    while (true)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t available = head.load(std::memory_order_acquire) - t;
+        size_t count = std::min(available, (size_t)RECORDER_BLOCK_SAMPLES);
+        if (count == 0)
+        {
+            break;
+        }
+
+        // transposes the samples into columns
+        times.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            const EncoderSample &sample = ring[(t + i) & (RECORDER_RING_SIZE - 1)];
+            times[i] = sample.time_us;
+            for (size_t j = 0; j < RECORDER_JOINTS; j++)
+            {
+                columns[j * count + i] = sample.counts[j];
+            }
+        }
+        tail.store(t + count, std::memory_order_release);
+
+        if (file != NULL && file_size >= RECORDER_FILE_SIZE)
+        {
+            fclose(file);
+            file = NULL;
+            if (!open_file())
+            {
+                // no file is rotated again: the rest of the samples are discarded
+                std::cout << "Recorder: cannot rotate file, samples are discarded" << std::endl;
+                file_size = 0;
+                dropped.fetch_add(count, std::memory_order_relaxed);
+                continue;
+            }
+        }
+        if (file == NULL)
+        {
+            dropped.fetch_add(count, std::memory_order_relaxed);
+            continue;
+        }
+
+        RecordingBlock block;
+        block.magic = RECORDING_BLOCK_MAGIC;
+        block.count = count;
+        block.first_us = times.front();
+        block.last_us = times.back();
+        fwrite(&block, sizeof(block), 1, file);
+        fwrite(times.data(), sizeof(int64_t), count, file);
+        fwrite(columns.data(), sizeof(int32_t), RECORDER_JOINTS * count, file);
+        file_size += sizeof(block) + count * (sizeof(int64_t) + RECORDER_JOINTS * sizeof(int32_t));
+
+        written.fetch_add(count, std::memory_order_relaxed);
+        total += count;
+    }
+
+    if (file != NULL && total > 0)
+    {
+        fflush(file);
+    }
+    return total;
+}
+
+bool EncoderRecorder::open_file()
+{
+    // removes the oldest file, only the last RECORDER_FILES are kept
+    if (file_index >= RECORDER_FILES)
+    {
+        std::string oldest = prefix + "." + std::to_string(file_index - RECORDER_FILES) + ".rec";
+        remove(oldest.c_str());
+    }
+
+    // an existing file is never overwritten
+    std::string name = prefix + "." + std::to_string(file_index) + ".rec";
+    file_index++;
+    file = fopen(name.c_str(), "wbx");
+    if (file == NULL)
+    {
+        std::cout << "Recorder: cannot create " << name << std::endl;
+        return false;
+    }
+
+    RecordingHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.joints = RECORDER_JOINTS;
+    header.rate_hz = (uint32_t)rate_hz;
+    header.created_us = recorder_now_us();
+    fwrite(&header, sizeof(header), 1, file);
+    file_size = sizeof(header);
+
+    std::cout << "Recording joints into " << name << std::endl;
+    return true;
+}
+
+bool read_recording_header(FILE *file, RecordingHeader &header)
+{
+    if (fread(&header, sizeof(header), 1, file) != 1)
+    {
+        return false;
+    }
+    return memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) == 0 &&
+           header.joints > 0 && header.joints <= RECORDER_JOINTS;
+}
+
+bool read_recording_block(FILE *file, const RecordingHeader &header, int64_t from_us, int64_t to_us,
+                          std::vector<int64_t> &times, std::vector<int32_t> &counts)
+{
+    times.clear();
+    counts.clear();
+
+    RecordingBlock block;
+    if (fread(&block, sizeof(block), 1, file) != 1 || block.magic != RECORDING_BLOCK_MAGIC)
+    {
+        return false;
+    }
+
+    long size = block.count * (sizeof(int64_t) + header.joints * sizeof(int32_t));
+    if (block.last_us < from_us || block.first_us > to_us)
+    {
+        return fseek(file, size, SEEK_CUR) == 0;
+    }
+
+    times.resize(block.count);
+    counts.resize(header.joints * block.count);
+    return fread(times.data(), sizeof(int64_t), block.count, file) == block.count &&
+           fread(counts.data(), sizeof(int32_t), counts.size(), file) == counts.size();
+}
@@ -0,0 +1,129 @@
+#include <chrono>
+#include "../include/registers-defs.hpp"
+
+RegisterFile::RegisterFile()
+{
+    written = 0;
+    avoided = 0;
+    failed = 0;
+    commits = 0;
+    configuration_time = 0.0;
+    last_configuration = 0.0;
+    shadow = std::vector<uint16_t>(CONTROLLER_ADDRESSES, 0);
+    valid = std::vector<bool>(CONTROLLER_ADDRESSES, false);
+    pending_index = std::vector<int>(CONTROLLER_ADDRESSES, -1);
+}
+
+bool RegisterFile::stage(uint8_t address, uint16_t value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int index = pending_index[address];
+    if (index >= 0)
+    {
+        // the earlier write is never performed; the new one is accounted on commit
+        avoided++;
+        pending[index].second = value;
+        return value != shadow[address] || !valid[address];
+    }
+    if (valid[address] && shadow[address] == value)
+    {
+        avoided++;
+        return false;
+    }
+    pending_index[address] = (int)pending.size();
+    pending.push_back(std::make_pair(address, value));
+    return true;
+}
+
+bool RegisterFile::stage_spid(int base, const JointController &controller)
+{
+    const int values[] = {controller.PI_FD_bank3_18bits, controller.PD_FD_bank3_22bits,
+                          controller.EI_FD_bank3_18bits, controller.spike_expansor};
+    for (int value : values)
+    {
+        if (value < 0 || value > REGISTER_MAX)
+        {
+            return false;
+        }
+    }
+    stage(base + PI_FD_ENABLE_ADDR, SPID_BANK_ENABLE);
+    stage(base + JointController::PI_FD_offset, controller.PI_FD_bank3_18bits);
+    stage(base + PD_FD_ENABLE_ADDR, SPID_BANK_ENABLE);
+    stage(base + JointController::PD_FD_offset, controller.PD_FD_bank3_22bits);
+    stage(base + EI_FD_ENABLE_ADDR, SPID_BANK_ENABLE);
+    stage(base + JointController::EI_FD_offset, controller.EI_FD_bank3_18bits);
+    stage(base + JointController::spike_expansor_offset, controller.spike_expansor);
+    return true;
+}
+
+size_t RegisterFile::staged()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.size();
+}
+
+int RegisterFile::commit(RegisterWriter writer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int result = 0;
+    for (std::pair<uint8_t, uint16_t> &write : pending)
+    {
+        uint8_t address = write.first;
+        pending_index[address] = -1;
+        if (valid[address] && shadow[address] == write.second)
+        {
+            avoided++;
+            continue;
+        }
+        int rc = writer(address, (uint8_t)(write.second >> 8), (uint8_t)(write.second & 0xFF));
+        if (rc != 0)
+        {
+            valid[address] = false;
+            failed++;
+            result = result == 0 ? rc : result;
+            continue;
+        }
+        shadow[address] = write.second;
+        valid[address] = true;
+        written++;
+    }
+    pending.clear();
+    commits++;
+    last_configuration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    configuration_time += last_configuration;
+    return result;
+}
+
+void RegisterFile::invalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    valid.assign(CONTROLLER_ADDRESSES, false);
+    pending_index.assign(CONTROLLER_ADDRESSES, -1);
+    pending.clear();
+}
+
+bool RegisterFile::known(uint8_t address)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return valid[address];
+}
+
+uint16_t RegisterFile::value(uint8_t address)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return shadow[address];
+}
+
+json RegisterFile::to_json()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    json result;
+    result["written"] = written;
+    result["avoided"] = avoided;
+    result["failed"] = failed;
+    result["commits"] = commits;
+    result["configurationTime"] = configuration_time;
+    result["lastConfiguration"] = last_configuration;
+    return result;
+}
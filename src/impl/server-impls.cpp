@@ -1,12 +1,16 @@
 #include <string>
 #include "../include/server-defs.hpp"
+#include "state-impls.cpp"
+#include "codec-impls.cpp"
 
 bool has_signal(std::string message)
 {
     bool result = false;
-    json json_obj = json::parse(message);
 
-    result = json_obj.contains("signal");
+    // messages in the old format are not valid JSON, so parsing must not throw
+    json json_obj = json::parse(message, nullptr, false);
+
+    result = json_obj.is_object() && json_obj.contains("signal");
 
     return result;
 }
@@ -14,9 +18,13 @@ bool has_signal(std::string message)
 int extract_signal(std::string message)
 {
     int result = 0;
-    json json_obj = json::parse(message);
+    json json_obj = json::parse(message, nullptr, false);
 
-    result = json_obj["signal"];
+    // a signal that is not a number is not a valid signal (0)
+    if (json_obj.is_object() && json_obj.contains("signal") && json_obj["signal"].is_number_integer())
+    {
+        result = json_obj["signal"];
+    }
 
     return result;
 }
@@ -25,6 +33,7 @@ MetaInfoObject initial_metainfoobj()
 {
     MetaInfoObject result = MetaInfoObject();
     result.joints = std::list<JointInfo>(METAINFOS);
+    result.codecs.push_back(compact_codec());
 
     return result;
 }
@@ -39,5 +48,16 @@ int build_topics()
     MOVED_TOPIC.append("/");
     MOVED_TOPIC.append(MOVED);
 
+    PROGRESS_TOPIC = ROBOT_NAME;
+    PROGRESS_TOPIC.append("/");
+    PROGRESS_TOPIC.append(PROGRESS);
+
+    MOVED_BATCH_TOPIC = MOVED_TOPIC;
+    MOVED_BATCH_TOPIC.append("/batch");
+
+    TIMING_TOPIC = ROBOT_NAME;
+    TIMING_TOPIC.append("/");
+    TIMING_TOPIC.append(TIMING);
+
     return 0;
 }
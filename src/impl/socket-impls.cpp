@@ -0,0 +1,383 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include "../include/socket-defs.hpp"
+
+static void put_u32(std::string &buffer, uint32_t value)
+{
+    buffer.push_back((char)(value >> 24));
+    buffer.push_back((char)(value >> 16));
+    buffer.push_back((char)(value >> 8));
+    buffer.push_back((char)value);
+}
+
+static uint32_t get_u32(const char *bytes)
+{
+    const unsigned char *b = (const unsigned char *)bytes;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+static uint16_t get_u16(const char *bytes)
+{
+    const unsigned char *b = (const unsigned char *)bytes;
+    return (uint16_t)((b[0] << 8) | b[1]);
+}
+
+void append_local_frame(std::string &buffer, const std::string &topic, const char *payload, size_t length)
+{
+    put_u32(buffer, (uint32_t)(2 + topic.size() + length));
+    buffer.push_back((char)(topic.size() >> 8));
+    buffer.push_back((char)topic.size());
+    buffer.append(topic);
+    buffer.append(payload, length);
+}
+
+/**
+ * Checks the header of a frame: the length of the frame (after its length
+ * field) and of its topic. Returns false if the frame is malformed
+ **/
+static bool check_local_frame(const char *header, uint32_t &length, uint16_t &topic_length)
+{
+    length = get_u32(header);
+    topic_length = get_u16(header + 4);
+    return length >= 2 && length <= LOCAL_FRAME_MAX && topic_length > 0 && (uint32_t)topic_length + 2 <= length;
+}
+
+static bool read_fully(int fd, char *buffer, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = recv(fd, buffer, length, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        buffer += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool write_local_frame(int fd, const std::string &topic, const char *payload, size_t length)
+{
+    std::string frame;
+    append_local_frame(frame, topic, payload, length);
+    const char *next = frame.data();
+    size_t left = frame.size();
+    while (left > 0)
+    {
+        ssize_t n = send(fd, next, left, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        next += n;
+        left -= n;
+    }
+    return true;
+}
+
+bool read_local_frame(int fd, std::string &topic, std::string &payload)
+{
+    char header[LOCAL_FRAME_HEADER];
+    uint32_t length;
+    uint16_t topic_length;
+    if (!read_fully(fd, header, LOCAL_FRAME_HEADER) || !check_local_frame(header, length, topic_length))
+    {
+        return false;
+    }
+    topic.resize(topic_length);
+    payload.resize(length - 2 - topic_length);
+    return read_fully(fd, &topic[0], topic_length) && (payload.empty() || read_fully(fd, &payload[0], payload.size()));
+}
+
+LocalTransport::LocalTransport()
+{
+    received = 0;
+    sent = 0;
+    rejected = 0;
+    dropped = 0;
+    listener = -1;
+    running = false;
+    connected = 0;
+}
+
+LocalTransport::~LocalTransport()
+{
+    stop();
+}
+
+bool LocalTransport::start(const std::string &p, LocalHandler h, mode_t mode)
+{
+    struct sockaddr_un address;
+    if (p.size() >= sizeof(address.sun_path))
+    {
+        std::cout << "Local socket path too long: " << p << std::endl;
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, p.c_str(), sizeof(address.sun_path) - 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        std::cout << "Cannot create the local socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    // a socket left by a previous run would make bind fail
+    unlink(p.c_str());
+    // bind creates the socket with the umask: its mode is set before listening,
+    // so no client can connect in between
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0 || chmod(p.c_str(), mode) < 0 ||
+        listen(listener, LOCAL_MAX_CLIENTS) < 0)
+    {
+        std::cout << "Cannot listen on " << p << ": " << strerror(errno) << std::endl;
+        close(listener);
+        listener = -1;
+        return false;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+
+    path = p;
+    handler = h;
+    running = true;
+    worker = std::thread(&LocalTransport::run, this);
+    std::cout << "Listening for local clients on " << path << std::endl;
+    return true;
+}
+
+void LocalTransport::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    worker.join();
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    for (LocalClient &client : connections)
+    {
+        flush_client(client);
+        close(client.fd);
+    }
+    connections.clear();
+    connected = 0;
+    close(listener);
+    listener = -1;
+    unlink(path.c_str());
+}
+
+void LocalTransport::broadcast(const std::string &topic, const char *payload, size_t length)
+{
+    if (connected.load() == 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    for (LocalClient &client : connections)
+    {
+        if (client.broken)
+        {
+            continue;
+        }
+        append_local_frame(client.output, topic, payload, length);
+        flush_client(client);
+        if (client.output.size() > LOCAL_OUTPUT_MAX)
+        {
+            // the thread disconnects it
+            client.broken = true;
+            dropped++;
+        }
+        sent++;
+    }
+}
+
+void LocalTransport::flush_client(LocalClient &client)
+{
+    while (!client.output.empty() && !client.broken)
+    {
+        ssize_t n = send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return;
+        }
+        if (n <= 0)
+        {
+            client.broken = true;
+            return;
+        }
+        client.output.erase(0, n);
+    }
+}
+
+long LocalTransport::clients()
+{
+    return connected.load();
+}
+
+void LocalTransport::accept_client()
+{
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    if (connections.size() >= LOCAL_MAX_CLIENTS)
+    {
+        std::cout << "Refusing local client: " << LOCAL_MAX_CLIENTS << " clients connected" << std::endl;
+        close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    LocalClient client;
+    client.fd = fd;
+    client.broken = false;
+    connections.push_back(client);
+    connected = connections.size();
+}
+
+bool LocalTransport::read_client(LocalClient &client)
+{
+    char chunk[64 * 1024];
+    while (true)
+    {
+        ssize_t n = recv(client.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        client.input.append(chunk, n);
+    }
+
+    size_t offset = 0;
+    std::string topic;
+    std::string payload;
+    while (client.input.size() - offset >= LOCAL_FRAME_HEADER)
+    {
+        uint32_t length;
+        uint16_t topic_length;
+        const char *header = client.input.data() + offset;
+        if (!check_local_frame(header, length, topic_length))
+        {
+            rejected++;
+            std::cout << "Malformed frame from a local client, disconnecting it" << std::endl;
+            return false;
+        }
+        if (client.input.size() - offset < 4 + (size_t)length)
+        {
+            break;
+        }
+        topic.assign(header + LOCAL_FRAME_HEADER, topic_length);
+        // the copy is null terminated (some handlers read the payload as a C string)
+        payload.assign(header + LOCAL_FRAME_HEADER + topic_length, length - 2 - topic_length);
+        received++;
+        handler(topic, payload.c_str(), payload.size());
+        offset += 4 + length;
+    }
+    client.input.erase(0, offset);
+    return true;
+}
+
+void LocalTransport::run()
+{
+    std::vector<struct pollfd> fds;
+    while (running.load())
+    {
+        fds.clear();
+        fds.push_back({listener, POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            for (LocalClient &client : connections)
+            {
+                short events = POLLIN;
+                if (!client.output.empty())
+                {
+                    events |= POLLOUT;
+                }
+                fds.push_back({client.fd, events, 0});
+            }
+        }
+
+        if (poll(fds.data(), fds.size(), LOCAL_POLL_TIMEOUT_MS) < 0 && errno != EINTR)
+        {
+            std::cout << "Local transport stopped: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        // only this thread adds or removes clients, so fds[i + 1] is connections[i]
+        for (size_t i = 0; i + 1 < fds.size(); i++)
+        {
+            LocalClient &client = connections[i];
+            bool open = (fds[i + 1].revents & (POLLERR | POLLNVAL)) == 0;
+            if (open && (fds[i + 1].revents & (POLLIN | POLLHUP)))
+            {
+                open = read_client(client);
+            }
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            if (!open)
+            {
+                client.broken = true;
+            }
+            else if (fds[i + 1].revents & POLLOUT)
+            {
+                flush_client(client);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            for (size_t i = connections.size(); i > 0; i--)
+            {
+                if (connections[i - 1].broken)
+                {
+                    close(connections[i - 1].fd);
+                    connections.erase(connections.begin() + (i - 1));
+                }
+            }
+            connected = connections.size();
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            accept_client();
+        }
+    }
+}
+
+json LocalTransport::to_json()
+{
+    json result;
+    result["clients"] = connected.load();
+    result["received"] = received.load();
+    result["sent"] = sent.load();
+    result["rejected"] = rejected.load();
+    result["dropped"] = dropped.load();
+    return result;
+}
@@ -0,0 +1,202 @@
+#include "../include/state-defs.hpp"
+
+ArmStateMachine arm_state;
+
+static uint64_t pack_state(ArmStateKind state, uint32_t owner)
+{
+    return ((uint64_t)owner << 32) | (uint64_t)state;
+}
+
+static ArmStateKind unpack_state(uint64_t word)
+{
+    return (ArmStateKind)(word & 0xff);
+}
+
+static uint32_t unpack_owner(uint64_t word)
+{
+    return (uint32_t)(word >> 32);
+}
+
+ArmStateMachine::ArmStateMachine()
+{
+    word = pack_state(ARM_IDLE, NO_CLIENT);
+    alerted = false;
+    // slot 0 is NO_CLIENT
+    interned = 1;
+    for (uint32_t slot = 0; slot < MAX_INTERNED_CLIENTS; slot++)
+    {
+        generations[slot] = 0;
+    }
+}
+
+uint32_t ArmStateMachine::intern(const std::string &id)
+{
+    if (id.empty())
+    {
+        return NO_CLIENT;
+    }
+    std::lock_guard<std::mutex> lock(intern_mutex);
+    std::unordered_map<std::string, uint32_t>::iterator it = handles.find(id);
+    if (it != handles.end())
+    {
+        return it->second;
+    }
+    uint32_t slot;
+    if (!free_slots.empty())
+    {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else if (interned < MAX_INTERNED_CLIENTS)
+    {
+        slot = interned++;
+    }
+    else
+    {
+        return NO_CLIENT;
+    }
+    uint32_t handle = (generations[slot] << HANDLE_SLOT_BITS) | slot;
+    ids[slot] = id;
+    handles[id] = handle;
+    return handle;
+}
+
+uint32_t ArmStateMachine::slot_of(uint32_t handle)
+{
+    uint32_t slot = handle & HANDLE_SLOT_MASK;
+    if (slot == NO_CLIENT || slot >= interned || ids[slot].empty() ||
+        generations[slot] != handle >> HANDLE_SLOT_BITS)
+    {
+        return NO_CLIENT;
+    }
+    return slot;
+}
+
+bool ArmStateMachine::release(uint32_t handle)
+{
+    std::lock_guard<std::mutex> lock(intern_mutex);
+    uint32_t slot = slot_of(handle);
+    if (slot == NO_CLIENT || owner() == handle)
+    {
+        return false;
+    }
+    handles.erase(ids[slot]);
+    ids[slot].clear();
+    // the next client of the slot gets a different handle
+    generations[slot] = (generations[slot] + 1) & (0xffffffffu >> HANDLE_SLOT_BITS);
+    free_slots.push_back(slot);
+    return true;
+}
+
+uint32_t ArmStateMachine::find(const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(intern_mutex);
+    std::unordered_map<std::string, uint32_t>::iterator it = handles.find(id);
+    return it == handles.end() ? NO_CLIENT : it->second;
+}
+
+std::string ArmStateMachine::client_id(uint32_t handle)
+{
+    std::lock_guard<std::mutex> lock(intern_mutex);
+    return ids[slot_of(handle)];
+}
+
+ArmStateKind ArmStateMachine::state()
+{
+    return unpack_state(word.load(std::memory_order_acquire));
+}
+
+uint32_t ArmStateMachine::owner()
+{
+    return unpack_owner(word.load(std::memory_order_acquire));
+}
+
+bool ArmStateMachine::error()
+{
+    return state() == ARM_ERROR || alerted.load(std::memory_order_acquire);
+}
+
+bool ArmStateMachine::transition(uint32_t from, ArmStateKind to, uint32_t client, ArmStateKind *previous)
+{
+    uint64_t current = word.load(std::memory_order_acquire);
+    while (true)
+    {
+        ArmStateKind state = unpack_state(current);
+        uint32_t owner = unpack_owner(current);
+        if ((from & STATE_MASK(state)) == 0)
+        {
+            return false;
+        }
+
+        uint32_t next_owner = owner;
+        if (state == ARM_IDLE)
+        {
+            next_owner = client == ANY_CLIENT ? NO_CLIENT : client;
+        }
+        else if (client != ANY_CLIENT && owner != client)
+        {
+            return false;
+        }
+        if (to == ARM_IDLE)
+        {
+            next_owner = NO_CLIENT;
+        }
+
+        if (word.compare_exchange_weak(current, pack_state(to, next_owner), std::memory_order_acq_rel))
+        {
+            if (previous != NULL)
+            {
+                *previous = state;
+            }
+            return true;
+        }
+    }
+}
+
+void ArmStateMachine::set_error()
+{
+    uint64_t current = word.load(std::memory_order_acquire);
+    while (!word.compare_exchange_weak(current, pack_state(ARM_ERROR, unpack_owner(current)),
+                                       std::memory_order_acq_rel))
+    {
+    }
+}
+
+bool ArmStateMachine::clear_error(uint32_t client)
+{
+    return client != NO_CLIENT && client != ANY_CLIENT && transition(STATE_MASK(ARM_ERROR), ARM_HOMING, client);
+}
+
+void ArmStateMachine::set_alert(bool raised)
+{
+    alerted.store(raised, std::memory_order_release);
+}
+
+bool ArmStateMachine::alert()
+{
+    return alerted.load(std::memory_order_acquire);
+}
+
+const char *ArmStateMachine::name(ArmStateKind state)
+{
+    switch (state)
+    {
+    case ARM_IDLE:
+        return "idle";
+    case ARM_HOMING:
+        return "homing";
+    case ARM_OWNED:
+        return "owned";
+    case ARM_MOVING:
+        return "moving";
+    case ARM_EXECUTING:
+        return "executing";
+    case ARM_CANCELLING:
+        return "cancelling";
+    case ARM_ERROR:
+        return "error";
+    case ARM_RELEASING:
+        return "releasing";
+    }
+    return "unknown";
+}
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include "../include/stream-defs.hpp"
+
+bool is_json_object(const void *payload, size_t length)
+{
+    const char *next = (const char *)payload;
+    const char *end = next + length;
+    while (next < end && (*next == ' ' || *next == '\t' || *next == '\n' || *next == '\r'))
+    {
+        next++;
+    }
+    return next < end && *next == '{';
+}
+
+/**
+ * Reads the coordinates of a point into the buffer. The first point gives
+ * the number of coordinates of the others
+ **/
+static bool stream_point(WireReader &in, FlatTrajectory &trajectory)
+{
+    bool has_coordinates = false;
+    std::string_view key;
+    if (!in.begin_object())
+    {
+        return false;
+    }
+    for (bool first = true; in.next_key(key, first); first = false)
+    {
+        if (key == "coordinates" && !has_coordinates)
+        {
+            if (!in.begin_array())
+            {
+                return false;
+            }
+            size_t count = 0;
+            for (bool item = true; in.next_item(item); item = false)
+            {
+                double value;
+                if (!in.read_number(value))
+                {
+                    return false;
+                }
+                trajectory.coordinates.push_back(value);
+                count++;
+            }
+            if (trajectory.joints == 0)
+            {
+                trajectory.joints = count;
+            }
+            if (in.failed() || count == 0 || count != trajectory.joints)
+            {
+                return false;
+            }
+            has_coordinates = true;
+        }
+        else if (!in.skip_value())
+        {
+            return false;
+        }
+    }
+    return !in.failed() && has_coordinates;
+}
+
+/**
+ * Reads the points of a trajectory ({"points":[...]}) into the buffer
+ **/
+static bool stream_trajectory(WireReader &in, FlatTrajectory &trajectory)
+{
+    bool has_points = false;
+    std::string_view key;
+    if (!in.begin_object())
+    {
+        return false;
+    }
+    for (bool first = true; in.next_key(key, first); first = false)
+    {
+        if (key == "points" && !has_points)
+        {
+            if (!in.begin_array())
+            {
+                return false;
+            }
+            for (bool item = true; in.next_item(item); item = false)
+            {
+                if (!stream_point(in, trajectory))
+                {
+                    return false;
+                }
+            }
+            has_points = !in.failed();
+        }
+        else if (!in.skip_value())
+        {
+            return false;
+        }
+    }
+    return !in.failed() && has_points && in.at_end();
+}
+
+bool stream_command(const char *payload, size_t length, CommandObject &command, FlatTrajectory &trajectory,
+                    TrajectoryFilter filter)
+{
+    trajectory.clear();
+
+    // the trajectory is only located here: its points are read at the end,
+    // once the signal and the client are known
+    const char *trajectory_begin = NULL;
+    const char *trajectory_end = NULL;
+    bool has_signal = false;
+    std::string_view key;
+    WireReader in = WireReader(payload, length);
+    if (!in.begin_object())
+    {
+        return false;
+    }
+    for (bool first = true; in.next_key(key, first); first = false)
+    {
+        bool ok = true;
+        if (key == "signal")
+        {
+            int signal = 0;
+            ok = in.read_integer(signal) && signal >= ARM_CHECK_STATUS && signal <= ARM_APPLY_CARTESIAN_TRAJECTORY;
+            command.signal = (CommandsSignal)signal;
+            has_signal = true;
+        }
+        else if (key == "client")
+        {
+            ok = wire_read(in, command.client);
+        }
+        else if (key == "error")
+        {
+            ok = in.read_bool(command.error);
+        }
+        else if (key == "point")
+        {
+            ok = wire_read(in, command.point);
+        }
+        else if (key == "simplify")
+        {
+            ok = wire_read(in, command.simplify);
+        }
+        else if (key == "trace")
+        {
+            ok = wire_read(in, command.trace);
+        }
+        else if (key == "trajectory")
+        {
+            trajectory_begin = in.position();
+            ok = in.skip_value();
+            trajectory_end = in.position();
+        }
+        else
+        {
+            ok = in.skip_value();
+        }
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    if (!has_signal || !in.at_end())
+    {
+        return false;
+    }
+
+    if (trajectory_begin == NULL || (filter != NULL && !filter(command.signal, command.client)))
+    {
+        return true;
+    }
+
+    // every coordinate but the last one is followed by a comma, so the commas
+    // bound the number of coordinates (and the buffer never grows)
+    trajectory.coordinates.reserve(std::count(trajectory_begin, trajectory_end, ',') + 1);
+    WireReader points = WireReader(trajectory_begin, trajectory_end - trajectory_begin);
+    if (!stream_trajectory(points, trajectory))
+    {
+        trajectory.clear();
+        return false;
+    }
+    return true;
+}
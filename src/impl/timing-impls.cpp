@@ -0,0 +1,136 @@
+#include <algorithm>
+#include "../include/timing-defs.hpp"
+
+/**
+ * The bucket of a duration and the largest duration of a bucket
+ **/
+static int bucket_of(long value)
+{
+    if (value < TIMING_SUB_BUCKETS)
+    {
+        return value < 0 ? 0 : (int)value;
+    }
+    int msb = 63 - __builtin_clzl((unsigned long)value);
+    // TIMING_SUB_BUCKETS = 16 = 2^4: the 4 bits after the most significant one
+    int range = msb - 3;
+    if (range > TIMING_RANGES)
+    {
+        return TIMING_BUCKETS - 1;
+    }
+    int sub = (int)((value >> (msb - 4)) - TIMING_SUB_BUCKETS);
+    return range * TIMING_SUB_BUCKETS + sub;
+}
+
+static long bucket_limit(int bucket)
+{
+    int range = bucket / TIMING_SUB_BUCKETS;
+    int sub = bucket % TIMING_SUB_BUCKETS;
+    if (range == 0)
+    {
+        return sub;
+    }
+    return ((long)(TIMING_SUB_BUCKETS + sub + 1) << (range - 1)) - 1;
+}
+
+TimingHistogram::TimingHistogram()
+{
+    reset();
+}
+
+void TimingHistogram::record(long nanoseconds)
+{
+    buckets[bucket_of(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    long current = worst.load(std::memory_order_relaxed);
+    while (nanoseconds > current && !worst.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+void TimingHistogram::record(std::chrono::steady_clock::duration duration)
+{
+    record((long)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+long TimingHistogram::count()
+{
+    return total.load(std::memory_order_relaxed);
+}
+
+long TimingHistogram::percentile(double p)
+{
+    // the buckets are read while they may be updated, so the count is taken
+    // from the buckets themselves
+    long counts[TIMING_BUCKETS];
+    long n = 0;
+    for (int b = 0; b < TIMING_BUCKETS; b++)
+    {
+        counts[b] = buckets[b].load(std::memory_order_relaxed);
+        n += counts[b];
+    }
+    if (n == 0)
+    {
+        return 0;
+    }
+    long rank = std::max(1L, (long)(p * n + 0.5));
+    long seen = 0;
+    for (int b = 0; b < TIMING_BUCKETS; b++)
+    {
+        seen += counts[b];
+        if (seen >= rank)
+        {
+            return std::min(bucket_limit(b), maximum());
+        }
+    }
+    return maximum();
+}
+
+long TimingHistogram::maximum()
+{
+    return worst.load(std::memory_order_relaxed);
+}
+
+void TimingHistogram::reset()
+{
+    for (int b = 0; b < TIMING_BUCKETS; b++)
+    {
+        buckets[b].store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    worst.store(0, std::memory_order_relaxed);
+}
+
+ControlTiming::ControlTiming(long period_us)
+{
+    period = std::chrono::microseconds(period_us);
+    ticks = 0;
+    misses = 0;
+}
+
+void ControlTiming::record_tick(std::chrono::steady_clock::time_point scheduled,
+                                std::chrono::steady_clock::time_point started,
+                                std::chrono::steady_clock::time_point finished)
+{
+    period_error.record(started - scheduled);
+    tick_work.record(finished - started);
+    ticks.fetch_add(1, std::memory_order_relaxed);
+    if (finished > scheduled + period)
+    {
+        misses.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+long ControlTiming::period_us()
+{
+    return (long)std::chrono::duration_cast<std::chrono::microseconds>(period).count();
+}
+
+void ControlTiming::reset()
+{
+    period_error.reset();
+    tick_work.reset();
+    send_ref.reset();
+    read_joints.reset();
+    ticks.store(0, std::memory_order_relaxed);
+    misses.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,454 @@
+#include <cmath>
+#include <cstring>
+#include <charconv>
+#include "../include/wire-defs.hpp"
+// generated at build time from edscorbot-async-api.yaml (src/tools/asyncapi_codegen.py)
+#include "messages-gen.hpp"
+
+WireReader::WireReader(const char *data, size_t length)
+{
+    next = data;
+    end = data + length;
+    error = false;
+}
+
+bool WireReader::failed()
+{
+    return error;
+}
+
+bool WireReader::fail()
+{
+    error = true;
+    return false;
+}
+
+void WireReader::skip_space()
+{
+    while (next < end && (*next == ' ' || *next == '\t' || *next == '\n' || *next == '\r'))
+    {
+        next++;
+    }
+}
+
+bool WireReader::expect(char c)
+{
+    skip_space();
+    if (next == end || *next != c)
+    {
+        return fail();
+    }
+    next++;
+    return true;
+}
+
+bool WireReader::at_end()
+{
+    skip_space();
+    return !error && next == end;
+}
+
+const char *WireReader::position()
+{
+    return next;
+}
+
+bool WireReader::begin_object()
+{
+    return expect('{');
+}
+
+bool WireReader::begin_array()
+{
+    return expect('[');
+}
+
+bool WireReader::next_key(std::string_view &key, bool first)
+{
+    if (error)
+    {
+        return false;
+    }
+    skip_space();
+    if (next < end && *next == '}' && first)
+    {
+        next++;
+        return false;
+    }
+    if (!first)
+    {
+        if (next < end && *next == '}')
+        {
+            next++;
+            return false;
+        }
+        if (!expect(','))
+        {
+            return false;
+        }
+    }
+    if (!expect('"'))
+    {
+        return false;
+    }
+    // keys are compared as they are written (the keys of the messages have no escapes)
+    const char *start = next;
+    while (next < end && *next != '"')
+    {
+        next += *next == '\\' ? 2 : 1;
+    }
+    if (next >= end)
+    {
+        return fail();
+    }
+    key = std::string_view(start, next - start);
+    next++;
+    return expect(':');
+}
+
+bool WireReader::next_item(bool first)
+{
+    if (error)
+    {
+        return false;
+    }
+    skip_space();
+    if (next < end && *next == ']')
+    {
+        next++;
+        return false;
+    }
+    return first || expect(',');
+}
+
+/**
+ * Appends a code point to a UTF-8 string
+ **/
+static void append_utf8(std::string &out, unsigned cp)
+{
+    if (cp < 0x80)
+    {
+        out += (char)cp;
+    }
+    else if (cp < 0x800)
+    {
+        out += (char)(0xc0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+    else if (cp < 0x10000)
+    {
+        out += (char)(0xe0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+    else
+    {
+        out += (char)(0xf0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3f));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+static bool read_hex4(const char *p, unsigned &value)
+{
+    value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+        {
+            value |= c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            value |= c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            value |= c - 'A' + 10;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WireReader::read_string(std::string &value)
+{
+    if (!expect('"'))
+    {
+        return false;
+    }
+    value.clear();
+    while (next < end && *next != '"')
+    {
+        // copies the runs without escapes at once
+        const char *run = next;
+        while (next < end && *next != '"' && *next != '\\')
+        {
+            if ((unsigned char)*next < 0x20)
+            {
+                return fail();
+            }
+            next++;
+        }
+        value.append(run, next - run);
+        if (next == end || *next == '"')
+        {
+            break;
+        }
+
+        if (end - next < 2)
+        {
+            return fail();
+        }
+        char e = next[1];
+        next += 2;
+        switch (e)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            value += e;
+            break;
+        case 'b':
+            value += '\b';
+            break;
+        case 'f':
+            value += '\f';
+            break;
+        case 'n':
+            value += '\n';
+            break;
+        case 'r':
+            value += '\r';
+            break;
+        case 't':
+            value += '\t';
+            break;
+        case 'u':
+        {
+            unsigned cp;
+            if (end - next < 4 || !read_hex4(next, cp))
+            {
+                return fail();
+            }
+            next += 4;
+            // surrogate pairs
+            if (cp >= 0xd800 && cp < 0xdc00)
+            {
+                unsigned low;
+                if (end - next < 6 || next[0] != '\\' || next[1] != 'u' || !read_hex4(next + 2, low) ||
+                    low < 0xdc00 || low >= 0xe000)
+                {
+                    return fail();
+                }
+                next += 6;
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            }
+            append_utf8(value, cp);
+            break;
+        }
+        default:
+            return fail();
+        }
+    }
+    if (next == end)
+    {
+        return fail();
+    }
+    next++;
+    return true;
+}
+
+bool WireReader::read_number(double &value)
+{
+    skip_space();
+    std::from_chars_result result = std::from_chars(next, end, value);
+    if (result.ec != std::errc() || result.ptr == next)
+    {
+        return fail();
+    }
+    next = result.ptr;
+    return true;
+}
+
+bool WireReader::read_integer(long long &value)
+{
+    skip_space();
+    std::from_chars_result result = std::from_chars(next, end, value);
+    if (result.ec != std::errc() || result.ptr == next)
+    {
+        return fail();
+    }
+    next = result.ptr;
+    // integers written as 3.0 are accepted
+    if (next < end && *next == '.')
+    {
+        next++;
+        while (next < end && *next == '0')
+        {
+            next++;
+        }
+        if (next < end && ((*next >= '1' && *next <= '9') || *next == 'e' || *next == 'E'))
+        {
+            return fail();
+        }
+    }
+    return true;
+}
+
+bool WireReader::read_bool(bool &value)
+{
+    skip_space();
+    if (end - next >= 4 && memcmp(next, "true", 4) == 0)
+    {
+        value = true;
+        next += 4;
+        return true;
+    }
+    if (end - next >= 5 && memcmp(next, "false", 5) == 0)
+    {
+        value = false;
+        next += 5;
+        return true;
+    }
+    return fail();
+}
+
+bool WireReader::skip_value()
+{
+    return skip_value(0);
+}
+
+bool WireReader::skip_value(int depth)
+{
+    if (depth > WIRE_MAX_DEPTH)
+    {
+        return fail();
+    }
+    skip_space();
+    if (next == end)
+    {
+        return fail();
+    }
+    std::string_view key;
+    switch (*next)
+    {
+    case '{':
+        next++;
+        for (bool first = true; next_key(key, first); first = false)
+        {
+            if (!skip_value(depth + 1))
+            {
+                return false;
+            }
+        }
+        return !error;
+    case '[':
+        next++;
+        for (bool first = true; next_item(first); first = false)
+        {
+            if (!skip_value(depth + 1))
+            {
+                return false;
+            }
+        }
+        return !error;
+    case '"':
+    {
+        std::string ignored;
+        return read_string(ignored);
+    }
+    case 't':
+    case 'f':
+    {
+        bool ignored;
+        return read_bool(ignored);
+    }
+    case 'n':
+        if (end - next >= 4 && memcmp(next, "null", 4) == 0)
+        {
+            next += 4;
+            return true;
+        }
+        return fail();
+    default:
+    {
+        double ignored;
+        return read_number(ignored);
+    }
+    }
+}
+
+void wire_write_string(std::string &out, const std::string &value)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if ((unsigned char)c < 0x20)
+            {
+                out += "\\u00";
+                out += hex[(c >> 4) & 0xf];
+                out += hex[c & 0xf];
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+void wire_write_number(std::string &out, double value)
+{
+    // as nlohmann::json: not finite numbers are null and integral values keep ".0"
+    if (!std::isfinite(value))
+    {
+        out += "null";
+        return;
+    }
+    char buffer[32];
+    std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr - buffer);
+    if (std::memchr(buffer, '.', result.ptr - buffer) == NULL && std::memchr(buffer, 'e', result.ptr - buffer) == NULL)
+    {
+        out += ".0";
+    }
+}
+
+void wire_write_integer(std::string &out, long long value)
+{
+    char buffer[24];
+    std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr - buffer);
+}
+
+void wire_write_bool(std::string &out, bool value)
+{
+    out += value ? "true" : "false";
+}
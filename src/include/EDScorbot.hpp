@@ -1,30 +1,21 @@
+#ifndef EDSCORBOT_HPP
+#define EDSCORBOT_HPP
+
 #include <string>
 #include "nlohmann/json.hpp"
-#include <map>
 #include <thread>
-#define SPIKE_GEN_FREQ_DIVIDER 0x01
-#define REF_ADDR 0x02
-#define PI_FD_ENABLE_ADDR 0x03
-#define PI_FD_ADDR 0x07
-#define PD_FD_ENABLE_ADDR 0x08
-#define PD_FD_ADDR 0x0c
-#define SPIKE_EXPANSOR_ADDR 0x12
-#define EI_FD_ENABLE_ADDR 0x13
-#define EI_FD_ADDR 0x17
-#define JOINT_STEP 0x20
+#include "registers-defs.hpp"
 
 // using namespace std;
 using json = nlohmann::json;
 
-static std::map<std::string, int> addresses = {
-    {"M1", 0x00},
-    {"M2", 0x20},
-    {"M3", 0x40},
-    {"M4", 0x60},
-    {"M5", 0x80},
-    {"M6", 0xA0}};
-
-// Data structure to hold SPID configuration for 1 joint
+/**
+ * @brief Number of the joint/motor identified by id ("M1" to "M6")
+ */
+inline int motor_number(const std::string &id)
+{
+    return id.size() == 2 && id[0] == 'M' ? id[1] - '0' : 0;
+}
 
 /**
  * @brief  Class to implement joint functionalities
@@ -41,13 +32,7 @@ public:
     int address;
     int jnum;
     std::string id;
-    std::map<std::string, int> controller = {
-        {"EI_FD_bank3_18bits", 0},
-        {"PD_FD_bank3_22bits", 0},
-        {"PI_FD_bank3_18bits", 0},
-        {"leds", 0},
-        {"ref", 0},
-        {"spike_expansor", 0}};
+    JointController controller = {};
 
     /**
      * @brief Construct a new EDScorbotJoint object specifying each parameter
@@ -62,14 +47,15 @@ public:
      */
     EDScorbotJoint(int EI_FD, int PD_FD, int PI_FD, int leds, int spike_exp, int address, std::string id)
     {
-        controller["EI_FD_bank3_18bits"] = EI_FD;
-        controller["PD_FD_bank3_22bits"] = PD_FD;
-        controller["PI_FD_bank3_18bits"] = PI_FD;
-        controller["leds"] = leds;
-        controller["ref"] = 0;
-        controller["spike_expansor"] = spike_exp;
+        controller.EI_FD_bank3_18bits = EI_FD;
+        controller.PD_FD_bank3_22bits = PD_FD;
+        controller.PI_FD_bank3_18bits = PI_FD;
+        controller.leds = leds;
+        controller.ref = 0;
+        controller.spike_expansor = spike_exp;
         this->id = id;
-        this->address = addresses[id];
+        this->jnum = motor_number(id);
+        this->address = joint_address(jnum);
     };
     /**
      * @brief Construct a new EDScorbotJoint object specifing motor ID and joint number (1-6)
@@ -82,7 +68,7 @@ public:
     EDScorbotJoint(std::string id, int jnum)
     {
         this->id = id;
-        this->address = addresses[id];
+        this->address = joint_address(jnum);
         this->jnum = jnum;
     }
     /**
@@ -142,16 +128,22 @@ public:
     /**
      * @brief Explicitly initialize joint 1-6 configuration using loaded json config file
      * 
+     * The configuration of the six joints is staged in `registers` and written in a single commit,
+     * so registers that already hold their value are not written again
      */
     void initJoints();
     void configureInit();//Eliminable, realmente initJoints hace el trabajo
-    void configureSPID(EDScorbotJoint);//Eliminable
-    void configureInit(EDScorbotJoint);//Eliminable
+    void configureSPID(EDScorbotJoint &);//Eliminable
+    void configureInit(EDScorbotJoint &);//Eliminable
     /**
      * @brief Initialize joint configuration for the specified joint
+     * 
+     * Stages the SPID configuration of the joint in `registers` (RegisterFile::stage_spid, which rejects values wider than a
+     * register) and commits it
+     * 
      * @param j Joint to be initialized
      */
-    void configureInitJoint(EDScorbotJoint);
+    void configureInitJoint(EDScorbotJoint &);
     /**
      * @brief Home routine, to be performed per joint
      * 
@@ -161,7 +153,7 @@ public:
      * @param j Joint to perform the home routine to
      * @param v Whether to behave verbosely or not
      */
-    void searchHome(EDScorbotJoint,bool);
+    void searchHome(EDScorbotJoint &, bool);
 
     /**
      * @brief Command a specific position to a specific joint
@@ -170,14 +162,14 @@ public:
      * @param ref Reference (position) to be commanded
      * @param j Joint to be commanded the reference `ref`
      */
-    int sendRef(int, EDScorbotJoint);
+    int sendRef(int, EDScorbotJoint &);
 
     /**
      * @brief 
      * 
      */
-    void resetCounter(EDScorbotJoint);//Eliminable
-    void configureLeds(int, EDScorbotJoint);//Eliminable
+    void resetCounter(EDScorbotJoint &);//Eliminable
+    void configureLeds(int, EDScorbotJoint &);//Eliminable
     void sendFPGAReset();//Eliminable
     void loadConfig(std::string);//Eliminable
     void dumpConfig(std::string);//Eliminable
@@ -186,7 +178,7 @@ public:
      * 
      * @param j Joint which we want to reset the position of
      */
-    void resetJPos(EDScorbotJoint);
+    void resetJPos(EDScorbotJoint &);
 
     /**
      * @brief Implements counter register value to position in angles transformation
@@ -247,6 +239,13 @@ public:
  */
     void readJoints(int *);
 #endif
+    /**
+     * @brief Shadow of the controllers' registers. Every write to the controllers goes through it
+     * (with a writer calling sendCommand16 on `bram_ptr`) and it must be invalidated by sendFPGAReset
+     */
+    RegisterFile registers;
 private:
     int *bram_ptr; //!< Pointer to the base memory address in which the FPGA registers are placed
-};
\ No newline at end of file
+};
+
+#endif
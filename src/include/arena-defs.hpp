@@ -0,0 +1,166 @@
+#ifndef ARENA_DEFS_HPP
+#define ARENA_DEFS_HPP
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <memory_resource>
+#include "server-defs.hpp"
+
+/**
+ * The size (bytes) of the buffer where a message is parsed. Commands are
+ * decoded without a document (see stream-defs.hpp), so only the other
+ * messages (metainfo requests) are parsed in it, unless the server is started
+ * with --command-decoder arena. A message using more memory
+ * takes the rest from the heap in big blocks. It can be changed with the
+ * option --message-arena (0 = no arena)
+ **/
+#define MESSAGE_ARENA_SIZE (16 * 1024)
+
+/**
+ * A monotonic arena where everything needed to parse one message is
+ * allocated. Nothing is freed individually: the whole arena is reset after
+ * the message has been handled, so parsing does not fragment the heap.
+ **/
+class MessageArena
+{
+public:
+    MessageArena(size_t size);
+
+    void *allocate(size_t bytes, size_t alignment);
+
+    /**
+     * Releases everything allocated since the last reset
+     **/
+    void reset();
+
+    /**
+     * Bytes allocated since the last reset
+     **/
+    size_t used();
+
+    /**
+     * Blocks allocated since the last reset
+     **/
+    long blocks();
+
+    /**
+     * The arena of the message being handled by this thread (NULL if none)
+     **/
+    static MessageArena *current();
+
+private:
+    std::vector<char> buffer;
+    std::pmr::monotonic_buffer_resource resource;
+    size_t allocated;
+    long allocations;
+};
+
+/**
+ * Makes an arena the current one of this thread while it exists, and resets
+ * the arena at the end. A NULL arena disables the arena in the scope
+ **/
+class ArenaScope
+{
+public:
+    ArenaScope(MessageArena *arena);
+    ~ArenaScope();
+
+private:
+    MessageArena *arena;
+    MessageArena *previous;
+};
+
+/**
+ * An allocator taking memory from the current arena of the thread, or from
+ * the heap when there is none. nlohmann::json builds a new allocator every
+ * time it allocates or frees a node, so each block records where it was
+ * taken from (a header before the block) and is freed accordingly, whatever
+ * the current arena is when it is freed. Values taken from an arena must
+ * still be destroyed before the arena is reset (within the same ArenaScope).
+ **/
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    /**
+     * Bytes before every block, holding the arena it was taken from (NULL =
+     * the heap). It keeps the alignment of the block
+     **/
+    static constexpr size_t header = alignof(std::max_align_t);
+
+    ArenaAllocator() {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        static_assert(alignof(T) <= header, "blocks are aligned to the header");
+        MessageArena *arena = MessageArena::current();
+        size_t bytes = header + n * sizeof(T);
+        char *block = (char *)(arena != NULL ? arena->allocate(bytes, header) : ::operator new(bytes));
+        *(MessageArena **)block = arena;
+        return (T *)(block + header);
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        // memory of the arena is released when it is reset
+        char *block = (char *)p - header;
+        if (*(MessageArena **)block == NULL)
+        {
+            ::operator delete(block);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+/**
+ * A JSON value whose nodes are allocated in the current arena
+ **/
+typedef nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double, ArenaAllocator> arena_json;
+
+/**
+ * Number of heap allocations (operator new) made by this thread so far. They
+ * are counted in every build, by replacing the global operator new
+ **/
+long allocation_count();
+
+/**
+ * Statistics of the memory used to handle the received messages
+ **/
+class MessageStats
+{
+public:
+    std::atomic<long> messages;
+    std::atomic<long> allocations;
+    std::atomic<long> max_allocations;
+    std::atomic<long> arena_allocations;
+    std::atomic<long> max_arena_bytes;
+
+    MessageStats();
+
+    /**
+     * Accounts a message handled with a number of heap allocations, and
+     * of blocks and bytes of the arena
+     **/
+    void record(long message_allocations, long arena_blocks, size_t arena_bytes);
+
+    json to_json();
+};
+
+/**
+ * Function that builds a command from a message of the async API parsed in
+ * an arena. Returns false if the message is not a valid command. Commands are
+ * decoded by stream_command (stream-defs.hpp) unless the server is started
+ * with --command-decoder arena
+ **/
+bool command_from_json(const arena_json &message, CommandObject &command);
+
+#endif
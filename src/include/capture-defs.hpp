@@ -0,0 +1,124 @@
+#ifndef CAPTURE_DEFS_HPP
+#define CAPTURE_DEFS_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <thread>
+
+#define CAPTURE_MAGIC "EDSCAP1"
+
+/**
+ * The period (milliseconds) at which the captured messages are written to
+ * the capture file
+ **/
+#define CAPTURE_FLUSH_MS 100
+
+/**
+ * The header at the beginning of a capture file. The time of every message
+ * is relative (microseconds) to the start of the capture, given in
+ * microseconds since the epoch
+ **/
+struct CaptureHeader
+{
+    char magic[8];
+    int64_t started_us;
+};
+
+/**
+ * The header of a captured message, followed by topic_length bytes of the
+ * topic and payload_length bytes of the payload
+ **/
+struct CaptureRecord
+{
+    int64_t time_us;
+    uint32_t topic_length;
+    uint32_t payload_length;
+};
+
+/**
+ * A message read from a capture file
+ **/
+class CapturedMessage
+{
+public:
+    int64_t time_us;
+    std::string topic;
+    std::string payload;
+
+    CapturedMessage()
+    {
+        time_us = 0;
+    }
+};
+
+/**
+ * A class that appends the messages received by the server to a capture
+ * file, so that a session can be replayed later (see session_replay).
+ * Messages are buffered as they arrive and a writer thread writes them to
+ * the file every CAPTURE_FLUSH_MS, so the thread receiving the messages
+ * never waits for the disk. A capture survives a crash of the server (the
+ * messages of the last CAPTURE_FLUSH_MS are lost).
+ **/
+class SessionCapture
+{
+public:
+    /**
+     * Number of messages captured
+     **/
+    long captured;
+
+    SessionCapture();
+    ~SessionCapture();
+
+    /**
+     * Starts capturing into a new file. An existing file is not replaced:
+     * returns false if the file exists or cannot be created
+     **/
+    bool open(const std::string &path);
+
+    bool is_open();
+
+    /**
+     * Appends a message with its arrival time
+     **/
+    void record(const char *topic, const void *payload, size_t length);
+
+    /**
+     * Writes the messages still buffered and closes the file
+     **/
+    void close();
+
+private:
+    FILE *file;
+    std::atomic<bool> running;
+    std::thread writer;
+    std::chrono::steady_clock::time_point started;
+
+    // the messages recorded and not written yet
+    std::string pending;
+    std::mutex pending_mutex;
+
+    void write_loop();
+
+    /**
+     * Writes the messages buffered to the file (only called by the writer)
+     **/
+    void flush();
+};
+
+/**
+ * Function that reads the header of a capture file
+ **/
+bool read_capture_header(FILE *file, CaptureHeader &header);
+
+/**
+ * Function that reads the next message of a capture file. Returns false at
+ * the end of the file (or if the last message is truncated)
+ **/
+bool read_captured_message(FILE *file, CapturedMessage &message);
+
+#endif
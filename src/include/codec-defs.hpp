@@ -0,0 +1,79 @@
+#ifndef CODEC_DEFS_HPP
+#define CODEC_DEFS_HPP
+
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdint>
+#include "server-defs.hpp"
+
+/**
+ * The name of the compact codec, as advertised in metainfo
+ **/
+#define CODEC_NAME "delta-varint"
+#define CODEC_VERSION 1
+
+/**
+ * The first byte of every encoded payload. JSON payloads and messages in the
+ * old format are text, so they never start with it
+ **/
+#define CODEC_MAGIC 0xED
+
+/**
+ * The kinds of encoded payloads: a command (a CommandObject with a point or
+ * a trajectory) and a batch of points the arm has been moved to (a sequence
+ * of MovedObject of the same owner)
+ **/
+#define CODEC_COMMAND 1
+#define CODEC_MOVED_BATCH 2
+
+/**
+ * The resolution (DEGREES) of joints without encoder references (the
+ * resolution of the other joints is one reference, see angle_to_ref)
+ *
+ * TODO: Adjust according to your arm
+ **/
+#define CODEC_DEFAULT_RESOLUTION 0.01
+
+/**
+ * Function that returns the compact codec of this arm
+ **/
+CodecInfo compact_codec();
+
+/**
+ * An encoded payload has the structure:
+ *
+ *   magic (1 byte) | kind (1 byte) | signal (varint, only commands) |
+ *   error (1 byte) | client id length (varint) | client id |
+ *   joints (varint) | points (varint) | resolution of each joint (float) |
+ *   coordinates
+ *
+ * The coordinates are quantized to the resolution of each joint. The first
+ * point is stored as it is and the others as the difference with the
+ * previous one, point by point, as zigzag varints (small differences take a
+ * single byte). All points must have the same number of coordinates.
+ **/
+
+/**
+ * Functions that encode a command and a batch of moved points. They return
+ * false (and leave payload empty) if the points do not have all the same
+ * number of coordinates
+ **/
+bool encode_command(CommandObject &command, const CodecInfo &codec, std::string &payload);
+bool encode_moved_batch(const Client &client, bool error, const std::list<Point> &points,
+                        const CodecInfo &codec, std::string &payload);
+
+/**
+ * Functions that decode a command and a batch of moved points. They return
+ * false if the payload is not of the expected kind or is corrupted
+ **/
+bool decode_command(const char *payload, size_t length, CommandObject &command);
+bool decode_moved_batch(const char *payload, size_t length, Client &client, bool &error,
+                        std::list<Point> &points);
+
+/**
+ * Function that says if a payload is encoded with the compact codec
+ **/
+bool is_encoded(const void *payload, size_t length);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef CONNECTION_DEFS_HPP
+#define CONNECTION_DEFS_HPP
+
+#include <random>
+
+/**
+ * The delays (milliseconds) before reconnecting to the broker: the first
+ * attempt waits about RECONNECT_INITIAL_DELAY_MS and every failed attempt
+ * doubles the delay up to RECONNECT_MAX_DELAY_MS
+ *
+ * TODO: Adjust according to your network and broker
+ **/
+#define RECONNECT_INITIAL_DELAY_MS 10
+#define RECONNECT_MAX_DELAY_MS 5000
+
+/**
+ * The keep alive (seconds) of the connection with the broker. A broker that
+ * stops answering is detected after 1.5 times this interval
+ **/
+#define BROKER_KEEPALIVE 5
+
+/**
+ * The longest time (milliseconds) the network loop waits for traffic
+ **/
+#define NETWORK_LOOP_TIMEOUT_MS 100
+
+/**
+ * A class computing the delays between attempts to reconnect: exponential
+ * backoff with jitter. Each delay is taken at random between half and all of
+ * the current backoff, so servers that lost the same broker do not retry all
+ * at once
+ **/
+class ReconnectBackoff
+{
+public:
+    ReconnectBackoff(long initial_ms, long max_ms);
+
+    /**
+     * The delay (milliseconds) before the next attempt. Every call doubles
+     * the backoff (up to the maximum)
+     **/
+    long next_delay();
+
+    /**
+     * Number of attempts since the last reset
+     **/
+    int attempts();
+
+    /**
+     * Must be called when the connection has been established
+     **/
+    void reset();
+
+private:
+    long initial;
+    long maximum;
+    long backoff;
+    int attempt;
+    std::mt19937 random;
+};
+
+#endif
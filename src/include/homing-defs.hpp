@@ -0,0 +1,92 @@
+#ifndef HOMING_DEFS_HPP
+#define HOMING_DEFS_HPP
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * The joints each joint must wait for before searching its home (indexes,
+ * J1 = 0). Joints without prerequisites search home at the same time. The
+ * wrist of the Scorbot is a differential (J4 and J5 share their motors'
+ * gears), so J5 is homed after J4
+ *
+ * TODO: Adjust according to the mechanical coupling of your arm
+ **/
+#define HOMING_PREREQUISITES {{}, {}, {}, {}, {3}, {}}
+
+/**
+ * The time (SECONDS) the simulated arm takes to search home on each joint.
+ * Homing one joint after the other takes the 4 seconds the simulator used
+ * to wait
+ **/
+#define SIMULATED_HOMING_TIMES {1.0, 0.9, 0.7, 0.5, 0.5, 0.4}
+
+/**
+ * The state of a joint during homing
+ **/
+enum JointHomingState
+{
+    HOMING_WAITING = 0,
+    HOMING_SEARCHING = 1,
+    HOMING_DONE = 2,
+    HOMING_FAILED = 3
+};
+
+/**
+ * A function that searches home on a joint (blocking until it is found).
+ * It returns false if home cannot be found
+ **/
+typedef std::function<bool(int joint)> JointHomer;
+
+/**
+ * A function notified when a joint changes its state. It can be called from
+ * several threads at once
+ **/
+typedef std::function<void(int joint, JointHomingState state)> HomingListener;
+
+/**
+ * A class that homes all joints of the arm, each one in its own thread as
+ * soon as its prerequisites are homed, so independent joints search home at
+ * the same time. A joint whose prerequisites fail (or that depends on itself
+ * through a cycle) fails without searching.
+ **/
+class ArmHoming
+{
+public:
+    ArmHoming(const std::vector<std::vector<int>> &prerequisites);
+
+    /**
+     * Homes all joints with homer, notifying listener of every change.
+     * Returns when no joint is searching, true if all of them are homed
+     **/
+    bool run(JointHomer homer, HomingListener listener);
+
+    JointHomingState state(int joint);
+
+    /**
+     * The state of every joint
+     **/
+    std::vector<int> states();
+
+    /**
+     * Number of joints homed
+     **/
+    int homed();
+
+    int joints();
+
+private:
+    std::vector<std::vector<int>> prerequisites;
+    std::vector<JointHomingState> joint_states;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    /**
+     * Searches home on a joint (in its own thread)
+     **/
+    void search(int joint, JointHomer homer, HomingListener listener);
+};
+
+#endif
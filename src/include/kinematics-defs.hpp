@@ -0,0 +1,104 @@
+#ifndef KINEMATICS_DEFS_HPP
+#define KINEMATICS_DEFS_HPP
+
+#include <vector>
+#include <list>
+#include "server-defs.hpp"
+
+/**
+ * Geometry of the EDScorbot (millimetres). The arm is a vertical articulated
+ * arm: J1 rotates the base around the vertical axis, J2 (shoulder), J3 (elbow)
+ * and J4 (wrist pitch) rotate in the vertical plane of the arm and J5 rolls
+ * the tool. J2 is measured from the horizontal, J3 and J4 relative to the
+ * previous link, all in DEGREES.
+ *
+ * TODO: Adjust the lengths and the zero of the joints according to your arm
+ **/
+#define KIN_BASE_HEIGHT 358.5
+#define KIN_BASE_OFFSET 50.0
+#define KIN_UPPER_ARM 300.0
+#define KIN_FOREARM 350.0
+#define KIN_TOOL 251.0
+
+/**
+ * Number of joints used by the kinematics (J1..J5). The gripper (J6) is not
+ * part of the pose and is passed through unchanged.
+ **/
+#define KIN_JOINTS 5
+
+/**
+ * Number of values of a cartesian pose: x, y, z (millimetres), pitch and
+ * roll of the tool (DEGREES)
+ **/
+#define KIN_POSE 5
+
+/**
+ * Inverse kinematics stops when the position error is below
+ * IK_POSITION_TOLERANCE (millimetres) and the pitch error is below
+ * IK_PITCH_TOLERANCE (DEGREES), or after IK_MAX_ITERATIONS iterations
+ **/
+#define IK_POSITION_TOLERANCE 0.01
+#define IK_PITCH_TOLERANCE 0.01
+#define IK_MAX_ITERATIONS 50
+
+/**
+ * Damping of the least squares solver, relative to the current error (the
+ * damping is IK_DAMPING times the error in millimetres). It avoids huge steps
+ * near singularities (arm stretched or tool over the base axis) and vanishes
+ * close to the solution, where the solver converges in a couple of iterations
+ **/
+#define IK_DAMPING 0.01
+
+/**
+ * A straight elbow (J3 = 0) is a singular configuration: the solver cannot
+ * find on which side to bend it. When the elbow starts within
+ * IK_STRAIGHT_ELBOW DEGREES of straight it is first bent by IK_ELBOW_BEND
+ * DEGREES (elbow up)
+ **/
+#define IK_STRAIGHT_ELBOW 1.0
+#define IK_ELBOW_BEND -10.0
+
+/**
+ * Maximum distance (millimetres) between two consecutive points of a joint
+ * trajectory expanded from cartesian waypoints
+ **/
+#define CARTESIAN_STEP 5.0
+
+/**
+ * Function that computes the pose of the tool (x, y, z, pitch, roll) for a
+ * single configuration of the joints (J1..J5)
+ **/
+void forward_kinematics(const double *joints, double *pose);
+
+/**
+ * Function that computes the poses of a whole trajectory at once. Joints are
+ * given column by column (all values of J1, then all values of J2, ...) and
+ * poses are returned the same way (all x, then all y, ...), so every loop
+ * runs over contiguous memory with independent iterations.
+ **/
+void forward_kinematics_batch(const double *joint_columns, size_t count, double *pose_columns);
+
+/**
+ * Function that computes the joints (J1..J5) reaching a pose with an iterative
+ * damped least squares solver. The solver starts from the values in joints
+ * (warm start, usually the solution of the previous point of a trajectory) and
+ * leaves the solution there. Returns false if the pose cannot be reached within
+ * the joint limits (METAINFOS), a roll beyond the limits of J5 included.
+ *
+ * iterations (optional) receives the number of iterations performed
+ **/
+bool inverse_kinematics(const double *pose, double *joints, int *iterations);
+
+/**
+ * Function that expands sparse cartesian waypoints (coordinates x, y, z,
+ * pitch, roll and optionally the gripper) into a dense joint trajectory. The
+ * path between waypoints is a straight line sampled every CARTESIAN_STEP
+ * millimetres, starting from the current position of the joints. Each point
+ * is solved starting from the solution of the previous one.
+ * Returns false if some point cannot be reached (a waypoint with a roll beyond
+ * the limits of J5 included).
+ **/
+bool expand_cartesian_trajectory(const std::vector<double> &current, const std::list<Point> &waypoints,
+                                 FlatTrajectory &trajectory);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef LEGACY_DEFS_HPP
+#define LEGACY_DEFS_HPP
+
+#include <string>
+#include <string_view>
+#include "server-defs.hpp"
+
+/**
+ * The topic used by the old clients (before the async API). Messages on
+ * this topic have the format [type,mode,url,n,sleep]
+ **/
+const std::string LEGACY_COMMANDS_TOPIC = "/EDScorbot/commands";
+
+/**
+ * The client identifier assigned to commands received in the old format.
+ * Old clients do not send any identification, so all of them are seen by
+ * the controller as this single client.
+ **/
+const std::string LEGACY_CLIENT_ID = "legacy";
+
+/**
+ * The possible types of a command in the old format
+ **/
+enum LegacyCommandType
+{
+    LEGACY_TRAJECTORY = 1,
+    LEGACY_MOVE_JOINT = 2,
+    LEGACY_RESET_SPID = 3,
+    LEGACY_HOME = 4
+};
+
+/**
+ * A class representing a command in the old format [type,mode,url,n,sleep].
+ * The url is a view into the received payload (nothing is copied), so a
+ * LegacyCommand object must not outlive the message it has been parsed from.
+ **/
+class LegacyCommand
+{
+public:
+    int type;
+    char mode;
+    std::string_view url;
+    int n;
+    int sleep;
+
+    LegacyCommand()
+    {
+        type = 0;
+        mode = '\0';
+        url = std::string_view();
+        n = 0;
+        sleep = 0;
+    }
+};
+
+/**
+ * Function that tokenizes a message in the old format. Differently from the
+ * old parse_command (strtok based), the payload is not modified and no field
+ * is copied into fixed size buffers. Fields after the type are optional.
+ * Returns false if the payload does not follow the old format.
+ **/
+bool parse_legacy_command(const char *payload, size_t length, LegacyCommand &command);
+
+/**
+ * Function that translates an old format command into the equivalent command
+ * of the async API. The position is the last known position of the arm and it
+ * is used to build the point of single joint movements.
+ * Returns false if the command has no equivalent in the async API.
+ **/
+bool legacy_to_command(const LegacyCommand &legacy, const Point &position, CommandObject &command);
+
+/**
+ * Function that loads a trajectory file referenced by an old format command.
+ * The file can contain a Jsonified Trajectory object or a list of points,
+ * where each point is a list of coordinates.
+ **/
+bool load_legacy_trajectory(std::string_view url, Trajectory &trajectory);
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef MODEL_DEFS_HPP
+#define MODEL_DEFS_HPP
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "nlohmann/json.hpp"
+
+/**
+ * The calibration of an arm with N joints. Joints with a reference factor
+ * (references per degree) are actionable: their limits are given in
+ * references. Joints without factor (0) are given directly in degrees.
+ **/
+template <size_t N>
+struct RobotCalibration
+{
+    std::array<double, N> ref_per_degree;
+    std::array<int, N> ref_minimum;
+    std::array<int, N> ref_maximum;
+    std::array<double, N> angle_minimum;
+    std::array<double, N> angle_maximum;
+    std::array<double, N> max_velocity;
+    std::array<double, N> max_acceleration;
+};
+
+/**
+ * The calibration of the EDScorbot (J1..J4 actionable, J5 and the gripper
+ * are only given in degrees).
+ *
+ * TODO: Adjust these values according to your arm. Velocities in DEGREES/s
+ * and accelerations in DEGREES/s^2
+ **/
+constexpr RobotCalibration<6> EDSCORBOT_CALIBRATION = {
+    {-3.0, -9.4, -3.1, -17.61158871, 0.0, 0.0},
+    {-450, -950, -350, -1500, 0, 0},
+    {500, 800, 350, 1600, 0, 0},
+    {0.0, 0.0, 0.0, 0.0, -360.0, 0.0},
+    {0.0, 0.0, 0.0, 0.0, 360.0, 100.0},
+    {60.0, 40.0, 50.0, 90.0, 120.0, 100.0},
+    {120.0, 80.0, 100.0, 180.0, 240.0, 200.0}};
+
+/**
+ * A model of an arm known at compile time: the number of joints and the
+ * calibration are template arguments, so positions are fixed size arrays
+ * and the limits and conversion tables are constants. Points of the wire
+ * protocol (any number of coordinates) are converted once at the border.
+ **/
+template <size_t N, const RobotCalibration<N> &C>
+class RobotModel
+{
+public:
+    static constexpr size_t joints = N;
+
+    typedef std::array<double, N> Joints;
+    typedef std::array<int32_t, N> References;
+
+    static constexpr bool actionable(size_t joint)
+    {
+        return C.ref_per_degree[joint] != 0.0;
+    }
+
+    /**
+     * Conversions between angles (DEGREES) and references of a joint (from
+     * 0). Joints that are not actionable have reference 0
+     **/
+    static constexpr int32_t angle_to_ref(size_t joint, double angle)
+    {
+        return actionable(joint) ? (int32_t)(C.ref_per_degree[joint] * angle) : 0;
+    }
+    static constexpr double ref_to_angle(size_t joint, int32_t ref)
+    {
+        return actionable(joint) ? ref / C.ref_per_degree[joint] : 0.0;
+    }
+
+    /**
+     * The limits of a joint in the order of its references, as published in
+     * metainfo (the minimum may be greater than the maximum)
+     **/
+    static constexpr double metainfo_minimum(size_t joint)
+    {
+        return actionable(joint) ? ref_to_angle(joint, C.ref_minimum[joint]) : C.angle_minimum[joint];
+    }
+    static constexpr double metainfo_maximum(size_t joint)
+    {
+        return actionable(joint) ? ref_to_angle(joint, C.ref_maximum[joint]) : C.angle_maximum[joint];
+    }
+
+    /**
+     * The limits of a joint in DEGREES, always lower <= upper
+     **/
+    static constexpr double lower(size_t joint)
+    {
+        return metainfo_minimum(joint) < metainfo_maximum(joint) ? metainfo_minimum(joint) : metainfo_maximum(joint);
+    }
+    static constexpr double upper(size_t joint)
+    {
+        return metainfo_minimum(joint) < metainfo_maximum(joint) ? metainfo_maximum(joint) : metainfo_minimum(joint);
+    }
+
+    static constexpr double max_velocity(size_t joint)
+    {
+        return C.max_velocity[joint];
+    }
+    static constexpr double max_acceleration(size_t joint)
+    {
+        return C.max_acceleration[joint];
+    }
+
+    /**
+     * Converts the position of all joints into references
+     **/
+    static References to_refs(const Joints &position)
+    {
+        References result;
+        for (size_t j = 0; j < N; j++)
+        {
+            result[j] = angle_to_ref(j, position[j]);
+        }
+        return result;
+    }
+
+    static Joints from_refs(const References &refs)
+    {
+        Joints result;
+        for (size_t j = 0; j < N; j++)
+        {
+            result[j] = ref_to_angle(j, refs[j]);
+        }
+        return result;
+    }
+
+    static bool within_limits(const Joints &position)
+    {
+        for (size_t j = 0; j < N; j++)
+        {
+            if (position[j] < lower(j) || position[j] > upper(j))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static Joints clamp(Joints position)
+    {
+        for (size_t j = 0; j < N; j++)
+        {
+            position[j] = position[j] < lower(j) ? lower(j) : (position[j] > upper(j) ? upper(j) : position[j]);
+        }
+        return position;
+    }
+
+    /**
+     * Converts the coordinates of a point of the wire protocol. Returns false
+     * if they are not exactly one per joint
+     **/
+    static bool from_coordinates(const std::vector<double> &coordinates, Joints &position)
+    {
+        if (coordinates.size() != N)
+        {
+            return false;
+        }
+        for (size_t j = 0; j < N; j++)
+        {
+            position[j] = coordinates[j];
+        }
+        return true;
+    }
+
+    static std::vector<double> to_coordinates(const Joints &position)
+    {
+        return std::vector<double>(position.begin(), position.end());
+    }
+
+    /**
+     * Reads the coordinates of a JSON point ({"coordinates":[...]}) directly
+     * into a position, without building a Point. Returns false if the point
+     * does not have one number per joint
+     **/
+    static bool parse_point(const nlohmann::json &point, Joints &position)
+    {
+        nlohmann::json::const_iterator coordinates = point.find("coordinates");
+        if (coordinates == point.end() || !coordinates->is_array() || coordinates->size() != N)
+        {
+            return false;
+        }
+        for (size_t j = 0; j < N; j++)
+        {
+            const nlohmann::json &c = (*coordinates)[j];
+            if (!c.is_number())
+            {
+                return false;
+            }
+            position[j] = c.get<double>();
+        }
+        return true;
+    }
+};
+
+/**
+ * The model of the arm of this controller
+ **/
+typedef RobotModel<6, EDSCORBOT_CALIBRATION> EDScorbotModel;
+
+static_assert(EDScorbotModel::angle_to_ref(0, 10.0) == -30, "J1 calibration");
+static_assert(EDScorbotModel::lower(0) < EDScorbotModel::upper(0), "J1 limits");
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef MOTION_DEFS_HPP
+#define MOTION_DEFS_HPP
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include "timing-defs.hpp"
+
+/**
+ * The period of the control loop (microseconds). At each period the loop
+ * samples the motion profile and sends the new references to the joints.
+ *
+ * TODO: Adjust the value according to the response time of your arm
+ **/
+#define CONTROL_PERIOD_US 1000
+
+/**
+ * The time (seconds) of a single point to point movement
+ **/
+#define DEFAULT_MOVE_DURATION 2.0
+
+/**
+ * The deceleration (DEGREES per second^2) of the fastest joint when a
+ * movement is cancelled (the other joints stop with it, on the same path)
+ *
+ * TODO: Adjust the value according to your arm
+ **/
+#define CANCEL_DECELERATION 360.0
+
+/**
+ * A movement finishes when the position read from the encoders of every
+ * joint stays within its tolerance (DEGREES) of the commanded position for
+ * SETTLE_TIME_US. If the joints have not settled SETTLE_TIMEOUT_US after the
+ * commanded movement finished, the movement fails
+ *
+ * TODO: Adjust according to the resolution of the encoders and the response
+ * of your arm
+ **/
+#define SETTLE_TOLERANCE {0.5, 0.5, 0.5, 0.5, 0.5, 1.0}
+#define SETTLE_TIME_US 20000
+#define SETTLE_TIMEOUT_US 2000000
+
+/**
+ * The possible results of a movement
+ **/
+enum MotionResult
+{
+    MOTION_DONE = 0,
+    MOTION_CANCELED = 1,
+    MOTION_TIMEOUT = 2
+};
+
+/**
+ * A function that fills position with the position (DEGREES) of each joint
+ * read from its encoder
+ **/
+typedef std::function<void(std::vector<double> &position)> JointReader;
+
+/**
+ * A class modelling the positions (in DEGREES) assumed by the joints during
+ * a movement, as a function of the time since the movement started.
+ **/
+class MotionProfile
+{
+public:
+    virtual ~MotionProfile() {}
+
+    /**
+     * The duration (seconds) of the movement
+     **/
+    virtual double duration() = 0;
+
+    /**
+     * Fills position with the position of each joint at time t (seconds)
+     **/
+    virtual void sample(double t, std::vector<double> &position) = 0;
+};
+
+/**
+ * A movement between two points that starts and finishes with all joints
+ * stopped (smoothstep interpolation)
+ **/
+class PointToPointProfile : public MotionProfile
+{
+public:
+    PointToPointProfile(std::vector<double> from, std::vector<double> to, double time);
+
+    double duration();
+    void sample(double t, std::vector<double> &position);
+
+private:
+    std::vector<double> start;
+    std::vector<double> target;
+    double time;
+};
+
+/**
+ * A class that executes movements in a periodic control loop. Movements can
+ * be preempted at any moment by cancel(): the loop is woken up immediately
+ * (it does not wait for the movement or the period to finish) and the joints
+ * are stopped with a controlled deceleration ramp.
+ *
+ * The instants of the last cancel request, of its detection by the loop
+ * (preemption) and of the stop of the joints are kept to measure latencies,
+ * and the timing of every tick of the loop is accounted in timing.
+ *
+ * With settling enabled, a movement does not finish with its profile: the
+ * loop keeps commanding the final position and reads the encoders until the
+ * joints settle (or the timeout expires)
+ **/
+class ArmMotion
+{
+public:
+    std::chrono::steady_clock::time_point cancel_time;
+    std::chrono::steady_clock::time_point preempt_time;
+    std::chrono::steady_clock::time_point stop_time;
+    ControlTiming timing;
+
+    /**
+     * Time (seconds) the joints took to settle after the profile of the last
+     * movement finished, and movements whose joints did not settle
+     **/
+    std::atomic<double> last_settle;
+    std::atomic<long> settle_timeouts;
+
+    ArmMotion(size_t joints, long period_us, double deceleration);
+
+    /**
+     * Enables settling with the tolerance (DEGREES) of each joint, the time
+     * the joints must stay within it and the timeout (microseconds). An empty
+     * tolerance disables it
+     **/
+    void set_settling(const std::vector<double> &tolerance, long settle_us, long timeout_us);
+
+    /**
+     * Sets the function reading the encoders. Without one, the commanded
+     * position is read
+     **/
+    void set_reader(JointReader reader);
+
+    /**
+     * Sets the minimum and maximum position (DEGREES) of each joint. The
+     * deceleration ramp of a cancelled movement never leaves them. Without
+     * them the ramp is not clamped
+     **/
+    void set_range(const std::vector<double> &minimum, const std::vector<double> &maximum);
+
+    /**
+     * Executes a movement, blocking the caller until the movement finishes
+     * or it is cancelled. Only one movement is executed at a time.
+     **/
+    MotionResult execute(MotionProfile &profile);
+
+    /**
+     * Executes a movement calling on_tick (in the control loop thread) with
+     * the time since the movement started, after each new position is sent
+     **/
+    MotionResult execute(MotionProfile &profile, std::function<void(double)> on_tick);
+
+    /**
+     * Requests the current (and any subsequent) movement to be cancelled.
+     * It can be called from any thread and does not block.
+     **/
+    void cancel();
+
+    /**
+     * Clears a previous cancel request
+     **/
+    void reset_cancel();
+
+    bool cancel_requested();
+
+    /**
+     * The current (commanded) position of the joints
+     **/
+    std::vector<double> position();
+
+    /**
+     * The position of the joints read from the encoders (accounted in
+     * timing.read_joints)
+     **/
+    std::vector<double> read_joints();
+
+    /**
+     * Fills position (one value per joint) with the position last sent to the
+     * joints without locking: it is published by the control loop in a
+     * sequence lock, so threads sampling it at a high rate (the recorder) do
+     * not contend with the control loop and are not accounted in timing
+     **/
+    void latest_position(double *position);
+
+    size_t joints();
+
+private:
+    size_t njoints;
+    std::chrono::microseconds period;
+    double deceleration;
+    std::atomic<bool> cancel_flag;
+    std::mutex motion_mutex;
+    std::mutex wait_mutex;
+    std::condition_variable wakeup;
+    std::mutex position_mutex;
+    std::vector<double> current;
+
+    /**
+     * The sequence lock of latest_position: the sequence is odd while the
+     * control loop writes a new position
+     **/
+    std::atomic<unsigned long> published_sequence;
+    std::unique_ptr<std::atomic<double>[]> published;
+    JointReader reader;
+    std::vector<double> minimum;
+    std::vector<double> maximum;
+    std::vector<double> tolerance;
+    std::chrono::microseconds settle_time;
+    std::chrono::microseconds settle_timeout;
+
+    /**
+     * Whether every joint read is within its tolerance of position
+     **/
+    bool within_tolerance(const std::vector<double> &position);
+
+    /**
+     * Waits until the next period or a cancel request. Returns true if
+     * the movement has been cancelled
+     **/
+    bool wait_tick(std::chrono::steady_clock::time_point next);
+
+    /**
+     * Stops the joints from the given velocities (DEGREES/second), reached
+     * at time t of profile. All joints share one ramp: the profile is
+     * followed with a clock slowing down to a stop, so the arm stays on the
+     * path and no joint decelerates faster than the deceleration
+     **/
+    void decelerate(MotionProfile &profile, double t, const std::vector<double> &velocity);
+
+    /**
+     * Sends a new position to the joints (accounted in timing.send_ref)
+     **/
+    void write_position(const std::vector<double> &position);
+};
+
+#endif
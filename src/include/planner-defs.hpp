@@ -0,0 +1,191 @@
+#ifndef PLANNER_DEFS_HPP
+#define PLANNER_DEFS_HPP
+
+#include <deque>
+#include <vector>
+#include "server-defs.hpp"
+#include "motion-defs.hpp"
+
+/**
+ * The default maximum distance (DEGREES, per joint) between a blended path
+ * and the corners (points) of a trajectory. A tolerance of 0 disables
+ * blending: the arm stops at every point. It can be changed with the option
+ * --blend-tolerance
+ **/
+#define DEFAULT_BLEND_TOLERANCE 1.0
+
+/**
+ * The number of upcoming points of a trajectory buffered by the planner
+ **/
+#define LOOKAHEAD_POINTS 16
+
+/**
+ * The shortest time (seconds) of a segment between two points (stopping at
+ * both ends, half of it between the blends of a blended trajectory)
+ **/
+#define MINIMUM_SEGMENT_TIME 0.001
+
+/**
+ * The number of bisection steps of the retiming when it looks for the
+ * highest velocity of a segment that a corner allows
+ **/
+#define RETIMING_SEARCH_STEPS 30
+
+/**
+ * A class representing the timing of a blended trajectory: the duration of
+ * each segment (segment i goes from point i to point i+1, where point 0 is
+ * the position of the arm when the trajectory starts) and the duration of
+ * the blend around each point (all in seconds).
+ *
+ * The arm can stop at some points (stops) instead of blending the corner:
+ * the blend of the point brings the arm to rest there and another blend
+ * (restarts) takes it from rest to the velocity of the next segment
+ **/
+class TrajectoryTiming
+{
+public:
+    std::vector<double> segments;
+    std::vector<double> blends;
+    std::vector<double> restarts;
+    std::vector<bool> stops;
+
+    /**
+     * The duration of the blended trajectory
+     **/
+    double total;
+
+    /**
+     * The duration of the same trajectory stopping at every point
+     **/
+    double point_to_point_total;
+
+    TrajectoryTiming()
+    {
+        total = 0.0;
+        point_to_point_total = 0.0;
+    }
+};
+
+/**
+ * Function that returns the limits of each joint of the arm (METAINFOS)
+ **/
+std::vector<JointInfo> joint_limits();
+
+/**
+ * Function that computes the shortest duration of a point to point movement
+ * (PointToPointProfile) respecting the velocity and acceleration limits of
+ * all joints
+ **/
+double point_to_point_time(const std::vector<double> &from, const std::vector<double> &to,
+                           const std::vector<JointInfo> &limits);
+
+/**
+ * Function that computes the fastest timing of a blended trajectory that
+ * respects the velocity and acceleration limits of each joint and keeps the
+ * deviation at the corners under the tolerance (DEGREES). The arm stops at
+ * the corners where blending costs more than stopping (a tolerance of 0
+ * stops at every point), so the timing is never slower than stopping at
+ * every point (point_to_point_total).
+ *
+ * Every blend fits in the half of the segments around its corner, so each
+ * corner only depends on the velocities of its two segments. Segments start
+ * at the velocity of their slowest joint and two sweeps lower them as the
+ * corners require (see sweep_corners): a backward one (the segment before a
+ * corner slows down for it) and a forward one (the segment after a corner
+ * speeds up from the one before as much as the corner allows). The sweeps
+ * are greedy, so they are also done from the velocities of stopping at every
+ * point and the fastest result is kept. The cost is linear in the number of
+ * points.
+ **/
+void retime_trajectory(const std::vector<double> &start, const FlatTrajectory &points,
+                       const std::vector<JointInfo> &limits, double tolerance, TrajectoryTiming &timing);
+
+/**
+ * Function that removes the points of a trajectory the path does not need
+ * (Ramer-Douglas-Peucker in joint space): no coordinate of a removed point
+ * deviates more than its tolerance (DEGREES, the last value applies to the
+ * remaining coordinates) from the segment joining the points kept around it.
+ * The deviation is measured at the closest position of the segment or, with
+ * timed, at the position the segment reaches at the same instant (the points
+ * are equally spaced in time), which keeps the points where the trajectory
+ * slows down. timed is a geometric approximation: it only chooses where the
+ * deviation is measured, the points kept are retimed afterwards like any
+ * trajectory, so the timing of the recording is not reproduced. The first and
+ * the last points are always kept. Returns the number of points removed.
+ **/
+size_t simplify_trajectory(FlatTrajectory &points, const std::vector<double> &tolerance, bool timed);
+
+/**
+ * A motion profile that executes a whole trajectory without stopping at the
+ * intermediate points. Consecutive points are joined by segments at constant
+ * velocity and the corners are replaced by parabolic blends, whose duration
+ * is chosen so that no joint deviates more than a tolerance from the point.
+ * The arm only stops at the last point.
+ *
+ * Points are consumed from the trajectory as the movement progresses: only
+ * the next lookahead points are kept (and planned) at a time. Because of that,
+ * sample() must be called with non decreasing times.
+ **/
+class BlendedProfile : public MotionProfile
+{
+public:
+    /**
+     * Builds the profile from the current position (start) through all
+     * points, with the durations of segments and blends given by timing
+     * (see retime_trajectory). The points and the timing must outlive the
+     * profile.
+     **/
+    BlendedProfile(std::vector<double> start, const FlatTrajectory &points, size_t joints,
+                   const TrajectoryTiming &timing, size_t lookahead);
+
+    double duration();
+    void sample(double t, std::vector<double> &position);
+
+    /**
+     * The number of points of the trajectory already passed at time t. At
+     * the end of the profile (duration()) every point has been passed
+     **/
+    size_t reached(double t);
+
+private:
+    /**
+     * A point of the trajectory (the start position is point 0) being planned
+     **/
+    struct Waypoint
+    {
+        std::vector<double> position;
+        std::vector<double> velocity_in;
+        std::vector<double> velocity_out;
+        double time;       // instant in which the blended path passes closest to the point
+        double blend;      // duration of the blend around the point
+        double restart;    // duration of the blend leaving the point from rest
+        double time_in;    // duration of the segment from the previous point
+        double time_out;   // duration of the segment to the next point
+        bool stop;         // the arm stops at the point (blend brings it to rest)
+        bool planned;      // velocity_out and blend are known
+
+        /**
+         * The instant of the middle of the blend towards the next point
+         * (time, unless the arm stops at the point)
+         **/
+        double departure() const
+        {
+            return stop ? time + (blend + restart) / 2 : time;
+        }
+    };
+
+    const FlatTrajectory &points;
+    size_t next_point;
+    std::deque<Waypoint> window;
+    size_t njoints;
+    size_t lookahead;
+    size_t front_index;
+    const TrajectoryTiming &timing;
+
+    /**
+     * Buffers and plans points until the window has lookahead points
+     **/
+    void fill_window();
+};
+
+#endif
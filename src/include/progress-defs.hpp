@@ -0,0 +1,81 @@
+#ifndef PROGRESS_DEFS_HPP
+#define PROGRESS_DEFS_HPP
+
+#include <chrono>
+#include <future>
+#include "server-defs.hpp"
+
+/**
+ * A class that decides when the progress of a trajectory must be published.
+ * Progress is computed for every executed point (or control tick), but it is
+ * published at most max_rate times per second, regardless of how dense the
+ * trajectory is. The first and the last updates are always published. The
+ * tracking error reported is the largest one since the last publication, so
+ * throttling does not hide error peaks.
+ **/
+class ProgressThrottle
+{
+public:
+    /**
+     * Number of updates that have not been published because of the rate limit
+     **/
+    long suppressed;
+
+    /**
+     * The simplification of the trajectory, attached to every progress
+     * message (empty if the trajectory has not been simplified)
+     **/
+    SimplificationReport simplification;
+
+    /**
+     * The estimated time (SECONDS) to execute the trajectory received, when it
+     * is computed by another thread while the simplified one runs. It fills
+     * the original duration of the simplification as soon as it is ready; the
+     * last update waits for it
+     **/
+    std::shared_future<double> original_duration;
+
+    /**
+     * Builds a throttle publishing at most max_rate (Hz) updates per second.
+     * A non positive rate disables the limit.
+     **/
+    ProgressThrottle(double max_rate);
+
+    /**
+     * Starts the progress of a trajectory with total points
+     **/
+    void start(int total);
+
+    /**
+     * Registers that point index (1..total) has been executed with the given
+     * tracking error. Returns true (and fills progress) if the update must be
+     * published now.
+     **/
+    bool update(int index, double tracking_error, ProgressObject &progress);
+
+    /**
+     * Fills the last progress of a trajectory that has been cancelled, at the
+     * last point executed, with the largest tracking error since the last
+     * publication. Returns false (nothing to publish) if the progress of the
+     * last point of the trajectory has already been published
+     **/
+    bool cancelled(ProgressObject &progress);
+
+private:
+    std::chrono::steady_clock::duration min_interval;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point last_publish;
+    bool published_any;
+    int total;
+    int last_index;
+    double max_tracking_error;
+};
+
+/**
+ * Function that computes the tracking error between a commanded and a
+ * measured point: the largest absolute difference among the joints (the
+ * coordinates beyond the joints in METAINFOS are ignored)
+ **/
+double tracking_error(const Point &commanded, const Point &measured);
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef PUBLISHER_DEFS_HPP
+#define PUBLISHER_DEFS_HPP
+
+#include <string>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <condition_variable>
+#include "server-defs.hpp"
+
+/**
+ * The number of outgoing messages handed to the broker connection and not
+ * yet sent (QoS 0) or acknowledged (QoS 1 and 2) above which the publisher
+ * is under backpressure. It can be changed with the option --publish-window
+ **/
+#define PUBLISH_HIGH_WATER 64
+
+/**
+ * The number of messages kept while the broker is unreachable, sent when the
+ * connection is back. When it is full, the oldest message of a droppable
+ * topic (telemetry) is discarded first. It can be changed with the option
+ * --outage-buffer
+ **/
+#define OUTAGE_BUFFER_MESSAGES 1024
+
+/**
+ * The number of messages waiting in the queue of the publisher thread above
+ * which droppable messages (telemetry) are discarded when they are posted,
+ * so a stalled publisher does not grow the queue without limit. Other
+ * messages (replies to commands) are always queued. It can be changed with
+ * the option --publish-queue
+ **/
+#define PUBLISH_QUEUE_MAX 4096
+
+/**
+ * The errors of the sender (MOSQ_ERR_NO_CONN and MOSQ_ERR_CONN_LOST) meaning
+ * the connection with the broker is down. The publisher does not depend on
+ * mosquitto, so their values are repeated here; the server checks them
+ * against mosquitto.h at compile time
+ **/
+#define PUBLISH_NO_CONNECTION 4
+#define PUBLISH_CONNECTION_LOST 7
+
+/**
+ * The QoS of telemetry (channels moved and progress) and of the replies to
+ * commands and metainfo. Telemetry is superseded by newer messages, so it
+ * does not need to be acknowledged
+ **/
+#define TELEMETRY_QOS 0
+#define CONTROL_QOS 1
+
+/**
+ * How messages of a topic are published: their QoS and if they can be
+ * shed under backpressure (only the newest pending message is kept)
+ **/
+class TopicPolicy
+{
+public:
+    int qos;
+    bool droppable;
+
+    TopicPolicy()
+    {
+        qos = CONTROL_QOS;
+        droppable = false;
+    }
+    TopicPolicy(int q, bool d)
+    {
+        qos = q;
+        droppable = d;
+    }
+};
+
+/**
+ * A function that hands a message to the broker connection (mosquitto_publish).
+ * It returns a mosquitto error code and the message id in mid
+ **/
+typedef std::function<int(const std::string &topic, const char *payload, size_t length, int qos, int *mid)> PublishSender;
+
+/**
+ * A message kept while the broker is unreachable
+ **/
+struct KeptMessage
+{
+    std::string topic;
+    std::string payload;
+    bool droppable;
+};
+
+/**
+ * A class that publishes the messages of the server applying a policy per
+ * topic and watching the outgoing queue.
+ *
+ * Every message handed to the connection is in flight until mosquitto
+ * notifies it has been sent (QoS 0) or acknowledged (QoS 1 and 2) through
+ * on_published. When the number of messages in flight reaches the high water
+ * mark, messages of droppable topics are not sent: only the newest one of
+ * each topic is kept (coalesced) and it is sent when the queue drains to half
+ * the mark. Messages of other topics (command replies) are always sent.
+ *
+ * While the connection with the broker is down (see disconnected) messages
+ * are kept in order in a bounded outage buffer and sent by reconnected.
+ **/
+class PublishPipeline
+{
+public:
+    /**
+     * Messages sent, messages replaced by a newer one while pending
+     * (coalesced), droppable messages rejected by the connection (dropped),
+     * other messages rejected by the connection (failed) and the largest
+     * number of messages in flight. During outages, messages kept (buffered)
+     * and messages discarded because the outage buffer was full (lost)
+     **/
+    std::atomic<long> published;
+    std::atomic<long> coalesced;
+    std::atomic<long> dropped;
+    std::atomic<long> failed;
+    std::atomic<long> max_in_flight;
+    std::atomic<long> buffered;
+    std::atomic<long> lost;
+
+    PublishPipeline(PublishSender sender, long high_water);
+
+    /**
+     * Sets the policy of a topic. Topics without a policy are published
+     * with CONTROL_QOS and are never dropped. Policies must be set before
+     * publishing
+     **/
+    void set_policy(const std::string &topic, TopicPolicy policy);
+
+    /**
+     * Changes the high water mark (number of messages in flight)
+     **/
+    void set_high_water(long high_water);
+
+    /**
+     * Changes the capacity (messages) of the outage buffer
+     **/
+    void set_outage_limit(long messages);
+
+    /**
+     * Must be called when the connection with the broker is lost (or before
+     * it is first established): messages are kept until reconnected
+     **/
+    void disconnected();
+
+    /**
+     * Must be called when the connection with the broker is (re)established:
+     * sends the messages kept during the outage, in order, and resumes
+     * publishing. Messages in flight when the connection was lost are
+     * forgotten (mosquitto resends or discards them on its own)
+     **/
+    void reconnected();
+
+    bool is_connected();
+
+    /**
+     * Publishes (or keeps pending, under backpressure) a message. Returns a
+     * mosquitto error code
+     **/
+    int publish(const std::string &topic, const char *payload, size_t length);
+
+    /**
+     * Must be called from the publish callback of mosquitto
+     **/
+    void on_published(int mid);
+
+    long in_flight();
+
+    /**
+     * The policy of a topic (CONTROL_QOS and not droppable if it has none)
+     **/
+    TopicPolicy policy_of(const std::string &topic);
+
+    json to_json();
+
+private:
+    PublishSender sender;
+    long high_water;
+    std::atomic<long> flight;
+    std::atomic<bool> backpressure;
+    std::map<std::string, TopicPolicy> policies;
+    std::mutex pending_mutex;
+    std::map<std::string, std::string> pending;
+    std::atomic<long> pending_count;
+    std::atomic<bool> connected;
+    std::mutex outage_mutex;
+    std::deque<KeptMessage> outage;
+    std::atomic<long> outage_count;
+    long outage_limit;
+
+    /**
+     * Sends a message, keeping it in the outage buffer if the connection is
+     * down
+     **/
+    int send(const std::string &topic, const char *payload, size_t length, const TopicPolicy &policy);
+
+    /**
+     * Hands a message to the connection and accounts it
+     **/
+    int transmit(const std::string &topic, const char *payload, size_t length, const TopicPolicy &policy);
+
+    /**
+     * Sends the pending (coalesced) messages
+     **/
+    void flush_pending();
+
+    /**
+     * Appends a message to the outage buffer (outage_mutex must be held)
+     **/
+    void keep(const std::string &topic, const char *payload, size_t length, bool droppable);
+};
+
+/**
+ * A message waiting to be published
+ **/
+struct OutboundMessage
+{
+    std::atomic<OutboundMessage *> next;
+    std::string topic;
+    std::string payload;
+};
+
+/**
+ * A class that publishes messages from a single thread. Any thread can post
+ * messages (multiple producers, single consumer): posting only links the
+ * message into a lock free queue, so producers (the control loop, motion
+ * threads and the mosquitto callback) never wait for the serialization of
+ * other messages nor for the network. The payload is moved into the queue,
+ * it is not copied. The queue is bounded for droppable messages (see
+ * PUBLISH_QUEUE_MAX). The consumer sleeps when the queue is empty and the
+ * producer that finds it sleeping wakes it up.
+ **/
+class PublisherThread
+{
+public:
+    /**
+     * Number of messages posted, delivered and discarded because the queue
+     * was full, and the largest number of messages waiting in the queue
+     **/
+    std::atomic<long> posted;
+    std::atomic<long> delivered;
+    std::atomic<long> discarded;
+    std::atomic<long> max_queued;
+
+    PublisherThread();
+    ~PublisherThread();
+
+    /**
+     * Starts the thread, which calls deliver for each posted message (in
+     * the order they were posted by each producer)
+     **/
+    void start(std::function<void(const std::string &topic, const std::string &payload)> deliver);
+
+    /**
+     * Stops the thread after delivering the messages already posted
+     **/
+    void stop();
+
+    /**
+     * Queues a message. A droppable message is discarded (returns false)
+     * when limit messages are already waiting
+     **/
+    bool post(const std::string &topic, std::string &&payload, bool droppable = false);
+
+    /**
+     * Changes the number of waiting messages above which droppable messages
+     * are discarded
+     **/
+    void set_limit(long messages);
+
+private:
+    std::function<void(const std::string &, const std::string &)> deliver;
+    std::thread consumer;
+    std::atomic<bool> running;
+    long limit;
+
+    // producers push at head, the consumer pops from tail (after the stub)
+    std::atomic<OutboundMessage *> head;
+    OutboundMessage *tail;
+    OutboundMessage stub;
+
+    // the consumer only sleeps when the queue is empty
+    std::atomic<bool> sleeping;
+    std::mutex wakeup_mutex;
+    std::condition_variable wakeup;
+
+    void push(OutboundMessage *message);
+    OutboundMessage *pop();
+    void run();
+};
+
+#endif
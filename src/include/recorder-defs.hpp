@@ -0,0 +1,171 @@
+#ifndef RECORDER_DEFS_HPP
+#define RECORDER_DEFS_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+/**
+ * The number of joint counters of each sample (the same six values filled
+ * by EDScorbot::readJoints)
+ **/
+#define RECORDER_JOINTS 6
+
+/**
+ * The default sampling rate (Hz) of the recorder. It can be changed with the
+ * option --record-rate
+ **/
+#define RECORDER_RATE_HZ 1000
+
+/**
+ * The number of samples kept in memory between the sampler and the writer
+ * (must be a power of two). At 1 kHz it holds 8 seconds of samples, so the
+ * writer can be delayed by a slow disk without losing samples
+ **/
+#define RECORDER_RING_SIZE 8192
+
+/**
+ * The maximum number of samples of a block of the recording file and the
+ * period (milliseconds) at which the writer flushes the samples to the file
+ **/
+#define RECORDER_BLOCK_SAMPLES 1024
+#define RECORDER_FLUSH_MS 100
+
+/**
+ * Files are rotated when they reach RECORDER_FILE_SIZE bytes. Only the last
+ * RECORDER_FILES files are kept (the oldest one is removed)
+ **/
+#define RECORDER_FILE_SIZE (16 * 1024 * 1024)
+#define RECORDER_FILES 8
+
+#define RECORDING_MAGIC "EDSREC1"
+#define RECORDING_BLOCK_MAGIC 0x314b4c42 // "BLK1"
+
+/**
+ * A sample of the joint counters. The time is in microseconds since the epoch
+ **/
+struct EncoderSample
+{
+    int64_t time_us;
+    int32_t counts[RECORDER_JOINTS];
+};
+
+/**
+ * The header at the beginning of every recording file
+ **/
+struct RecordingHeader
+{
+    char magic[8];
+    uint32_t joints;
+    uint32_t rate_hz;
+    int64_t created_us;
+};
+
+/**
+ * The header of a block of samples. A recording file is a RecordingHeader
+ * followed by blocks. Each block is stored by columns: the times of its
+ * count samples (int64_t), then the count values of J1 (int32_t), the count
+ * values of J2, and so on. The times of the first and last samples are kept
+ * in the header, so blocks out of a time window are skipped without reading
+ * them.
+ **/
+struct RecordingBlock
+{
+    uint32_t magic;
+    uint32_t count;
+    int64_t first_us;
+    int64_t last_us;
+};
+
+/**
+ * A function that reads the current value of the joint counters
+ **/
+typedef std::function<void(int32_t *counts)> EncoderReader;
+
+/**
+ * A class that records the joint counters at a high rate into rotating files.
+ *
+ * A sampler thread reads the counters at a fixed rate and pushes the samples
+ * into a lock free ring (single producer, single consumer). A writer thread
+ * drains the ring periodically and appends the samples to the current file
+ * as column oriented blocks. The sampler never waits for the writer: if the
+ * ring is full the sample is dropped (and counted), so recording does not
+ * disturb the control loop.
+ **/
+class EncoderRecorder
+{
+public:
+    /**
+     * Number of samples dropped because the ring was full, and number of
+     * samples written to the files
+     **/
+    std::atomic<long> dropped;
+    std::atomic<long> written;
+
+    /**
+     * Builds a recorder sampling with reader at rate_hz. Files are named
+     * prefix.N.rec, where N grows with every rotation and goes on after the
+     * highest N recorded before with the same prefix
+     **/
+    EncoderRecorder(EncoderReader reader, double rate_hz, std::string prefix);
+
+    ~EncoderRecorder();
+
+    /**
+     * Starts the sampler and the writer. Returns false if the first file
+     * cannot be created
+     **/
+    bool start();
+
+    /**
+     * Stops recording, writing the samples still in the ring
+     **/
+    void stop();
+
+private:
+    EncoderReader reader;
+    double rate_hz;
+    std::string prefix;
+    std::atomic<bool> running;
+    std::thread sampler;
+    std::thread writer;
+
+    // ring of samples. head is written by the sampler, tail by the writer
+    std::vector<EncoderSample> ring;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+
+    FILE *file;
+    long file_size;
+    int file_index;
+
+    void sample_loop();
+    void write_loop();
+
+    /**
+     * Writes the samples in the ring to the file. Returns the number of samples
+     **/
+    size_t flush();
+
+    bool open_file();
+};
+
+/**
+ * Function that reads the header of a recording file
+ **/
+bool read_recording_header(FILE *file, RecordingHeader &header);
+
+/**
+ * Function that reads the next block of a recording file. The samples are
+ * returned only if the block overlaps [from_us, to_us], otherwise the block
+ * is skipped (and times is left empty). Returns false at the end of the file
+ * or if the file is corrupted.
+ **/
+bool read_recording_block(FILE *file, const RecordingHeader &header, int64_t from_us, int64_t to_us,
+                          std::vector<int64_t> &times, std::vector<int32_t> &counts);
+
+#endif
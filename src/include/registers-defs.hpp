@@ -0,0 +1,173 @@
+#ifndef REGISTERS_DEFS_HPP
+#define REGISTERS_DEFS_HPP
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+/**
+ * The offsets of the registers of the controller of a joint, from the base
+ * address of the joint. The controllers of the joints are JOINT_STEP apart
+ **/
+#define SPIKE_GEN_FREQ_DIVIDER 0x01
+#define REF_ADDR 0x02
+#define PI_FD_ENABLE_ADDR 0x03
+#define PI_FD_ADDR 0x07
+#define PD_FD_ENABLE_ADDR 0x08
+#define PD_FD_ADDR 0x0c
+#define SPIKE_EXPANSOR_ADDR 0x12
+#define EI_FD_ENABLE_ADDR 0x13
+#define EI_FD_ADDR 0x17
+#define JOINT_STEP 0x20
+
+/**
+ * The address space of the controllers in the FPGA: the register of each
+ * joint is its base address (joint_address) plus the offset of the register.
+ * Addresses are a byte
+ **/
+#define CONTROLLER_ADDRESSES 0x100
+
+/**
+ * The base address of the controller of a joint (1 to 6)
+ **/
+constexpr int joint_address(int jnum)
+{
+    return (jnum - 1) * JOINT_STEP;
+}
+
+/**
+ * The values of the controller of a joint, as plain fields. The offset of
+ * the register of each field is known at compile time
+ **/
+struct JointController
+{
+    int EI_FD_bank3_18bits;
+    int PD_FD_bank3_22bits;
+    int PI_FD_bank3_18bits;
+    int leds;
+    int ref;
+    int spike_expansor;
+
+    static constexpr uint8_t EI_FD_offset = EI_FD_ADDR;
+    static constexpr uint8_t PD_FD_offset = PD_FD_ADDR;
+    static constexpr uint8_t PI_FD_offset = PI_FD_ADDR;
+    static constexpr uint8_t ref_offset = REF_ADDR;
+    static constexpr uint8_t spike_expansor_offset = SPIKE_EXPANSOR_ADDR;
+};
+
+/**
+ * The bank of the frequency dividers (PI_FD, PD_FD, EI_FD) used by the SPID
+ * controllers. The four banks of a divider follow its enable register (bank 3
+ * of PI_FD_ENABLE_ADDR is PI_FD_ADDR), and the enable register takes a bit
+ * per bank, so SPID_BANK_ENABLE enables bank 3 only
+ **/
+#define SPID_BANK 3
+#define SPID_BANK_ENABLE (1 << SPID_BANK)
+
+static_assert(PI_FD_ADDR == PI_FD_ENABLE_ADDR + 1 + SPID_BANK &&
+                  PD_FD_ADDR == PD_FD_ENABLE_ADDR + 1 + SPID_BANK &&
+                  EI_FD_ADDR == EI_FD_ENABLE_ADDR + 1 + SPID_BANK,
+              "the registers of the dividers are the bank SPID_BANK of their enable register");
+
+/**
+ * The largest value of a register. The dividers of bank 3 are wider (18 and
+ * 22 bits, as the fields of JointController say), but a register only takes
+ * 16 bits: a configuration with a value that does not fit is rejected instead
+ * of being truncated
+ **/
+#define REGISTER_MAX 0xFFFF
+
+/**
+ * A function writing a 16 bits value (high and low byte) into a register of
+ * the controllers. On the arm it is sendCommand16 (devmem.hpp) on the memory
+ * mapped by open_devmem. It returns 0 on success
+ **/
+typedef std::function<int(uint8_t address, uint8_t high, uint8_t low)> RegisterWriter;
+
+/**
+ * A class keeping a shadow copy of the registers of the controllers of every
+ * joint, so a configuration only writes the registers whose value changes.
+ * Writes are staged (several joints at once) and committed in a single pass
+ * over the memory mapped interface, in the order they were staged.
+ *
+ * The shadow only knows the values written through it: it must be
+ * invalidated whenever the controllers are reset (sendFPGAReset)
+ **/
+class RegisterFile
+{
+public:
+    /**
+     * Number of writes performed, avoided (the register already had the
+     * value, or a later write replaced it before the commit) and failed, and
+     * number of commits. Every staged write is counted once in one of them
+     **/
+    long written;
+    long avoided;
+    long failed;
+    long commits;
+
+    /**
+     * Time (SECONDS) spent writing configurations: all of them and the last one
+     **/
+    double configuration_time;
+    double last_configuration;
+
+    RegisterFile();
+
+    /**
+     * Stages a write of value into a register. A write of the value the
+     * register already has (or is about to have) is not staged. Returns true
+     * if the write has been staged
+     **/
+    bool stage(uint8_t address, uint16_t value);
+
+    /**
+     * Stages the SPID configuration of a joint whose registers start at base.
+     * Returns false, staging nothing, if a value of the configuration does not
+     * fit in a register (it is negative or above REGISTER_MAX)
+     **/
+    bool stage_spid(int base, const JointController &controller);
+
+    /**
+     * Number of writes staged and not committed yet
+     **/
+    size_t staged();
+
+    /**
+     * Performs the staged writes with writer. A register whose write fails
+     * is forgotten by the shadow (its value is unknown). Returns 0 or the
+     * result of the first write failed
+     **/
+    int commit(RegisterWriter writer);
+
+    /**
+     * Forgets the value of every register (and the writes staged)
+     **/
+    void invalidate();
+
+    /**
+     * Whether the value of a register is known, and its value
+     **/
+    bool known(uint8_t address);
+    uint16_t value(uint8_t address);
+
+    json to_json();
+
+private:
+    std::vector<uint16_t> shadow;
+    std::vector<bool> valid;
+
+    /**
+     * The writes staged, in order, and the position of each register in
+     * them (-1 = not staged), so a register staged twice is written once
+     **/
+    std::vector<std::pair<uint8_t, uint16_t>> pending;
+    std::vector<int> pending_index;
+    std::mutex mutex;
+};
+
+#endif
@@ -1,6 +1,14 @@
+#ifndef SERVER_DEFS_HPP
+#define SERVER_DEFS_HPP
+
 #include <string>
 #include <list>
+#include <vector>
+#include <chrono>
+#include <algorithm>
 #include "nlohmann/json.hpp"
+#include "state-defs.hpp"
+#include "model-defs.hpp"
 
 using json = nlohmann::json;
 
@@ -15,16 +23,21 @@ const std::string ROBOT_NAME = "EDScorbotSim";
 const std::string META_INFO = "metainfo";
 const std::string COMMANDS = "commands";
 const std::string MOVED = "moved";
+const std::string PROGRESS = "progress";
+const std::string TIMING = "timing";
 
-// commands and moved topics are built from controller name and channel names
+// commands, moved and progress topics are built from controller name and channel names
 std::string COMMANDS_TOPIC;
 std::string MOVED_TOPIC;
+std::string PROGRESS_TOPIC;
+std::string MOVED_BATCH_TOPIC;
+std::string TIMING_TOPIC;
 
 /**
  * Function to convert angles into reference values
  * DOUBT: angles in DEGREES or RADIANS?
  **/
-int angle_to_ref(int motor, float angle);
+int angle_to_ref(int motor, double angle);
 
 /**
  * Function to converto reference values into angles
@@ -32,15 +45,6 @@ int angle_to_ref(int motor, float angle);
  **/
 double ref_to_angle(int motor, int ref);
 
-/**
- * A global flag representing is the arm is in a error state or not.
- * This allows one to notify clients that an internal problem has
- * happened with the arm. The controller implementation should
- * consider mechanisms of detecting arm's errors to update this value,
- * as well as some efficient ways to recover from the failure
- **/
-static bool error_state = false;
-
 /**
  * The possible codes for a metainfo object
  **/
@@ -65,30 +69,47 @@ enum CommandsSignal
     ARM_CANCELED_TRAJECTORY = 10,
     ARM_DISCONNECT = 11,
     ARM_DISCONNECTED = 12,
-    ARM_HOME_SEARCHED = 13
+    ARM_HOME_SEARCHED = 13,
+    ARM_APPLY_CARTESIAN_TRAJECTORY = 14
 };
 
 /**
  * A class modelling the information about a robot joint.
  * It contains the minimum and que maximum values assumed
- * by a joint in DEGREES (angles)
+ * by a joint in DEGREES (angles), as well as the maximum
+ * velocity (DEGREES/s) and acceleration (DEGREES/s^2) of
+ * the joint. A limit equal to 0 means the joint is not limited
  **/
 class JointInfo
 {
 public:
     double minimum;
     double maximum;
+    double max_velocity;
+    double max_acceleration;
 
     JointInfo()
     {
         this->minimum = 0.0;
         this->maximum = 0.0;
+        this->max_velocity = 0.0;
+        this->max_acceleration = 0.0;
     }
 
     JointInfo(double min, double max)
     {
         minimum = min;
         maximum = max;
+        max_velocity = 0.0;
+        max_acceleration = 0.0;
+    }
+
+    JointInfo(double min, double max, double vel, double acc)
+    {
+        minimum = min;
+        maximum = max;
+        max_velocity = vel;
+        max_acceleration = acc;
     }
 
     /**
@@ -96,7 +117,9 @@ public:
      **/
     bool operator==(JointInfo other)
     {
-        return this->maximum == other.maximum && this->minimum == other.minimum;
+        return this->maximum == other.maximum && this->minimum == other.minimum &&
+               this->max_velocity == other.max_velocity &&
+               this->max_acceleration == other.max_acceleration;
     }
 
     /**
@@ -109,6 +132,8 @@ public:
 
         result["minimum"] = this->minimum;
         result["maximum"] = this->maximum;
+        result["maxVelocity"] = this->max_velocity;
+        result["maxAcceleration"] = this->max_acceleration;
 
         return result;
     }
@@ -133,6 +158,73 @@ public:
         JointInfo result = JointInfo();
         result.maximum = json_obj["maximum"];
         result.minimum = json_obj["minimum"];
+        if (json_obj.contains("maxVelocity"))
+        {
+            result.max_velocity = json_obj["maxVelocity"];
+        }
+        if (json_obj.contains("maxAcceleration"))
+        {
+            result.max_acceleration = json_obj["maxAcceleration"];
+        }
+
+        return result;
+    }
+};
+
+/**
+ * A class representing a compact encoding of points accepted and produced
+ * by the controller besides JSON (see codec-defs.hpp): its name, version and
+ * the resolution (angles) at which the coordinates of each joint are quantized
+ **/
+class CodecInfo
+{
+public:
+    std::string name;
+    int version;
+    std::vector<double> resolution;
+
+    CodecInfo()
+    {
+        this->name = "";
+        this->version = 0;
+        this->resolution = std::vector<double>();
+    }
+
+    /**
+     * Method to convert a CodecInfo object into a
+     * Niels Lohmann library JSON object
+     **/
+    json to_json()
+    {
+        json result;
+        result["name"] = this->name;
+        result["version"] = this->version;
+        result["resolution"] = this->resolution;
+
+        return result;
+    }
+
+    /**
+     * Static method to recover a CodecInfo object from a
+     * Niels Lohmann library JSON object
+     **/
+    static CodecInfo from_json(json json_obj)
+    {
+        return from_json_string(json_obj.dump());
+    }
+
+    /**
+     * Static method to recover a CodecInfo object from a
+     * string containing a suitable Jsonified codec object
+     **/
+    static CodecInfo from_json_string(std::string json_string)
+    {
+        json json_obj = json::parse(json_string);
+
+        CodecInfo result = CodecInfo();
+        result.name = json_obj["name"];
+        result.version = json_obj["version"];
+        result.resolution = json_obj["resolution"].get<std::vector<double>>();
 
         return result;
     }
@@ -147,12 +239,14 @@ public:
     MetaInfoSignal signal;
     std::string name;
     std::list<JointInfo> joints;
+    std::list<CodecInfo> codecs;
 
     MetaInfoObject()
     {
         this->signal = ARM_METAINFO;
         this->name = ROBOT_NAME;
         this->joints = std::list<JointInfo>();
+        this->codecs = std::list<CodecInfo>();
     }
 
     MetaInfoObject(MetaInfoSignal sig, std::string n, std::list<JointInfo> jts)
@@ -212,6 +306,17 @@ public:
         }
         result["joints"] = js;
 
+        // clients only knowing JSON ignore the codecs
+        if (!codecs.empty())
+        {
+            json cs = json::array();
+            for (CodecInfo c : codecs)
+            {
+                cs.push_back(c.to_json());
+            }
+            result["codecs"] = cs;
+        }
+
         return result;
     }
 
@@ -245,6 +350,15 @@ public:
             result.joints.push_back(ji);
         }
 
+        if (json_obj.contains("codecs"))
+        {
+            json codecs = json_obj["codecs"];
+            for (json::iterator it = codecs.begin(); it != codecs.end(); ++it)
+            {
+                result.codecs.push_back(CodecInfo::from_json(it.value()));
+            }
+        }
+
         return result;
     }
 };
@@ -323,9 +437,19 @@ public:
 };
 
 /**
- * A global variable meaning the owner of the arm.
+ * Function that returns the owner of the arm (see arm_state), or an invalid
+ * client if the arm has no owner.
+ *
+ * The arm is in an error state (ARM_ERROR) when an internal problem has
+ * happened with the arm. The controller implementation should consider
+ * mechanisms of detecting arm's errors (arm_state.set_error()), as well as
+ * some efficient ways to recover from the failure (arm_state.clear_error()).
+ * Here the owner recovers the arm connecting again: the arm searches home
  **/
-static Client owner = Client();
+Client owner_client()
+{
+    return Client(arm_state.client_id(arm_state.owner()));
+}
 
 /**
  * A class representing a point as a set of coordinates (values for each joint of the arm)
@@ -507,6 +631,305 @@ public:
     }
 };
 
+/**
+ * The points of a trajectory in a single contiguous buffer: the coordinate
+ * j of the point i is coordinates[i * joints + j]. All the points have the
+ * same number of coordinates (joints). It is the form in which trajectories
+ * are planned and executed
+ **/
+class FlatTrajectory
+{
+public:
+    size_t joints;
+    std::vector<double> coordinates;
+
+    FlatTrajectory()
+    {
+        joints = 0;
+    }
+
+    /**
+     * Number of points
+     **/
+    size_t size() const
+    {
+        return joints == 0 ? 0 : coordinates.size() / joints;
+    }
+
+    /**
+     * The coordinates of the point i
+     **/
+    const double *point(size_t i) const
+    {
+        return coordinates.data() + i * joints;
+    }
+
+    /**
+     * The point i as a Point
+     **/
+    Point to_point(size_t i) const
+    {
+        return Point(std::vector<double>(point(i), point(i) + joints));
+    }
+
+    /**
+     * Removes the points and releases the buffer
+     **/
+    void clear()
+    {
+        joints = 0;
+        std::vector<double>().swap(coordinates);
+    }
+
+    /**
+     * Appends the points to a list of points (as in Trajectory)
+     **/
+    void to_points(std::list<Point> &points) const
+    {
+        for (size_t i = 0; i < size(); i++)
+        {
+            points.push_back(to_point(i));
+        }
+    }
+
+    /**
+     * Builds the buffer from a list of points. Points with fewer coordinates
+     * than the longest one are completed with 0
+     **/
+    static FlatTrajectory from_points(const std::list<Point> &points)
+    {
+        FlatTrajectory result = FlatTrajectory();
+        for (const Point &p : points)
+        {
+            result.joints = std::max(result.joints, p.coordinates.size());
+        }
+        result.coordinates.reserve(points.size() * result.joints);
+        for (const Point &p : points)
+        {
+            result.coordinates.insert(result.coordinates.end(), p.coordinates.begin(), p.coordinates.end());
+            result.coordinates.resize(result.coordinates.size() + result.joints - p.coordinates.size(), 0.0);
+        }
+        return result;
+    }
+};
+
+/**
+ * A class representing a request to simplify a trajectory before executing
+ * it: the maximum deviation (DEGREES) of each joint from the points removed
+ * (the last value applies to the remaining joints) and whether the points are
+ * equally spaced in time (timed), as recorded by teach-in tools. timed only
+ * changes how deviations are measured: the simplified trajectory is retimed
+ * against the limits of the joints, as any other
+ **/
+class Simplification
+{
+public:
+    std::vector<double> tolerance;
+    bool timed;
+
+    Simplification()
+    {
+        tolerance = std::vector<double>();
+        timed = false;
+    }
+
+    Simplification(double tol, bool t)
+    {
+        tolerance = std::vector<double>(1, tol);
+        timed = t;
+    }
+
+    bool is_empty()
+    {
+        return tolerance.empty();
+    }
+
+    json to_json()
+    {
+        json result;
+        result["tolerance"] = tolerance;
+        result["timed"] = timed;
+
+        return result;
+    }
+
+    static Simplification from_json(json json_obj)
+    {
+        return from_json_string(json_obj.dump());
+    }
+
+    static Simplification from_json_string(std::string json_string)
+    {
+        json json_obj = json::parse(json_string);
+        Simplification result = Simplification();
+        result.tolerance = json_obj["tolerance"].get<std::vector<double>>();
+        if (json_obj.contains("timed"))
+        {
+            result.timed = json_obj["timed"];
+        }
+
+        return result;
+    }
+};
+
+/**
+ * A class summarizing the simplification of a trajectory: the number of
+ * points received and executed, and the estimated time (SECONDS) to execute
+ * the trajectory received and the simplified one
+ **/
+class SimplificationReport
+{
+public:
+    int original;
+    int kept;
+    double original_duration;
+    double duration;
+
+    SimplificationReport()
+    {
+        original = 0;
+        kept = 0;
+        original_duration = 0.0;
+        duration = 0.0;
+    }
+
+    bool is_empty()
+    {
+        return original == 0;
+    }
+
+    json to_json()
+    {
+        json result;
+        result["original"] = original;
+        result["kept"] = kept;
+        result["originalDuration"] = original_duration;
+        result["duration"] = duration;
+
+        return result;
+    }
+
+    static SimplificationReport from_json(json json_obj)
+    {
+        return from_json_string(json_obj.dump());
+    }
+
+    static SimplificationReport from_json_string(std::string json_string)
+    {
+        json json_obj = json::parse(json_string);
+        SimplificationReport result = SimplificationReport();
+        result.original = json_obj["original"];
+        result.kept = json_obj["kept"];
+        result.original_duration = json_obj["originalDuration"];
+        result.duration = json_obj["duration"];
+
+        return result;
+    }
+};
+
+/**
+ * A class representing the trace of a command: its sequence number and the
+ * instants (MICROSECONDS) it goes through, from the client to the answers of
+ * the controller. client_sent and received are wall-clock instants, the
+ * others are monotonic instants of the controller. Instants not reached are
+ * 0. Only commands that bring a sequence number (from 1) are traced
+ **/
+class TraceContext
+{
+public:
+    long long seq;
+    long long client_sent;
+    long long received;
+    long long received_monotonic;
+    long long dispatched;
+    long long motion_started;
+    long long motion_ended;
+    long long published;
+
+    TraceContext()
+    {
+        seq = 0;
+        client_sent = 0;
+        received = 0;
+        received_monotonic = 0;
+        dispatched = 0;
+        motion_started = 0;
+        motion_ended = 0;
+        published = 0;
+    }
+
+    bool is_empty()
+    {
+        return seq == 0;
+    }
+
+    static long long wall_clock()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static long long monotonic()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /**
+     * Sets an instant of the trace (one of its monotonic fields) to now, if
+     * the command is traced
+     **/
+    void mark(long long &instant)
+    {
+        if (seq != 0)
+        {
+            instant = monotonic();
+        }
+    }
+
+    json to_json()
+    {
+        json result;
+        result["seq"] = seq;
+        result["clientSent"] = client_sent;
+        result["received"] = received;
+        result["receivedMonotonic"] = received_monotonic;
+        result["dispatched"] = dispatched;
+        result["motionStarted"] = motion_started;
+        result["motionEnded"] = motion_ended;
+        result["published"] = published;
+
+        return result;
+    }
+
+    static TraceContext from_json(json json_obj)
+    {
+        return from_json_string(json_obj.dump());
+    }
+
+    static TraceContext from_json_string(std::string json_string)
+    {
+        json json_obj = json::parse(json_string);
+        TraceContext result = TraceContext();
+        result.seq = json_obj["seq"];
+        const char *instants[] = {"clientSent", "received", "receivedMonotonic", "dispatched",
+                                  "motionStarted", "motionEnded", "published"};
+        long long *fields[] = {&result.client_sent, &result.received, &result.received_monotonic, &result.dispatched,
+                               &result.motion_started, &result.motion_ended, &result.published};
+        for (int i = 0; i < 7; i++)
+        {
+            if (json_obj.contains(instants[i]))
+            {
+                *fields[i] = json_obj[instants[i]];
+            }
+        }
+
+        return result;
+    }
+};
+
 /**
  * Class modelling an object to be exchanged on channel ROBOT_NAME/commands.
  **/
@@ -518,32 +941,40 @@ public:
     bool error;
     Point point;
     Trajectory trajectory;
+    Simplification simplify;
+    TraceContext trace;
 
     CommandObject(CommandsSignal sig)
     {
         signal = sig;
         client = Client();
-        error = error_state;
+        error = arm_state.error();
         point = Point();
         trajectory = Trajectory();
+        simplify = Simplification();
+        trace = TraceContext();
     }
 
     CommandObject(CommandsSignal sig, Point p)
     {
         signal = sig;
         client = Client();
-        error = error_state;
+        error = arm_state.error();
         point = p;
         trajectory = Trajectory();
+        simplify = Simplification();
+        trace = TraceContext();
     }
 
     CommandObject(CommandsSignal sig, Trajectory t)
     {
         signal = sig;
         client = Client();
-        error = error_state;
+        error = arm_state.error();
         point = Point();
         trajectory = t;
+        simplify = Simplification();
+        trace = TraceContext();
     }
 
     bool operator==(CommandObject other)
@@ -578,7 +1009,7 @@ public:
         {
             result["client"] = client.to_json();
         }
-        result["error"] = error_state;
+        result["error"] = error;
         if (!point.is_empty())
         {
             result["point"] = this->point.to_json();
@@ -590,6 +1021,14 @@ public:
                 result["trajectory"] = this->trajectory.to_json();
             }
         }
+        if (!simplify.is_empty())
+        {
+            result["simplify"] = simplify.to_json();
+        }
+        if (!trace.is_empty())
+        {
+            result["trace"] = trace.to_json();
+        }
 
         return result;
     }
@@ -621,6 +1060,14 @@ public:
                 result.trajectory = t;
             }
         }
+        if (json_obj.contains("simplify"))
+        {
+            result.simplify = Simplification::from_json(json_obj["simplify"]);
+        }
+        if (json_obj.contains("trace"))
+        {
+            result.trace = TraceContext::from_json(json_obj["trace"]);
+        }
         return result;
     }
 };
@@ -634,17 +1081,18 @@ public:
     Client client;
     bool error;
     Point content;
+    TraceContext trace;
 
     MovedObject()
     {
-        client = owner;
-        error = error_state;
+        client = owner_client();
+        error = arm_state.error();
     }
 
     MovedObject(Point p)
     {
-        client = owner;
-        error = error_state;
+        client = owner_client();
+        error = arm_state.error();
         content = p;
     }
 
@@ -657,8 +1105,12 @@ public:
     {
         json result;
         result["client"] = client.to_json();
-        result["error"] = error_state;
+        result["error"] = error;
         result["content"] = content.to_json();
+        if (!trace.is_empty())
+        {
+            result["trace"] = trace.to_json();
+        }
 
         return result;
     }
@@ -677,6 +1129,234 @@ public:
         result.client = cli;
         result.error = error;
         result.content = p;
+        if (json_obj.contains("trace"))
+        {
+            result.trace = TraceContext::from_json(json_obj["trace"]);
+        }
+
+        return result;
+    }
+};
+
+/**
+ * A class representing the object to be exchanged on channel ROBOT_NAME/progress.
+ * It summarizes the execution of a trajectory: the index of the point being
+ * executed, the number of points, the elapsed time and the estimated time to
+ * finish (in seconds) and the tracking error (the largest difference, in
+ * DEGREES, between the commanded and the measured position of the joints)
+ **/
+class ProgressObject
+{
+public:
+    Client client;
+    bool error;
+    int index;
+    int total;
+    double elapsed;
+    double eta;
+    double tracking_error;
+    SimplificationReport simplification;
+    std::vector<int> homing;
+
+    ProgressObject()
+    {
+        client = owner_client();
+        error = arm_state.error();
+        index = 0;
+        total = 0;
+        elapsed = 0.0;
+        eta = 0.0;
+        tracking_error = 0.0;
+    }
+
+    ProgressObject(int idx, int tot, double elap, double et, double track)
+    {
+        client = owner_client();
+        error = arm_state.error();
+        index = idx;
+        total = tot;
+        elapsed = elap;
+        eta = et;
+        tracking_error = track;
+    }
+
+    bool operator==(ProgressObject other)
+    {
+        return index == other.index && total == other.total;
+    }
+
+    json to_json()
+    {
+        json result;
+        result["client"] = client.to_json();
+        result["error"] = error;
+        result["index"] = index;
+        result["total"] = total;
+        result["elapsed"] = elapsed;
+        result["eta"] = eta;
+        result["trackingError"] = tracking_error;
+        if (!simplification.is_empty())
+        {
+            result["simplification"] = simplification.to_json();
+        }
+        if (!homing.empty())
+        {
+            result["homing"] = homing;
+        }
+
+        return result;
+    }
+
+    static ProgressObject from_json(json json_obj)
+    {
+        return from_json_string(json_obj.dump());
+    }
+
+    static ProgressObject from_json_string(std::string json_string)
+    {
+        json json_obj = json::parse(json_string);
+        ProgressObject result = ProgressObject();
+        result.client = Client::from_json(json_obj["client"]);
+        result.error = json_obj["error"];
+        result.index = json_obj["index"];
+        result.total = json_obj["total"];
+        result.elapsed = json_obj["elapsed"];
+        result.eta = json_obj["eta"];
+        result.tracking_error = json_obj["trackingError"];
+        if (json_obj.contains("simplification"))
+        {
+            result.simplification = SimplificationReport::from_json(json_obj["simplification"]);
+        }
+        if (json_obj.contains("homing"))
+        {
+            result.homing = json_obj["homing"].get<std::vector<int>>();
+        }
+
+        return result;
+    }
+};
+
+/**
+ * A class summarizing a set of durations (MICROSECONDS) of the control loop:
+ * the number of durations, some percentiles and the maximum
+ **/
+class TimingStats
+{
+public:
+    long count;
+    double p50;
+    double p90;
+    double p99;
+    double p999;
+    double max;
+
+    TimingStats()
+    {
+        count = 0;
+        p50 = 0.0;
+        p90 = 0.0;
+        p99 = 0.0;
+        p999 = 0.0;
+        max = 0.0;
+    }
+
+    json to_json()
+    {
+        json result;
+        result["count"] = count;
+        result["p50"] = p50;
+        result["p90"] = p90;
+        result["p99"] = p99;
+        result["p999"] = p999;
+        result["max"] = max;
+
+        return result;
+    }
+
+    static TimingStats from_json(json json_obj)
+    {
+        return from_json_string(json_obj.dump());
+    }
+
+    static TimingStats from_json_string(std::string json_string)
+    {
+        json json_obj = json::parse(json_string);
+        TimingStats result = TimingStats();
+        result.count = json_obj["count"];
+        result.p50 = json_obj["p50"];
+        result.p90 = json_obj["p90"];
+        result.p99 = json_obj["p99"];
+        result.p999 = json_obj["p999"];
+        result.max = json_obj["max"];
+
+        return result;
+    }
+};
+
+/**
+ * A class representing the object to be exchanged on channel ROBOT_NAME/timing.
+ * It contains the timing of the control loop since the previous one: the
+ * period (MICROSECONDS), the number of ticks and of deadline misses, and the
+ * delay of the ticks with respect to their schedule (periodError), the time
+ * spent in each tick (tickWork), sending the references (sendRef) and reading
+ * the joints (readJoints)
+ **/
+class TimingObject
+{
+public:
+    Client client;
+    bool error;
+    long period;
+    long ticks;
+    long misses;
+    TimingStats period_error;
+    TimingStats tick_work;
+    TimingStats send_ref;
+    TimingStats read_joints;
+
+    TimingObject()
+    {
+        client = owner_client();
+        error = arm_state.error();
+        period = 0;
+        ticks = 0;
+        misses = 0;
+    }
+
+    json to_json()
+    {
+        json result;
+        result["client"] = client.to_json();
+        result["error"] = error;
+        result["period"] = period;
+        result["ticks"] = ticks;
+        result["misses"] = misses;
+        result["periodError"] = period_error.to_json();
+        result["tickWork"] = tick_work.to_json();
+        result["sendRef"] = send_ref.to_json();
+        result["readJoints"] = read_joints.to_json();
+
+        return result;
+    }
+
+    static TimingObject from_json(json json_obj)
+    {
+        return from_json_string(json_obj.dump());
+    }
+
+    static TimingObject from_json_string(std::string json_string)
+    {
+        json json_obj = json::parse(json_string);
+        TimingObject result = TimingObject();
+        result.client = Client::from_json(json_obj["client"]);
+        result.error = json_obj["error"];
+        result.period = json_obj["period"];
+        result.ticks = json_obj["ticks"];
+        result.misses = json_obj["misses"];
+        result.period_error = TimingStats::from_json(json_obj["periodError"]);
+        result.tick_work = TimingStats::from_json(json_obj["tickWork"]);
+        result.send_ref = TimingStats::from_json(json_obj["sendRef"]);
+        result.read_joints = TimingStats::from_json(json_obj["readJoints"]);
 
         return result;
     }
@@ -684,78 +1364,71 @@ public:
 
 /**
  * Function to convert angles into reference values. This function is
- * specific for each arm.
- *
- * TODO: Adjust this implementation according to your arm
+ * specific for each arm: the conversion factors are the calibration of
+ * EDScorbotModel (model-defs.hpp). The angle is not narrowed to float, so
+ * the references are the same as those of EDScorbotModel::to_refs.
  *
  * DOUBT: angles are in DEGREES or in RADIANS?
  **/
-int angle_to_ref(int motor, float angle)
+int angle_to_ref(int motor, double angle)
 {
-    switch (motor)
-    {
-    case 1:
-        return int(-3 * angle);
-    case 2:
-        return int(-9.4 * angle);
-    case 3:
-        return int(-3.1 * angle);
-    case 4:
-        return int(-17.61158871 * angle);
-    default:
+    if (motor < 1 || motor > (int)EDScorbotModel::joints || !EDScorbotModel::actionable(motor - 1))
+    {
         puts("Maximum actionable joint is J4 for them moment");
-        break;
+        return 0;
     }
-    return 0;
+    return EDScorbotModel::angle_to_ref(motor - 1, angle);
 }
 
 /**
  * Function to convert reference values into angles. This function is
- * specific for each arm.
- *
- * TODO: Adjust this implementation according to your arm
+ * specific for each arm: the conversion factors are the calibration of
+ * EDScorbotModel (model-defs.hpp).
  *
  * DOUBT: angles are in DEGREES or in RADIANS?
  **/
 double ref_to_angle(int motor, int ref)
 {
-    switch (motor)
-    {
-    case 1:
-        return ((-1.0 / 3.0) * ref);
-    case 2:
-        return ((-1 / 9.4) * ref);
-    case 3:
-        return ((-1 / 3.1) * ref);
-    case 4:
-        return (-0.056780795 * ref);
-    default:
+    if (motor < 1 || motor > (int)EDScorbotModel::joints || !EDScorbotModel::actionable(motor - 1))
+    {
         puts("Maximum actionable joint is J4 for them moment");
-        break;
+        return 0;
     }
-    return 0;
+    return EDScorbotModel::ref_to_angle(motor - 1, ref);
+}
+
+/**
+ * Function that builds the metainfo of the joints of an arm model
+ **/
+template <typename Model>
+std::list<JointInfo> model_metainfo()
+{
+    std::list<JointInfo> result;
+    for (size_t j = 0; j < Model::joints; j++)
+    {
+        result.push_back(JointInfo(Model::metainfo_minimum(j), Model::metainfo_maximum(j),
+                                   Model::max_velocity(j), Model::max_acceleration(j)));
+    }
+    return result;
 }
 
 /**
  * The global metainfo of this arm.
  *
- * TODO: Adjust only the reference values (the second argument of ref_to_angle)
- * for each motor
+ * TODO: Adjust the calibration of EDScorbotModel (EDSCORBOT_CALIBRATION):
+ * the limits in references of each motor, as well as the maximum velocity
+ * (DEGREES/s) and acceleration (DEGREES/s^2) of each joint
  *
  **/
-const std::list<JointInfo> METAINFOS =
-    {
-        JointInfo(ref_to_angle(1, -450), ref_to_angle(1, 500)),
-        JointInfo(ref_to_angle(2, -950), ref_to_angle(2, 800)),
-        JointInfo(ref_to_angle(3, -350), ref_to_angle(3, 350)),
-        JointInfo(ref_to_angle(4, -1500), ref_to_angle(4, 1600)),
-        JointInfo(-360, 360),
-        JointInfo(0, 100)};
+const std::list<JointInfo> METAINFOS = model_metainfo<EDScorbotModel>();
 
 /**
  * Function that build all topics using the robot name. Ex:
  * COMMANDS_TOPIC = ROBOT_NAME/commands
  * MOVED_TOPIC = ROBOT_NAME/moved
+ * PROGRESS_TOPIC = ROBOT_NAME/progress
+ * MOVED_BATCH_TOPIC = ROBOT_NAME/moved/batch
+ * TIMING_TOPIC = ROBOT_NAME/timing
  **/
 int build_topics();
 
@@ -765,6 +1438,11 @@ int build_topics();
  **/
 int publish_message(std::string topic, const char *buf);
 
+/**
+ * Function that publishes a message moving its payload (no copy)
+ **/
+int publish_message(const std::string &topic, std::string &&payload);
+
 /**
  * Function that checks if a message has a signal. This is useful to
  * detect if the incoming message follows the async specification
@@ -791,3 +1469,5 @@ void handle_metainfo_message(std::string mesage);
  * Function that handles messages delivered on channel ROBOT_NAME/commands
  **/
 void handle_commands_message(std::string mesage);
+
+#endif
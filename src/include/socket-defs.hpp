@@ -0,0 +1,146 @@
+#ifndef SOCKET_DEFS_HPP
+#define SOCKET_DEFS_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <sys/types.h>
+#include "server-defs.hpp"
+
+/**
+ * Frames exchanged on the local (Unix-domain) socket. Every frame carries
+ * one message of the async API:
+ *
+ *   uint32 length (big endian) - bytes after this field
+ *   uint16 topic length (big endian)
+ *   topic
+ *   payload - the same JSON (or encoded command) published on the topic
+ *
+ * Clients send commands (and metainfo requests) as they would publish them
+ * on the broker, and receive every message the server publishes.
+ **/
+#define LOCAL_FRAME_HEADER 6
+#define LOCAL_FRAME_MAX (16 * 1024 * 1024)
+
+/**
+ * The bytes waiting to be written to a local client above which the client
+ * is disconnected (it does not keep up with the server)
+ **/
+#define LOCAL_OUTPUT_MAX (4 * 1024 * 1024)
+
+/**
+ * The permissions of the socket: only the user running the server can
+ * connect. It can be changed with the option --local-socket-mode
+ **/
+#define LOCAL_SOCKET_MODE 0600
+
+#define LOCAL_MAX_CLIENTS 16
+#define LOCAL_POLL_TIMEOUT_MS 100
+
+/**
+ * A function that handles a message received from a local client. The
+ * payload is followed by a null character (as the payloads of mosquitto)
+ **/
+typedef std::function<void(const std::string &topic, const char *payload, size_t length)> LocalHandler;
+
+/**
+ * Appends a frame with a message to a buffer
+ **/
+void append_local_frame(std::string &buffer, const std::string &topic, const char *payload, size_t length);
+
+/**
+ * Writes a frame to a (blocking) socket and reads the next one. They return
+ * false when the connection is closed or the frame is malformed
+ **/
+bool write_local_frame(int fd, const std::string &topic, const char *payload, size_t length);
+bool read_local_frame(int fd, std::string &topic, std::string &payload);
+
+/**
+ * A connection of a local client
+ **/
+struct LocalClient
+{
+    int fd;
+    std::string input;
+    std::string output;
+    bool broken;
+};
+
+/**
+ * A class accepting commands of co-located clients on a Unix-domain socket.
+ * A thread accepts the clients and reads their frames, handing each message
+ * to the same handler as the messages of the broker, so local clients do not
+ * pay the round trip to the broker. Every message published by the server is
+ * broadcast to the local clients.
+ **/
+class LocalTransport
+{
+public:
+    /**
+     * Messages received and broadcast, malformed frames (their clients are
+     * disconnected) and clients disconnected because they did not keep up
+     **/
+    std::atomic<long> received;
+    std::atomic<long> sent;
+    std::atomic<long> rejected;
+    std::atomic<long> dropped;
+
+    LocalTransport();
+    ~LocalTransport();
+
+    /**
+     * Listens on the socket at path (replacing a stale one), with the
+     * permissions mode, and starts the thread. Returns false if the socket
+     * cannot be created
+     **/
+    bool start(const std::string &path, LocalHandler handler, mode_t mode = LOCAL_SOCKET_MODE);
+
+    /**
+     * Stops the thread, disconnects the clients and removes the socket
+     **/
+    void stop();
+
+    /**
+     * Sends a message to every local client
+     **/
+    void broadcast(const std::string &topic, const char *payload, size_t length);
+
+    /**
+     * Number of clients connected
+     **/
+    long clients();
+
+    json to_json();
+
+private:
+    std::string path;
+    LocalHandler handler;
+    int listener;
+    std::thread worker;
+    std::atomic<bool> running;
+    std::atomic<long> connected;
+
+    // clients are accepted and closed by the thread; their output is
+    // written by broadcast and by the thread
+    std::mutex clients_mutex;
+    std::vector<LocalClient> connections;
+
+    void run();
+    void accept_client();
+
+    /**
+     * Reads the available bytes of a client and handles its complete
+     * frames. Returns false when the client must be disconnected
+     **/
+    bool read_client(LocalClient &client);
+
+    /**
+     * Writes the pending output of a client (clients_mutex must be held)
+     **/
+    void flush_client(LocalClient &client);
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef STATE_DEFS_HPP
+#define STATE_DEFS_HPP
+
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The maximum number of clients (ids) known by the controller at once.
+ * Clients are interned when they connect and released when they disconnect
+ * (or their connection is refused), so the limit is rarely reached
+ **/
+#define MAX_INTERNED_CLIENTS 1024
+
+/**
+ * A handle is the slot of the client (lowest bits) and the generation of the
+ * slot (highest bits), so the handle of a released client never matches the
+ * client reusing its slot
+ **/
+#define HANDLE_SLOT_BITS 16
+#define HANDLE_SLOT_MASK ((1u << HANDLE_SLOT_BITS) - 1)
+
+/**
+ * The handle of no client, and a handle matching any owner in transitions
+ **/
+#define NO_CLIENT 0
+#define ANY_CLIENT 0xffffffffu
+
+/**
+ * The states of the arm:
+ * ARM_IDLE - nobody owns the arm
+ * ARM_HOMING - the owner has just connected and the arm is moving to home
+ * ARM_OWNED - the arm is stopped and waits for commands of its owner
+ * ARM_MOVING - the arm is moving to a single point
+ * ARM_EXECUTING - the arm is executing a trajectory
+ * ARM_CANCELLING - the trajectory has been cancelled and the arm is stopping
+ * ARM_ERROR - a problem with the physical arm has been detected
+ * ARM_RELEASING - the owner has disconnected while a command was running. The
+ *                 thread of the command takes the arm to ARM_IDLE when it stops
+ **/
+enum ArmStateKind
+{
+    ARM_IDLE = 0,
+    ARM_HOMING = 1,
+    ARM_OWNED = 2,
+    ARM_MOVING = 3,
+    ARM_EXECUTING = 4,
+    ARM_CANCELLING = 5,
+    ARM_ERROR = 6,
+    ARM_RELEASING = 7
+};
+
+/**
+ * Masks of states to be used as origin of a transition
+ **/
+#define STATE_MASK(state) (1u << (state))
+#define ANY_OWNED_STATE (STATE_MASK(ARM_HOMING) | STATE_MASK(ARM_OWNED) | STATE_MASK(ARM_MOVING) | \
+                         STATE_MASK(ARM_EXECUTING) | STATE_MASK(ARM_CANCELLING) | STATE_MASK(ARM_ERROR))
+
+/**
+ * The states in which a command thread (homing, movement or trajectory) runs
+ **/
+#define COMMAND_RUNNING_STATE (STATE_MASK(ARM_HOMING) | STATE_MASK(ARM_MOVING) | STATE_MASK(ARM_EXECUTING) | \
+                               STATE_MASK(ARM_CANCELLING))
+
+/**
+ * A class holding the state of the arm and its owner in a single atomic word,
+ * so every thread reads a consistent pair without locks. The state only
+ * changes through transitions (compare and swap) that check the current state
+ * and the owner at once.
+ *
+ * Clients are identified by handles: the id of a client is interned once and
+ * then ownership checks compare integers instead of strings.
+ **/
+class ArmStateMachine
+{
+public:
+    ArmStateMachine();
+
+    /**
+     * Returns the handle of a client id, registering it if it is new.
+     * Returns NO_CLIENT for an empty id or if there are too many clients
+     **/
+    uint32_t intern(const std::string &id);
+
+    /**
+     * Returns the handle of a client id, or NO_CLIENT if it is unknown (it
+     * is not connected)
+     **/
+    uint32_t find(const std::string &id);
+
+    /**
+     * Forgets a client, unless it owns the arm, so its slot can be reused.
+     * Its handle (kept by a thread finishing a movement) no longer matches
+     * any client. Returns false if the client has not been released
+     **/
+    bool release(uint32_t handle);
+
+    /**
+     * The id of the client with a handle ("" for NO_CLIENT or a released one)
+     **/
+    std::string client_id(uint32_t handle);
+
+    ArmStateKind state();
+    uint32_t owner();
+
+    /**
+     * The error flag of the messages: the arm is in ARM_ERROR or an alert
+     * has been raised
+     **/
+    bool error();
+
+    /**
+     * Moves to state to if the current state is in the mask from and the arm
+     * is owned by client (any owner with ANY_CLIENT). Moving from ARM_IDLE
+     * makes client the owner and moving to ARM_IDLE releases the owner. The
+     * state before the transition is returned in previous. Returns false
+     * (without changes) if the transition is not allowed.
+     **/
+    bool transition(uint32_t from, ArmStateKind to, uint32_t client, ArmStateKind *previous = NULL);
+
+    /**
+     * Moves to ARM_ERROR from any state, keeping the owner
+     **/
+    void set_error();
+
+    /**
+     * Leaves ARM_ERROR for ARM_HOMING if client owns the arm: after a failure
+     * the position of the joints is not trusted, so the arm searches home
+     * again before accepting movements. Returns false (without changes) if
+     * the arm is not in ARM_ERROR or client is not its owner
+     **/
+    bool clear_error(uint32_t client);
+
+    /**
+     * Raises or clears an alert: a problem reported in the error flag of the
+     * messages that does not stop the arm (the timing of the control loop)
+     **/
+    void set_alert(bool raised);
+    bool alert();
+
+    static const char *name(ArmStateKind state);
+
+private:
+    // state in the lowest 8 bits, owner in the highest 32
+    std::atomic<uint64_t> word;
+    std::atomic<bool> alerted;
+
+    /**
+     * The id ("" if it is free) and generation of each slot, the slots
+     * released and the number of slots used so far
+     **/
+    std::mutex intern_mutex;
+    std::unordered_map<std::string, uint32_t> handles;
+    std::string ids[MAX_INTERNED_CLIENTS];
+    uint32_t generations[MAX_INTERNED_CLIENTS];
+    std::vector<uint32_t> free_slots;
+    uint32_t interned;
+
+    /**
+     * The slot of a handle still in use, or NO_CLIENT. Requires intern_mutex
+     **/
+    uint32_t slot_of(uint32_t handle);
+};
+
+/**
+ * The state of the arm, shared by all threads of the controller
+ **/
+extern ArmStateMachine arm_state;
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef STREAM_DEFS_HPP
+#define STREAM_DEFS_HPP
+
+#include <vector>
+#include <list>
+#include "server-defs.hpp"
+#include "wire-defs.hpp"
+
+/**
+ * A function that says if the trajectory of a command must be decoded,
+ * given the signal and the client of the command. Trajectories that are
+ * going to be ignored (a client that does not own the arm) are skipped
+ * without decoding their points
+ **/
+typedef bool (*TrajectoryFilter)(CommandsSignal signal, const Client &client);
+
+/**
+ * Function that decodes a CommandObject in JSON while reading it, without
+ * building a document. The signal, the client, the error and the point are
+ * read first (the trajectory is skipped); then, if the signal is valid and
+ * the filter (if any) accepts the command, the points of the trajectory are
+ * written into the trajectory buffer, reserved once from the size of the
+ * payload. The points of the command are left empty.
+ *
+ * Returns false, without throwing, if the payload is not a valid command: it
+ * is not JSON, the signal is missing or unknown, a field has a wrong type or
+ * the points of the trajectory do not have all the same number of
+ * coordinates.
+ **/
+bool stream_command(const char *payload, size_t length, CommandObject &command, FlatTrajectory &trajectory,
+                    TrajectoryFilter filter = NULL);
+
+/**
+ * Function that says if a payload is a JSON object (its first character
+ * other than white space is '{'). Messages in the old format are arrays
+ **/
+bool is_json_object(const void *payload, size_t length);
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef TIMING_DEFS_HPP
+#define TIMING_DEFS_HPP
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * Buckets of a timing histogram: the durations below TIMING_SUB_BUCKETS
+ * nanoseconds have a bucket each, and every power of two above them is split
+ * into TIMING_SUB_BUCKETS buckets (an error below 1/TIMING_SUB_BUCKETS of the
+ * value). TIMING_RANGES powers of two cover up to about 17 seconds
+ **/
+#define TIMING_SUB_BUCKETS 16
+#define TIMING_RANGES 31
+#define TIMING_BUCKETS (TIMING_SUB_BUCKETS * (TIMING_RANGES + 1))
+
+/**
+ * The number of deadline misses of the control loop (since the last reset)
+ * above which the timing alert is raised (see ArmStateMachine::set_alert).
+ * It can be changed with the option --miss-threshold
+ *
+ * TODO: Adjust according to the tolerance of your arm to late references
+ **/
+#define TIMING_MISS_THRESHOLD 10
+
+/**
+ * A histogram of durations (nanoseconds). Recording never blocks nor
+ * allocates: it is a relaxed atomic increment of a bucket (plus a compare
+ * and swap when the maximum grows), so it can be used from the control loop
+ * while other threads read percentiles.
+ **/
+class TimingHistogram
+{
+public:
+    TimingHistogram();
+
+    void record(long nanoseconds);
+    void record(std::chrono::steady_clock::duration duration);
+
+    /**
+     * Number of durations recorded since the last reset
+     **/
+    long count();
+
+    /**
+     * The duration (nanoseconds) below which a fraction p (0..1) of the
+     * durations are. It is the upper bound of a bucket, never above the
+     * maximum
+     **/
+    long percentile(double p);
+
+    /**
+     * The longest duration (nanoseconds) since the last reset
+     **/
+    long maximum();
+
+    void reset();
+
+private:
+    std::atomic<long> buckets[TIMING_BUCKETS];
+    std::atomic<long> total;
+    std::atomic<long> worst;
+};
+
+/**
+ * The timing of the control loop:
+ * period_error - delay of the start of each tick with respect to its schedule
+ * tick_work - time spent in each tick (sampling, sending the references and
+ *             notifying the tick)
+ * send_ref - time spent sending the references to the joints
+ * read_joints - time spent reading the position of the joints
+ * A tick is a deadline miss if it finishes after the next tick should have
+ * started.
+ **/
+class ControlTiming
+{
+public:
+    TimingHistogram period_error;
+    TimingHistogram tick_work;
+    TimingHistogram send_ref;
+    TimingHistogram read_joints;
+    std::atomic<long> ticks;
+    std::atomic<long> misses;
+
+    ControlTiming(long period_us);
+
+    /**
+     * Accounts a tick scheduled at scheduled, that started at started and
+     * finished at finished
+     **/
+    void record_tick(std::chrono::steady_clock::time_point scheduled, std::chrono::steady_clock::time_point started,
+                     std::chrono::steady_clock::time_point finished);
+
+    /**
+     * The period (microseconds) of the control loop
+     **/
+    long period_us();
+
+    void reset();
+
+private:
+    std::chrono::steady_clock::duration period;
+};
+
+#endif
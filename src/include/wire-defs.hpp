@@ -0,0 +1,314 @@
+#ifndef WIRE_DEFS_HPP
+#define WIRE_DEFS_HPP
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "server-defs.hpp"
+
+/**
+ * The maximum nesting of objects and arrays skipped by WireReader (unknown
+ * fields of a message)
+ **/
+#define WIRE_MAX_DEPTH 32
+
+/**
+ * A reader of JSON text used by the generated decoders (messages-gen.hpp).
+ * It reads the values in place, without building a document, and never
+ * throws: every method returns false (and failed() is true) on malformed
+ * input.
+ **/
+class WireReader
+{
+public:
+    WireReader(const char *data, size_t length);
+
+    /**
+     * Objects are read as begin_object and then next_key until it returns
+     * false (at the end of the object or on error). The first call must give
+     * first = true. Arrays are read in the same way with next_item
+     **/
+    bool begin_object();
+    bool next_key(std::string_view &key, bool first);
+    bool begin_array();
+    bool next_item(bool first);
+
+    bool read_string(std::string &value);
+    bool read_number(double &value);
+    bool read_bool(bool &value);
+    bool read_integer(long long &value);
+
+    template <typename T>
+    bool read_integer(T &value)
+    {
+        static_assert(std::is_integral<T>::value, "the field is not an integer in the AsyncAPI document");
+        long long v;
+        if (!read_integer(v))
+        {
+            return false;
+        }
+        value = (T)v;
+        return true;
+    }
+
+    /**
+     * Skips a value of any type (fields unknown by the decoder)
+     **/
+    bool skip_value();
+
+    /**
+     * True if only white space is left
+     **/
+    bool at_end();
+
+    /**
+     * The next character to be read (white space included)
+     **/
+    const char *position();
+
+    bool failed();
+
+private:
+    const char *next;
+    const char *end;
+    bool error;
+
+    void skip_space();
+    bool fail();
+    bool expect(char c);
+    bool skip_value(int depth);
+};
+
+/**
+ * Writers of JSON values used by the generated encoders
+ **/
+void wire_write_string(std::string &out, const std::string &value);
+void wire_write_number(std::string &out, double value);
+void wire_write_integer(std::string &out, long long value);
+void wire_write_bool(std::string &out, bool value);
+
+/**
+ * Writes the separator and the name of a field
+ **/
+inline void wire_write_key(std::string &out, bool &first, const char *key)
+{
+    if (!first)
+    {
+        out += ',';
+    }
+    first = false;
+    out += '"';
+    out += key;
+    out += "\":";
+}
+
+/**
+ * Optional fields (not required in the AsyncAPI document) holding an object
+ * or an array are only written if they have content
+ **/
+inline bool wire_present(const Client &c)
+{
+    return !c.id.empty();
+}
+inline bool wire_present(const Point &p)
+{
+    return !p.coordinates.empty();
+}
+inline bool wire_present(const Trajectory &t)
+{
+    return !t.points.empty();
+}
+inline bool wire_present(const Simplification &s)
+{
+    return !s.tolerance.empty();
+}
+inline bool wire_present(const SimplificationReport &r)
+{
+    return r.original > 0;
+}
+inline bool wire_present(const TraceContext &t)
+{
+    return t.seq != 0;
+}
+template <typename T>
+bool wire_present(const T &items)
+{
+    return !items.empty();
+}
+
+/**
+ * Readers and writers of arrays (std::vector or std::list) by item type
+ **/
+template <typename C>
+bool wire_read_number_array(WireReader &in, C &items)
+{
+    static_assert(std::is_floating_point<typename C::value_type>::value,
+                  "the items are not numbers in the AsyncAPI document");
+    if (!in.begin_array())
+    {
+        return false;
+    }
+    items.clear();
+    for (bool first = true; in.next_item(first); first = false)
+    {
+        double item;
+        if (!in.read_number(item))
+        {
+            return false;
+        }
+        items.push_back(item);
+    }
+    return !in.failed();
+}
+
+template <typename C>
+bool wire_read_integer_array(WireReader &in, C &items)
+{
+    if (!in.begin_array())
+    {
+        return false;
+    }
+    items.clear();
+    for (bool first = true; in.next_item(first); first = false)
+    {
+        typename C::value_type item;
+        if (!in.read_integer(item))
+        {
+            return false;
+        }
+        items.push_back(item);
+    }
+    return !in.failed();
+}
+
+template <typename C>
+bool wire_read_string_array(WireReader &in, C &items)
+{
+    if (!in.begin_array())
+    {
+        return false;
+    }
+    items.clear();
+    for (bool first = true; in.next_item(first); first = false)
+    {
+        items.emplace_back();
+        if (!in.read_string(items.back()))
+        {
+            return false;
+        }
+    }
+    return !in.failed();
+}
+
+template <typename C>
+bool wire_read_object_array(WireReader &in, C &items)
+{
+    if (!in.begin_array())
+    {
+        return false;
+    }
+    items.clear();
+    for (bool first = true; in.next_item(first); first = false)
+    {
+        items.emplace_back();
+        if (!wire_read(in, items.back()))
+        {
+            return false;
+        }
+    }
+    return !in.failed();
+}
+
+template <typename C>
+void wire_write_number_array(std::string &out, const C &items)
+{
+    out += '[';
+    bool first = true;
+    for (double item : items)
+    {
+        if (!first)
+        {
+            out += ',';
+        }
+        first = false;
+        wire_write_number(out, item);
+    }
+    out += ']';
+}
+
+template <typename C>
+void wire_write_integer_array(std::string &out, const C &items)
+{
+    out += '[';
+    bool first = true;
+    for (long long item : items)
+    {
+        if (!first)
+        {
+            out += ',';
+        }
+        first = false;
+        wire_write_integer(out, item);
+    }
+    out += ']';
+}
+
+template <typename C>
+void wire_write_string_array(std::string &out, const C &items)
+{
+    out += '[';
+    bool first = true;
+    for (const std::string &item : items)
+    {
+        if (!first)
+        {
+            out += ',';
+        }
+        first = false;
+        wire_write_string(out, item);
+    }
+    out += ']';
+}
+
+template <typename C>
+void wire_write_object_array(std::string &out, const C &items)
+{
+    out += '[';
+    bool first = true;
+    for (const typename C::value_type &item : items)
+    {
+        if (!first)
+        {
+            out += ',';
+        }
+        first = false;
+        wire_write(out, item);
+    }
+    out += ']';
+}
+
+/**
+ * Encodes a message with the generated encoder (the JSON text of the message)
+ **/
+template <typename T>
+std::string wire_encode(const T &message)
+{
+    std::string out;
+    out.reserve(128);
+    wire_write(out, message);
+    return out;
+}
+
+/**
+ * Decodes a message with the generated decoder. Returns false if the text is
+ * not a valid message (required fields are missing, wrong types, trailing
+ * characters...)
+ **/
+template <typename T>
+bool wire_decode(const char *data, size_t length, T &message)
+{
+    WireReader in = WireReader(data, length);
+    return wire_read(in, message) && in.at_end();
+}
+
+#endif
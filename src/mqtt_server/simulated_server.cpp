@@ -1,16 +1,60 @@
 #include <signal.h>
 #include <iostream>
 #include <string>
+#include <cstring>
 #include <thread>
+#include <future>
 #include <unistd.h>
 #include "../impl/server-impls.cpp"
+#include "../impl/legacy-impls.cpp"
+#include "../impl/progress-impls.cpp"
+#include "../impl/motion-impls.cpp"
+#include "../impl/planner-impls.cpp"
+#include "../impl/kinematics-impls.cpp"
+#include "../impl/recorder-impls.cpp"
+#include "../impl/capture-impls.cpp"
+#include "../impl/publisher-impls.cpp"
+#include "../impl/arena-impls.cpp"
+#include "../impl/wire-impls.cpp"
+#include "../impl/stream-impls.cpp"
+#include "../impl/connection-impls.cpp"
+#include "../impl/socket-impls.cpp"
+#include "../impl/homing-impls.cpp"
+#include "../impl/registers-impls.cpp"
 #include "mosquitto.h"
 #include "include/devmem.hpp"
 #include <pthread.h>
 
+static_assert(PUBLISH_NO_CONNECTION == MOSQ_ERR_NO_CONN && PUBLISH_CONNECTION_LOST == MOSQ_ERR_CONN_LOST,
+			  "the errors of the publisher are those of mosquitto");
+
 
 #define DEFAULT_SLEEP 125000 //microseconds
 
+/**
+ * The maximum rate (Hz) at which the progress of a trajectory is published on
+ * ROBOT_NAME/progress. It can be changed with the option --progress-rate
+ **/
+#define DEFAULT_PROGRESS_RATE 5.0
+
+/**
+ * The time constant (SECONDS) of the joints of the simulated arm: the
+ * position read from their encoders approaches the commanded one with this
+ * lag
+ **/
+#define SIMULATED_JOINT_LAG 0.02
+
+/**
+ * The configuration of the controller of each joint (J1 to J6), as in
+ * JointController: the frequency dividers of the error-integral,
+ * proportional-derivative and proportional-integral terms (bank 3), the
+ * leds, the reference and the spike expansor
+ *
+ * TODO: Use the values of the configuration file of your arm
+ **/
+#define SPID_CONFIGURATION {{25, 255, 15, 0, 0, 5}, {25, 255, 15, 0, 0, 5}, {25, 255, 15, 0, 0, 5}, \
+							{30, 127, 20, 0, 0, 5}, {30, 127, 20, 0, 0, 5}, {30, 127, 20, 0, 0, 5}}
+
 /**
  * The broker host. There is an instance of Mosquitto running at 192.168.1.104
  * For the simulated server we suggest to use a local instance of Mosquitto
@@ -45,40 +89,511 @@ progress_info progress;
 Point current_point;
 
 /**
- * A global variable maintaining the current trajectory to be executed
- * This trajectory is initially empty and its value is updated when the user
- * requests via ARM_APPLY_TRAJECTORY signal. After the trajectory is applied 
- * its value is reset to and empty trajectory again.
+ * Global variables maintaining the current trajectory to be executed: its
+ * points (in a flat buffer) or, for ARM_APPLY_CARTESIAN_TRAJECTORY, its
+ * cartesian waypoints. They are initially empty and their value is updated
+ * when the user requests via ARM_APPLY_TRAJECTORY signal. After the
+ * trajectory is applied they are reset to empty trajectories again.
  **/
-Trajectory current_trajectory;
+FlatTrajectory current_trajectory;
+Trajectory current_waypoints;
 
 /**
- * Global flag informing that a trajectory is being executed or not 
-**/
-bool executing_trajectory = false;
+ * The trace of the command that started the current movement (or homing),
+ * and of the command that cancelled the current trajectory. They are empty
+ * if the commands have not been traced
+ **/
+TraceContext current_trace;
+TraceContext cancel_trace;
+
+/**
+ * The simplification requested for the current trajectory, and the tolerance
+ * (DEGREES) applied to the trajectories that do not request one (option
+ * --simplify, 0 = only on request)
+ **/
+Simplification current_simplification;
+double simplify_tolerance = 0.0;
+
+/**
+ * Whether the points of the current trajectory are cartesian waypoints
+ * (ARM_APPLY_CARTESIAN_TRAJECTORY), expanded into joints by the trajectory
+ * thread before executing them
+ **/
+bool current_cartesian = false;
+
+/**
+ * The control loop moving the arm. Its movements can be preempted at any
+ * moment when a trajectory is cancelled
+ **/
+ArmMotion arm_motion = ArmMotion(METAINFOS.size(), CONTROL_PERIOD_US, CANCEL_DECELERATION);
+
+/**
+ * The velocity and acceleration limits of each joint, used to compute the
+ * timing of every movement
+ **/
+std::vector<JointInfo> limits = joint_limits();
+
+/**
+ * The maximum rate (Hz) of progress messages during a trajectory execution
+ **/
+double progress_max_rate = DEFAULT_PROGRESS_RATE;
+
+/**
+ * The maximum deviation (DEGREES) from the points of a trajectory allowed to
+ * blend its corners. With 0 the arm stops at every point
+ **/
+double blend_tolerance = DEFAULT_BLEND_TOLERANCE;
+
+/**
+ * The prefix of the files where the joints are recorded (empty = no recording)
+ * and the sampling rate (Hz). They can be changed with the options --record
+ * and --record-rate
+ **/
+std::string record_prefix;
+double record_rate = RECORDER_RATE_HZ;
+
+/**
+ * The capture of the messages received by the server (option --capture),
+ * to be replayed with session_replay
+ **/
+SessionCapture session_capture;
+
+/**
+ * The transport of co-located clients: a Unix-domain socket (option
+ * --local-socket) whose messages are handled as those of the broker. The
+ * messages of both are handled one at a time
+ **/
+LocalTransport local_transport;
+std::string local_socket_path;
+mode_t local_socket_mode = LOCAL_SOCKET_MODE;
+std::mutex dispatch_mutex;
+
+/**
+ * The instants (wall-clock and monotonic MICROSECONDS) the message being
+ * handled was received, for the trace of the commands
+ **/
+long long message_received = 0;
+long long message_received_monotonic = 0;
+
+/**
+ * Function that hands a message to mosquitto
+ **/
+int send_to_broker(const std::string &topic, const char *payload, size_t length, int qos, int *mid)
+{
+	return mosquitto_publish(mosq, mid, topic.c_str(), length, payload, qos, false);
+}
+
+/**
+ * All messages of the server are published through this pipeline. The QoS of
+ * telemetry can be changed with --telemetry-qos and the number of messages in
+ * flight before shedding telemetry with --publish-window
+ **/
+PublishPipeline publisher = PublishPipeline(send_to_broker, PUBLISH_HIGH_WATER);
+int telemetry_qos = TELEMETRY_QOS;
+
+/**
+ * The thread that publishes all messages of the server. Other threads only
+ * post their messages, so they never wait for the network
+ **/
+PublisherThread publisher_thread;
+
+/**
+ * The arena where received messages are parsed (created with the first
+ * message) and its size, which can be changed with --message-arena (0 = the
+ * messages are parsed on the heap)
+ **/
+size_t message_arena_size = MESSAGE_ARENA_SIZE;
+MessageArena *message_arena = NULL;
+
+/**
+ * Whether commands in JSON are decoded while they are read (stream_command)
+ * or parsed in the message arena (command_from_json). It can be changed with
+ * --command-decoder (stream or arena)
+ **/
+bool stream_commands = true;
+
+/**
+ * Heap allocations, and arena blocks and bytes used to handle the received
+ * messages
+ **/
+MessageStats message_stats;
+
+/**
+ * The points the arm has been moved to are also published in batches encoded
+ * with the compact codec on ROBOT_NAME/moved/batch, every moved_batch_size
+ * points and at the end of each movement. It can be changed with the option
+ * --moved-batch (0 = no batches)
+ **/
+size_t moved_batch_size = 0;
+std::mutex moved_batch_mutex;
+std::list<Point> moved_batch;
 
+/**
+ * The deadline misses of the control loop in a movement above which the
+ * timing alert is raised in the error flag of the messages. It can be
+ * changed with the option --miss-threshold
+ **/
+long miss_threshold = TIMING_MISS_THRESHOLD;
+
+/**
+ * The shadow of the registers of the controllers: configuring the joints
+ * only writes the registers whose value changes
+ **/
+RegisterFile controller_registers;
+
+/**
+ * Function that writes a register of the controllers. The simulated arm has
+ * no controllers.
+ *
+ * TODO: On the real arm use sendCommand16(address, high, low, bram_ptr)
+ **/
+int simulated_register_write(uint8_t address, uint8_t high, uint8_t low)
+{
+	return 0;
+}
+
+/**
+ * Function that writes the SPID configuration of all joints in a single
+ * pass. Registers that already hold their value are not written again
+ **/
+void configure_controllers()
+{
+	std::vector<JointController> configuration = SPID_CONFIGURATION;
+	long written = controller_registers.written;
+	long avoided = controller_registers.avoided;
+	for (size_t j = 0; j < configuration.size(); j++)
+	{
+		if (!controller_registers.stage_spid(joint_address((int)j + 1), configuration[j]))
+		{
+			std::cout << "SPID configuration of joint " << j + 1 << " rejected: a value does not fit in "
+					  << "a register (0 to " << REGISTER_MAX << ")" << std::endl;
+		}
+	}
+	int rc = controller_registers.commit(simulated_register_write);
+	std::cout << "Controllers configured (" << controller_registers.written - written << " registers written, "
+			  << controller_registers.avoided - avoided << " unchanged) in "
+			  << controller_registers.last_configuration * 1e6 << " us" << (rc != 0 ? ", with errors" : "") << std::endl;
+}
+
+/**
+ * The encoders of the simulated arm: the position they read follows the
+ * commanded one with a lag (see SIMULATED_JOINT_LAG)
+ **/
+std::mutex simulated_encoders_mutex;
+std::vector<double> simulated_encoders;
+std::chrono::steady_clock::time_point simulated_encoders_read;
+
+/**
+ * Function that reads the encoders of the joints (DEGREES). The joints of
+ * the simulated arm approach the commanded position as a first order system
+ *
+ * TODO: On the real arm use EDScorbot::readJoints and count_to_angle
+ **/
+void read_simulated_encoders(std::vector<double> &position)
+{
+	std::lock_guard<std::mutex> lock(simulated_encoders_mutex);
+	std::vector<double> commanded = arm_motion.position();
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (simulated_encoders.size() != commanded.size())
+	{
+		simulated_encoders = commanded;
+	}
+	double elapsed = std::chrono::duration<double>(now - simulated_encoders_read).count();
+	double approach = 1.0 - std::exp(-elapsed / SIMULATED_JOINT_LAG);
+	for (size_t i = 0; i < commanded.size(); i++)
+	{
+		simulated_encoders[i] += (commanded[i] - simulated_encoders[i]) * approach;
+	}
+	simulated_encoders_read = now;
+	position = simulated_encoders;
+}
+
+/**
+ * Function that reads the counters of the joints for the recorder. The
+ * simulated arm has no counters, so the references of the position last
+ * sent to the joints are recorded instead. They are read without locks (see
+ * ArmMotion::latest_position), so recording does not disturb the control loop
+ * nor its timing.
+ *
+ * TODO: On the real arm use EDScorbot::readJoints
+ **/
+void read_simulated_joints(int32_t *counts)
+{
+	EDScorbotModel::References refs = EDScorbotModel::References();
+	if (arm_motion.joints() == EDScorbotModel::joints)
+	{
+		// only actionable joints (J1..J4) have references
+		EDScorbotModel::Joints position;
+		arm_motion.latest_position(position.data());
+		refs = EDScorbotModel::to_refs(position);
+	}
+	for (int j = 0; j < RECORDER_JOINTS; j++)
+	{
+		counts[j] = j < (int)EDScorbotModel::joints ? refs[j] : 0;
+	}
+}
+
+/**
+ * Function that publishes the pending batch of moved points (if any)
+ **/
+void flush_moved_batch()
+{
+	std::string payload;
+	{
+		std::lock_guard<std::mutex> lock(moved_batch_mutex);
+		if (moved_batch.empty())
+		{
+			return;
+		}
+		encode_moved_batch(owner_client(), arm_state.error(), moved_batch, compact_codec(), payload);
+		moved_batch.clear();
+	}
+	if (!payload.empty())
+	{
+		publish_message(MOVED_BATCH_TOPIC, std::move(payload));
+	}
+}
+
+/**
+ * Function that publishes a point the arm has been moved to, on
+ * ROBOT_NAME/moved and (if enabled) in the next batch of moved points
+ **/
+void publish_moved(MovedObject &moved)
+{
+	moved.trace.mark(moved.trace.published);
+	publish_message(MOVED_TOPIC, wire_encode(moved));
+	if (moved_batch_size == 0)
+	{
+		return;
+	}
+	bool full;
+	{
+		std::lock_guard<std::mutex> lock(moved_batch_mutex);
+		moved_batch.push_back(moved.content);
+		full = moved_batch.size() >= moved_batch_size;
+	}
+	if (full)
+	{
+		flush_moved_batch();
+	}
+}
+
+/**
+ * Function that publishes an answer on ROBOT_NAME/commands. A traced answer
+ * gets the instant it is handed to the publisher
+ **/
+void publish_command(CommandObject &output)
+{
+	output.trace.mark(output.trace.published);
+	publish_message(COMMANDS_TOPIC, wire_encode(output));
+}
+
+/**
+ * Function that builds a point with the current position of the joints,
+ * read from their encoders. Coordinates of the commanded point beyond the
+ * joints of the arm are kept as they are
+ **/
+Point measured_point(const Point &commanded)
+{
+	Point result = commanded;
+	std::vector<double> position = arm_motion.read_joints();
+	if (result.coordinates.size() < position.size())
+	{
+		result.coordinates.resize(position.size(), 0.0);
+	}
+	for (size_t i = 0; i < position.size(); i++)
+	{
+		result.coordinates[i] = position[i];
+	}
+	return result;
+}
+
+/**
+ * Function that summarizes a histogram of the control loop (MICROSECONDS)
+ **/
+TimingStats timing_stats(TimingHistogram &histogram)
+{
+	TimingStats result = TimingStats();
+	result.count = histogram.count();
+	result.p50 = histogram.percentile(0.5) / 1000.0;
+	result.p90 = histogram.percentile(0.9) / 1000.0;
+	result.p99 = histogram.percentile(0.99) / 1000.0;
+	result.p999 = histogram.percentile(0.999) / 1000.0;
+	result.max = histogram.maximum() / 1000.0;
+	return result;
+}
+
+/**
+ * Function that raises the timing alert as soon as the deadline misses of
+ * the current movement go over the threshold
+ **/
+void check_timing_alert()
+{
+	if (arm_motion.timing.misses.load(std::memory_order_relaxed) > miss_threshold && !arm_state.alert())
+	{
+		arm_state.set_alert(true);
+		std::cout << "Timing alert: " << arm_motion.timing.misses.load() << " deadline misses of the control loop"
+				  << std::endl;
+	}
+}
+
+/**
+ * Function that publishes the timing of the control loop since the last
+ * time on ROBOT_NAME/timing and starts a new count. The timing alert stays
+ * raised until a movement finishes with its misses under the threshold
+ **/
+void publish_timing()
+{
+	TimingObject timing = TimingObject();
+	timing.period = arm_motion.timing.period_us();
+	timing.ticks = arm_motion.timing.ticks.load();
+	timing.misses = arm_motion.timing.misses.load();
+	timing.period_error = timing_stats(arm_motion.timing.period_error);
+	timing.tick_work = timing_stats(arm_motion.timing.tick_work);
+	timing.send_ref = timing_stats(arm_motion.timing.send_ref);
+	timing.read_joints = timing_stats(arm_motion.timing.read_joints);
+	arm_motion.timing.reset();
+
+	arm_state.set_alert(timing.misses > miss_threshold);
+	timing.error = arm_state.error();
+	publish_message(TIMING_TOPIC, wire_encode(timing));
+}
+
+/**
+ * Function that releases the arm of client (ARM_IDLE) if it has disconnected
+ * while its command was running (ARM_RELEASING). Called by the thread of the
+ * command when it stops, so a new owner never runs a command at the same time
+ **/
+bool release_command(uint32_t client)
+{
+	if (!arm_state.transition(STATE_MASK(ARM_RELEASING), ARM_IDLE, client))
+	{
+		return false;
+	}
+	arm_state.release(client);
+	std::cout << "Arm released" << std::endl;
+	return true;
+}
+
+/**
+ * Function that takes the arm of client from the state of a finished command
+ * (in the mask from) back to ARM_OWNED. Old clients (LEGACY_CLIENT_ID) have
+ * no session, so the arm is released (ARM_IDLE) after each of their commands.
+ * If the owner has disconnected meanwhile the arm is released and it returns
+ * false. The state before is returned in previous
+ **/
+bool finish_command(uint32_t from, uint32_t client, ArmStateKind *previous = NULL)
+{
+	if (arm_state.client_id(client) != LEGACY_CLIENT_ID)
+	{
+		if (arm_state.transition(from, ARM_OWNED, client, previous))
+		{
+			return true;
+		}
+		release_command(client);
+		return false;
+	}
+	if (!arm_state.transition(from, ARM_IDLE, client, previous))
+	{
+		release_command(client);
+		return false;
+	}
+	arm_state.release(client);
+	return true;
+}
+
+/**
+ * Function that moves the arm (blocking the caller) to a commanded point.
+ * The movement finishes when the joints have settled on the point, and it
+ * can be preempted by arm_motion.cancel(). The arm of client moves from
+ * ARM_MOVING or ARM_EXECUTING to ARM_ERROR if the joints do not settle
+ **/
+MotionResult execute_movement(const Point &commanded, uint32_t client)
+{
+	std::vector<double> target = commanded.coordinates;
+	target.resize(arm_motion.joints(), 0.0);
+	std::vector<double> position = arm_motion.position();
+	double duration = point_to_point_time(position, target, limits);
+	PointToPointProfile profile = PointToPointProfile(position, target, duration);
+	MotionResult result = arm_motion.execute(profile);
+	check_timing_alert();
+	if (result == MOTION_TIMEOUT)
+	{
+		arm_state.transition(STATE_MASK(ARM_MOVING) | STATE_MASK(ARM_EXECUTING), ARM_ERROR, client);
+		std::cout << "Joints not settled " << arm_motion.last_settle.load() << " s after the movement" << std::endl;
+	}
+	return result;
+}
+
+
+/**
+ * Function that searches home on a joint of the simulated arm
+ **/
+bool simulated_home_joint(int joint)
+{
+	/**
+	 * A sleep time representing the search of home on the joint
+	 *
+	 * TODO: Replace this code with the real procedure to search home on the
+	 * joint (EDScorbot::searchHome)
+	 **/
+	std::vector<double> times = SIMULATED_HOMING_TIMES;
+	usleep((useconds_t)(times[joint] * 1e6));
+	return true;
+}
 
 /**
  * Function to move the arm to home position. It must be executed into a 
  * thread to avoid blocking the main process and disconnect from the broker.
  * Before calling this function all pre-conditions have already been validated
+* (the arm is in ARM_HOMING). The argument is the handle of the owner.
+* Independent joints search home at the same time (see ArmHoming), and the
+* progress is published every time a joint is homed
 */
 void* search_home_threaded_function(void* arg){
+	uint32_t client = (uint32_t)(uintptr_t)arg;
+
 	//the answer
 	CommandObject output = CommandObject(ARM_HOME_SEARCHED);
-	output.client = owner;
-	output.error = error_state;
+	output.client = Client(arm_state.client_id(client));
+	output.trace = current_trace;
+	output.trace.mark(output.trace.motion_started);
 
-	/**
-	 * A sleep time representing the action of moving the arm to home position
-	 * 
-	 * TODO: Replace this code with the real procedure to move the arm to home
-	 **/
-	usleep(4000000);
+	//the controllers are configured before searching home
+	configure_controllers();
+
+	ArmHoming homing = ArmHoming(HOMING_PREREQUISITES);
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	bool homed = homing.run(simulated_home_joint, [&homing, &output, started](int joint, JointHomingState state) {
+		if (state == HOMING_SEARCHING)
+		{
+			return;
+		}
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+		ProgressObject progress = ProgressObject(homing.homed(), homing.joints(), elapsed, 0.0, 0.0);
+		progress.client = output.client;
+		progress.homing = homing.states();
+		publish_message(PROGRESS_TOPIC, wire_encode(progress));
+		std::cout << "Joint " << joint + 1 << (state == HOMING_DONE ? " homed" : " failed to home")
+				  << " after " << elapsed << " s" << std::endl;
+	});
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	output.trace.mark(output.trace.motion_ended);
+
+	//the owner may have disconnected meanwhile (the arm is released now)
+	if (homed)
+	{
+		finish_command(STATE_MASK(ARM_HOMING), client);
+	}
+	else if (!arm_state.transition(STATE_MASK(ARM_HOMING), ARM_ERROR, client))
+	{
+		release_command(client);
+	}
+	output.error = arm_state.error();
 	
 	//publish message notifying that home has been reached
-	publish_message(COMMANDS_TOPIC,output.to_json().dump().c_str());
-	std::cout << "Home position reached" << std::endl;
+	publish_command(output);
+	std::cout << (homed ? "Home position reached in " : "Home not found after ") << elapsed << " s" << std::endl;
 	return NULL;
 }
 
@@ -86,42 +601,45 @@ void* search_home_threaded_function(void* arg){
  * Function to move the arm to a single point. It must be executed into a
  * thread to avoid blocking the main process and disconnect from the broker.
  * Before calling this function all pre-conditions have already been validated
+ * (the arm is in ARM_MOVING). The argument is the handle of the owner
  */
 void* move_to_point_threaded_function(void* arg){
+	uint32_t client = (uint32_t)(uintptr_t)arg;
+
 	//the answer
 	MovedObject output = MovedObject();
-	output.client = owner;
-	output.error = error_state;
+	output.client = Client(arm_state.client_id(client));
+	output.trace = current_trace;
 
 	/**
-	 * A sleep time representing the action of moving the arm to home position
-	 *
-	 * TODO: Replace this code with the real procedure to move the arm to a point
-	 * The values for each joint are stored in the global variable "current_point"
+	 * The movement is executed by the control loop (arm_motion). The values for
+	 * each joint are stored in the global variable "current_point"
 	 * (current_point.coordinates)
 	**/
-	usleep(2000000);
+	output.trace.mark(output.trace.motion_started);
+	execute_movement(current_point, client);
+	output.trace.mark(output.trace.motion_ended);
 
 	/**
-	 * TODO: After moving the arm, get the counter value for each joint and convert
-	 * them to angles. Then use the variable realPoint bellow to assign these
-	 * values (realPoint.coordinates[index] = count_to_angle(value)). Check if the
-	 * number of coordinates  matched the number of joints in the global variable
-	 * METAINFOS
-	 *
-	 * For the moment we simply publish the the current_point
+	 * The point reached is the position read from the encoders of the joints
+	 * (see read_simulated_encoders)
 	 **/
-	Point realPoint = current_point;
+	Point realPoint = measured_point(current_point);
+	publish_timing();
 
 	//sets the content of the answer
 	output.content = realPoint;
+	output.error = arm_state.error();
 	
 	//publish message notifying that the point has been published
-	publish_message(MOVED_TOPIC,output.to_json().dump().c_str());
-	std::cout << "Arm moved to point " << output.content.to_json().dump().c_str() << std::endl;
+	publish_moved(output);
+	flush_moved_batch();
+	std::cout << "Arm moved to point " << output.content.to_json().dump().c_str() << " (settled in "
+			  << arm_motion.last_settle.load() * 1e3 << " ms)" << std::endl;
 
 	//after publishing the message, the current_point must be re-instantiated with empty point
 	current_point = Point();
+	finish_command(STATE_MASK(ARM_MOVING), client);
 
 	return NULL;
 }
@@ -132,108 +650,564 @@ void* move_to_point_threaded_function(void* arg){
 /**
  * Function to move the arm to a single point to be used in trajectory execution because the execution of
  * each point of a trajectory cannot be threaded (different points would be executed concurrently,
- * causing a terrible side-effect)
+ * causing a terrible side-effect). The reached point is returned in realPoint. If the movement is
+ * cancelled nothing is published (the caller notifies where the arm has stopped). The point
+ * published carries the trace of the trajectory. The argument client is the owner
  */
-void move_to_point(Point point){
+MotionResult move_to_point(Point point, Point &realPoint, const TraceContext &trace, uint32_t client){
 	//the answer to communicate each point
 	MovedObject output = MovedObject();
-	output.client = owner;
-	output.error = error_state;
+	output.trace = trace;
 
 	/**
-	 * A sleep time representing the action of moving the arm to home position
-	 *
-	 * TODO: Replace this code with the real procedure to move the arm to a point
-	 * The values for each joint are stored in the global variable "current_point"
-	 * (current_point.coordinates)
+	 * The movement is executed by the control loop (arm_motion), so it can be
+	 * preempted when the trajectory is cancelled
 	 **/
-	usleep(2000000);
+	MotionResult result = execute_movement(point, client);
+	output.trace.mark(output.trace.motion_ended);
 
 	/**
-	 * TODO: After moving the arm, get the counter value for each joint and convert
-	 * them to angles. Then use the variable realPoint bellow to assign these
-	 * values (realPoint.coordinates[index] = count_to_angle(value)). Check if the
-	 * number of coordinates  matched the number of joints in the global variable
-	 * METAINFOS
-	 *
-	 * For the moment we simply publish the same point we have received
+	 * The point reached is the position read from the encoders of the joints
+	 * (see read_simulated_encoders)
 	 **/
-	Point realPoint = point;
+	realPoint = measured_point(point);
+	if (result == MOTION_CANCELED)
+	{
+		return result;
+	}
 
 	// sets the content of the answer
 	output.content = realPoint;
+	output.error = arm_state.error();
 
 	// publish message notifying that the point has been published
-	publish_message(MOVED_TOPIC, output.to_json().dump().c_str());
+	publish_moved(output);
 	std::cout << "Arm moved to point " << output.content.to_json().dump().c_str() << std::endl;
+
+	return result;
+}
+
+/**
+ * Function that notifies clients that a trajectory has been cancelled. It is
+ * called only after the arm has stopped, with the point where it stopped, the
+ * trace of the trajectory and its progress, whose last update (the points
+ * executed before the cancel) is published before the answer
+ */
+void notify_cancelled_trajectory(Point stopped, const TraceContext &trace, ProgressThrottle &throttle){
+	MovedObject moved = MovedObject(stopped);
+	moved.trace = trace;
+	moved.trace.mark(moved.trace.motion_ended);
+	publish_moved(moved);
+	flush_moved_batch();
+
+	ProgressObject progress;
+	if (throttle.cancelled(progress))
+	{
+		publish_message(PROGRESS_TOPIC, wire_encode(progress));
+	}
+
+	//the answer carries the trace of the cancel command, if traced
+	CommandObject output = CommandObject(ARM_CANCELED_TRAJECTORY);
+	output.client = owner_client();
+	output.trace = cancel_trace.is_empty() ? trace : cancel_trace;
+	output.trace.mark(output.trace.motion_ended);
+	publish_command(output);
+
+	double preempt = std::chrono::duration<double, std::micro>(arm_motion.preempt_time - arm_motion.cancel_time).count();
+	double stop = std::chrono::duration<double, std::milli>(arm_motion.stop_time - arm_motion.cancel_time).count();
+	std::cout << "Trajectory cancelled. Preempted in " << preempt << " us, arm stopped in "
+			  << stop << " ms at " << stopped.to_json().dump().c_str() << std::endl;
+}
+
+/**
+ * Function that executes a trajectory as a single blended movement, so the arm
+ * does not stop at the intermediate points. The MovedObject of each point is
+ * published when the arm passes by it (with the trace of the trajectory). If the
+ * movement is cancelled, the point where the arm stopped is returned in stopped.
+ * If the joints do not settle, the arm of client moves to ARM_ERROR
+ */
+MotionResult apply_blended_trajectory(const FlatTrajectory &points, const TrajectoryTiming &timing,
+									  ProgressThrottle &throttle, const TraceContext &trace, uint32_t client,
+									  Point &stopped){
+	BlendedProfile profile = BlendedProfile(arm_motion.position(), points, arm_motion.joints(),
+											timing, LOOKAHEAD_POINTS);
+
+	size_t index = 0;
+	ProgressObject progress;
+	auto publish_reached = [&](size_t reached){
+		while (index < reached && index < points.size()){
+			Point commanded = points.to_point(index);
+			Point realPoint = measured_point(commanded);
+			MovedObject output = MovedObject(realPoint);
+			output.trace = trace;
+			output.trace.mark(output.trace.motion_ended);
+			publish_moved(output);
+			index++;
+
+			if (throttle.update(index, tracking_error(commanded, realPoint), progress)){
+				publish_message(PROGRESS_TOPIC, wire_encode(progress));
+			}
+		}
+	};
+	//the arm stops at the last point: it is only published once the joints have settled there
+	MotionResult result = arm_motion.execute(profile, [&](double t){
+		publish_reached(std::min(profile.reached(t), points.size() - 1));
+		check_timing_alert();
+	});
+
+	if (result == MOTION_TIMEOUT){
+		arm_state.transition(STATE_MASK(ARM_EXECUTING), ARM_ERROR, client);
+		std::cout << "Joints not settled " << arm_motion.last_settle.load() << " s after the trajectory" << std::endl;
+	}
+
+	if (result == MOTION_DONE){
+		publish_reached(points.size());
+	}
+
+	stopped = measured_point(Point());
+	return result;
+}
+
+/**
+ * Function that says if a trajectory with the given timing is executed blended
+ * (see BlendedProfile) or moving to each point in turn (blending disabled)
+ **/
+bool blended_execution(const TrajectoryTiming &timing)
+{
+	return blend_tolerance > 0 && timing.segments.size() > 1;
+}
+
+/**
+ * Function that estimates the time (seconds) to execute a trajectory with the
+ * given timing, as it will be executed
+ **/
+double execution_estimate(const TrajectoryTiming &timing)
+{
+	return blended_execution(timing) ? timing.total : timing.point_to_point_total;
+}
+
+/**
+ * Function that simplifies the points of a trajectory (see simplify_trajectory)
+ * as requested. The report gives the points received and kept (the time to
+ * execute the simplified trajectory is filled after retiming it). The time to
+ * execute the trajectory received is only reported, so it is estimated by
+ * another thread while the simplified trajectory runs (original_duration)
+ **/
+SimplificationReport simplify_points(FlatTrajectory &points, Simplification &simplification,
+									 std::shared_future<double> &original_duration)
+{
+	SimplificationReport report = SimplificationReport();
+	if (simplification.is_empty() || points.size() < 3)
+	{
+		return report;
+	}
+	std::vector<double> start = arm_motion.position();
+	original_duration = std::async(std::launch::async, [start, points]() {
+		TrajectoryTiming received;
+		retime_trajectory(start, points, limits, blend_tolerance, received);
+		return execution_estimate(received);
+	}).share();
+	report.original = points.size();
+
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	simplify_trajectory(points, simplification.tolerance, simplification.timed);
+	std::chrono::duration<double, std::milli> simplification_time = std::chrono::steady_clock::now() - started;
+	report.kept = points.size();
+	std::cout << "Trajectory simplified from " << report.original << " to " << report.kept << " points in "
+			  << simplification_time.count() << " ms" << std::endl;
+	return report;
+}
+
+/**
+ * Function that expands cartesian waypoints into the joint points of a
+ * trajectory starting at the current position of the arm. Returns false if
+ * some point cannot be reached
+ **/
+bool expand_waypoints(const std::list<Point> &waypoints, FlatTrajectory &points)
+{
+	FlatTrajectory expanded = FlatTrajectory();
+	std::chrono::steady_clock::time_point expansion_started = std::chrono::steady_clock::now();
+	bool reachable = expand_cartesian_trajectory(arm_motion.position(), waypoints, expanded);
+	std::chrono::duration<double, std::milli> expansion_time = std::chrono::steady_clock::now() - expansion_started;
+	if (reachable)
+	{
+		std::cout << waypoints.size() << " waypoints expanded into " << expanded.size() << " points in "
+				  << expansion_time.count() << " ms" << std::endl;
+		std::swap(points, expanded);
+	}
+	return reachable;
+}
+
+/**
+ * Function to aply a trajectory. It must be executed into a
+ * thread to avoid blocking the main process and disconnect from the broker.
+ * Before calling this function all pre-conditions have already been validated
+ * (the arm is in ARM_EXECUTING). The argument is the handle of the owner
+ */
+void* apply_trajectory_threaded_function(void* arg){
+	uint32_t client = (uint32_t)(uintptr_t)arg;
+
+	//points to be considered come from the global variable "current_trajectory"
+	//(or "current_waypoints"), which is left empty
+	FlatTrajectory points;
+	TraceContext trace = current_trace;
+	if (!current_cartesian)
+	{
+		std::swap(points, current_trajectory);
+	}
+	else if (!expand_waypoints(current_waypoints.points, points))
+	{
+		// nothing is executed. The client is told the arm did not move
+		current_waypoints = Trajectory();
+		current_simplification = Simplification();
+		current_cartesian = false;
+		arm_motion.reset_cancel();
+		finish_command(STATE_MASK(ARM_EXECUTING) | STATE_MASK(ARM_CANCELLING), client);
+
+		CommandObject output = CommandObject(ARM_CANCELED_TRAJECTORY);
+		output.client = Client(arm_state.client_id(client));
+		output.trace = trace;
+		output.error = arm_state.error();
+		publish_command(output);
+		std::cout << "Cartesian trajectory is not reachable. " << std::endl;
+		return NULL;
+	}
+	std::shared_future<double> original_duration;
+	SimplificationReport simplification = simplify_points(points, current_simplification, original_duration);
+
+	//progress is published at a limited rate, regardless of the number of points
+	int total = points.size();
+	int index = 0;
+	ProgressThrottle throttle = ProgressThrottle(progress_max_rate);
+	ProgressObject progress;
+	throttle.start(total);
+	bool cancelled = false;
+
+	//the timing respecting the limits of the joints, with and without blending
+	std::chrono::steady_clock::time_point retiming_started = std::chrono::steady_clock::now();
+	TrajectoryTiming timing;
+	retime_trajectory(arm_motion.position(), points, limits, blend_tolerance, timing);
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	trace.mark(trace.motion_started);
+	double retiming = std::chrono::duration<double, std::micro>(started - retiming_started).count();
+	if (!simplification.is_empty())
+	{
+		simplification.duration = execution_estimate(timing);
+		throttle.simplification = simplification;
+		throttle.original_duration = original_duration;
+	}
+
+	//the blended timing stops at the corners where that is faster
+	bool blended = blended_execution(timing);
+	if (blended){
+		Point stopped;
+		if (apply_blended_trajectory(points, timing, throttle, trace, client, stopped) == MOTION_CANCELED){
+			notify_cancelled_trajectory(stopped, trace, throttle);
+			cancelled = true;
+		}
+		points.clear();
+	}
+
+	//a cancel request preempts the current movement and makes any further one return immediately
+	for (size_t next = 0; next < points.size(); next++){
+		Point p = points.to_point(next);
+
+		Point realPoint;
+		MotionResult result = move_to_point(p, realPoint, trace, client);
+		if (result == MOTION_CANCELED)
+		{
+			notify_cancelled_trajectory(realPoint, trace, throttle);
+			cancelled = true;
+			break;
+		}
+		if (result == MOTION_TIMEOUT)
+		{
+			//the arm is in ARM_ERROR, the rest of the trajectory is not executed
+			break;
+		}
+		index++;
+
+		if (throttle.update(index, tracking_error(p, realPoint), progress)){
+			publish_message(PROGRESS_TOPIC, wire_encode(progress));
+		}
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	std::cout << "Trajectory of " << total << " points (retimed in " << retiming << " us) executed in "
+			  << elapsed << " s" << (blended ? " with blending" : " stopping at every point")
+			  << ". Estimated: " << timing.total << " s with blending, "
+			  << timing.point_to_point_total << " s stopping at every point" << std::endl;
+	if (!simplification.is_empty())
+	{
+		std::cout << "Simplified trajectory estimated in " << simplification.duration << " s instead of "
+				  << original_duration.get() << " s" << std::endl;
+	}
+
+	//the points not published yet in a batch
+	flush_moved_batch();
+	publish_timing();
+
+	//clean the current trajectory variables
+	current_trajectory = FlatTrajectory();
+	current_waypoints = Trajectory();
+	current_simplification = Simplification();
+	current_cartesian = false;
+	arm_motion.reset_cancel();
+
+	//trajectory execution has finished. If a cancel request has been accepted
+	//after the last movement, the arm is already stopped and it is confirmed now
+	ArmStateKind previous;
+	if (finish_command(STATE_MASK(ARM_EXECUTING) | STATE_MASK(ARM_CANCELLING), client, &previous) &&
+		previous == ARM_CANCELLING && !cancelled){
+		notify_cancelled_trajectory(measured_point(Point()), trace, throttle);
+	}
+
+	return NULL;
+}
+
+/**
+ * Function that starts a detached thread executing a command of the owner
+ * client. Returns false if the thread cannot be created (the caller takes
+ * the arm back to the state it had before the command)
+ **/
+bool start_command_thread(pthread_t &thread, void *(*function)(void *), uint32_t client)
+{
+	int err = pthread_create(&thread, NULL, function, (void *)(uintptr_t)client);
+	if (err != 0)
+	{
+		std::cout << "Command thread not created (" << strerror(err) << ")" << std::endl;
+		return false;
+	}
+	pthread_detach(thread);
+	return true;
+}
+
+/**
+ * Function that starts the execution of a trajectory in a new thread, after
+ * expanding it (cartesian waypoints) and simplifying it as requested (or with
+ * the default tolerance). The arm must
+ * be already in ARM_EXECUTING, so a cancel arriving right after is not lost.
+ * If the thread cannot be created the arm goes back to ARM_OWNED and the
+ * client is told (with an error) that the trajectory has been cancelled
+ **/
+void start_trajectory(const Trajectory &trajectory, FlatTrajectory &points, const Simplification &simplification,
+					  uint32_t client, bool cartesian){
+	if (cartesian)
+	{
+		current_waypoints = trajectory;
+	}
+	else if (points.size() > 0)
+	{
+		//decoded straight into a buffer reserved from the size of the payload
+		points.coordinates.shrink_to_fit();
+		std::swap(current_trajectory, points);
+	}
+	else
+	{
+		current_trajectory = FlatTrajectory::from_points(trajectory.points);
+	}
+	current_simplification = simplification;
+	current_cartesian = cartesian;
+	if (current_simplification.is_empty() && simplify_tolerance > 0)
+	{
+		current_simplification = Simplification(simplify_tolerance, false);
+	}
+
+	cancel_trace = TraceContext();
+	arm_motion.reset_cancel();
+	if (!start_command_thread(apply_trajectory_thread, &apply_trajectory_threaded_function, client))
+	{
+		current_trajectory = FlatTrajectory();
+		current_waypoints = Trajectory();
+		current_simplification = Simplification();
+		current_cartesian = false;
+		finish_command(STATE_MASK(ARM_EXECUTING) | STATE_MASK(ARM_CANCELLING), client);
+
+		CommandObject output = CommandObject(ARM_CANCELED_TRAJECTORY);
+		output.client = Client(arm_state.client_id(client));
+		output.trace = current_trace;
+		output.error = true;
+		publish_command(output);
+	}
+}
+
+void handle_signal(int s)
+{
+	run = 0;
+}
+
+/**
+ * Function that registers the server into the broker using the suitable topics.
+ * It is called on every (re)connection from the network thread, so it only
+ * subscribes: the topic names are built once by main before any thread starts
+ * and are read by the other threads without a lock
+**/
+void subscribe_all_topics()
+{
+	std::cout << "Subscribing on topic "
+			  << META_INFO
+			  << std::endl;
 	
-	return;
+	mosquitto_subscribe(mosq, NULL, META_INFO.c_str(), 0);
+
+	std::cout << "Subscribing on topic "
+			  << COMMANDS_TOPIC.c_str()
+			  << std::endl;
+
+	mosquitto_subscribe(mosq, NULL, COMMANDS_TOPIC.c_str(), 0);
+
+	std::cout << "Subscribing on topic "
+			  << LEGACY_COMMANDS_TOPIC.c_str()
+			  << std::endl;
+
+	mosquitto_subscribe(mosq, NULL, LEGACY_COMMANDS_TOPIC.c_str(), 0);
+}
+
+/**
+ * Fuction that publishes a message (the string representation of a JSON object)
+ * using a specific topic. The message is copied and posted to the publisher
+ * thread. The QoS and the handling under backpressure depend on the topic
+ * (see configure_publisher)
+ **/
+int publish_message(std::string topic, const char *buf)
+{
+	publisher_thread.post(topic, std::string(buf), publisher.policy_of(topic).droppable);
+	return MOSQ_ERR_SUCCESS;
+}
+
+/**
+ * Function that publishes a message without copying it: the payload is moved
+ * to the publisher thread
+ **/
+int publish_message(const std::string &topic, std::string &&payload)
+{
+	publisher_thread.post(topic, std::move(payload), publisher.policy_of(topic).droppable);
+	return MOSQ_ERR_SUCCESS;
 }
 
 /**
- * Function to aply a trajectory. It must be executed into a
- * thread to avoid blocking the main process and disconnect from the broker.
- * Before calling this function all pre-conditions have already been validated
- */
-void* apply_trajectory_threaded_function(void* arg){
-	//points to be considered come from the global variable "current_trajectory"
-	std::list<Point> points = std::list<Point>(current_trajectory.points);
+ * The delays between attempts to reconnect to the broker, and the number of
+ * times the connection was established and lost
+ **/
+ReconnectBackoff reconnect_backoff = ReconnectBackoff(RECONNECT_INITIAL_DELAY_MS, RECONNECT_MAX_DELAY_MS);
+std::atomic<long> broker_connections(0);
+std::atomic<long> broker_disconnections(0);
 
-	//trajectory execution has been started
-	executing_trajectory = true;
+/**
+ * Function that publishes (in the publisher thread) a message taken from the queue
+ **/
+void deliver_message(const std::string &topic, const std::string &payload)
+{
+	publisher.publish(topic, payload.data(), payload.size());
+	local_transport.broadcast(topic, payload.data(), payload.size());
+}
 
-	while (!points.empty() && executing_trajectory){
-        Point p = points.front();
-		
-		move_to_point(p); 
+/**
+ * Function that sets the publishing policy of each topic: replies (commands
+ * and metainfo) are always sent and acknowledged, telemetry (moved and
+ * progress) is shed when the broker does not keep up. It must be called after
+ * the topics are built
+ **/
+void configure_publisher()
+{
+	publisher.set_policy(META_INFO, TopicPolicy(CONTROL_QOS, false));
+	publisher.set_policy(COMMANDS_TOPIC, TopicPolicy(CONTROL_QOS, false));
+	publisher.set_policy(MOVED_TOPIC, TopicPolicy(telemetry_qos, true));
+	publisher.set_policy(PROGRESS_TOPIC, TopicPolicy(telemetry_qos, true));
+	// each batch has different points, so batches are never coalesced
+	publisher.set_policy(MOVED_BATCH_TOPIC, TopicPolicy(telemetry_qos, false));
+	publisher.set_policy(TIMING_TOPIC, TopicPolicy(telemetry_qos, true));
+}
 
-		points.erase(points.begin());
-	}
+/**
+ * The callback function invoked by mosquitto when a message has been sent
+ * (QoS 0) or acknowledged (QoS 1 and 2)
+ **/
+void publish_callback(struct mosquitto *mosq, void *obj, int mid)
+{
+	publisher.on_published(mid);
+}
 
-	//trajectory execution has finished
-	executing_trajectory = false;
+/**
+ * Function that publishes the state of the server after (re)connecting: the
+ * metainfo, the status of the arm (with its owner) and its current position.
+ * Clients that missed messages during an outage get up to date with them
+ **/
+void publish_state()
+{
+	MetaInfoObject mi = initial_metainfoobj();
+	publish_message(META_INFO, wire_encode(mi));
 
-	//clean the current trajectory variable
-	current_trajectory = Trajectory();
+	CommandObject status = CommandObject(ARM_STATUS);
+	uint32_t owner = arm_state.owner();
+	if (owner != NO_CLIENT)
+	{
+		status.client = Client(arm_state.client_id(owner));
+	}
+	status.error = arm_state.error();
+	publish_message(COMMANDS_TOPIC, wire_encode(status));
 
-	return NULL;
+	if (owner != NO_CLIENT)
+	{
+		MovedObject moved = MovedObject();
+		moved.client = status.client;
+		moved.content = measured_point(Point());
+		moved.error = status.error;
+		publish_message(MOVED_TOPIC, wire_encode(moved));
+	}
 }
 
-void handle_signal(int s)
+/**
+ * The callback function invoked by mosquitto when the broker accepts (rc = 0)
+ * or refuses the connection. The subscriptions are renewed (sessions are
+ * clean), the messages kept during the outage are sent and the state is
+ * published again
+ **/
+void connect_callback(struct mosquitto *mosq, void *obj, int rc)
 {
-	run = 0;
+	if (rc != 0)
+	{
+		std::cout << "Broker refused the connection: " << mosquitto_connack_string(rc) << std::endl;
+		return;
+	}
+	long connections = ++broker_connections;
+	if (connections > 1)
+	{
+		std::cout << "Reconnected to the broker after " << reconnect_backoff.attempts() << " attempts" << std::endl;
+	}
+	reconnect_backoff.reset();
+	subscribe_all_topics();
+	publisher.reconnected();
+	publish_state();
 }
 
 /**
- * Function that registers the server into the broker using the suitable topics 
-**/
-void subscribe_all_topics()
+ * The callback function invoked by mosquitto when the connection with the
+ * broker is lost (or closed). Movements go on: their messages are kept by
+ * the publisher until the connection is back
+ **/
+void disconnect_callback(struct mosquitto *mosq, void *obj, int rc)
 {
-	//it builds the topic names (META_INFO,COMMANDS_TOPIC,MOVED_TOPIC)
-	build_topics();
-
-	std::cout << "Subscribing on topic "
-			  << META_INFO
-			  << std::endl;
-	
-	mosquitto_subscribe(mosq, NULL, META_INFO.c_str(), 0);
-
-	std::cout << "Subscribing on topic "
-			  << COMMANDS_TOPIC.c_str()
-			  << std::endl;
-
-	mosquitto_subscribe(mosq, NULL, COMMANDS_TOPIC.c_str(), 0);
+	publisher.disconnected();
+	if (run)
+	{
+		broker_disconnections++;
+		std::cout << "Connection with the broker lost (" << mosquitto_strerror(rc) << ")" << std::endl;
+	}
 }
 
 /**
- * Fuction that publishes a message (the string representation of a JSON object)
- * using a specific topic
+ * Function that waits (delay MILLISECONDS) before the next attempt to
+ * reconnect, returning early when the server is stopped
  **/
-int publish_message(std::string topic, const char *buf)
+void wait_reconnect(long delay)
 {
-    char *payload = (char *)buf;
-	int rc = mosquitto_publish(mosq, NULL, topic.c_str(), strlen(payload), payload, 1, false);
-	return rc;
+	std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+	while (run && std::chrono::steady_clock::now() < until)
+	{
+		std::this_thread::sleep_for(std::min(std::chrono::steady_clock::duration(std::chrono::milliseconds(NETWORK_LOOP_TIMEOUT_MS)),
+											 until - std::chrono::steady_clock::now()));
+	}
 }
 
 /**
@@ -242,54 +1216,84 @@ int publish_message(std::string topic, const char *buf)
 void handle_metainfo_message(std::string mesage)
 {
 	MetaInfoObject mi = initial_metainfoobj();
-	publish_message(META_INFO,mi.to_json().dump().c_str());
+	publish_message(META_INFO, wire_encode(mi));
 }
 
 /**
- * Function that handles messages delivered on channel ROBOT_NAME/commands
+ * Function that executes a command of the async API. Commands come from
+ * messages delivered on channel ROBOT_NAME/commands or from messages in the
+ * old format translated into the async API. The points of a trajectory
+ * decoded into a flat buffer (see stream_command) are given in points, and
+ * are taken from it; otherwise they are those of the command
  **/
-void handle_commands_message(const struct mosquitto_message *message){
+void dispatch_command(CommandObject &receivedCommand, FlatTrajectory &points){
 	//obtains the signal/code
-	int sig = extract_signal((char *)message->payload);
+	int sig = receivedCommand.signal;
 
-	//the answer
+	//the answer (with the trace of the command, if traced)
 	CommandObject output = CommandObject(ARM_STATUS);
+	receivedCommand.trace.mark(receivedCommand.trace.dispatched);
+	output.trace = receivedCommand.trace;
+
+	//only clients that have connected have a handle. Old clients have no session: each of
+	//their commands takes the arm if it is idle and releases it when it finishes
+	bool legacy = receivedCommand.client.id == LEGACY_CLIENT_ID;
+	uint32_t client = sig == ARM_CONNECT || legacy ? arm_state.intern(receivedCommand.client.id)
+												   : arm_state.find(receivedCommand.client.id);
+	uint32_t ready = legacy ? STATE_MASK(ARM_IDLE) : STATE_MASK(ARM_OWNED);
+	uint32_t owner = arm_state.owner();
+	//a client that has disconnected no longer owns the arm, even if its command is still stopping
+	bool from_owner = client != NO_CLIENT && (client == owner || (legacy && owner == NO_CLIENT)) &&
+					  arm_state.state() != ARM_RELEASING;
+	bool connected = false;
+	bool recovering = false;
 
-	//parses the received command from the payload
-	CommandObject receivedCommand = CommandObject::from_json_string((char *)message->payload);
 	switch (sig)
 	{
 	case ARM_CHECK_STATUS: //user requested arm status
-		std::cout << "Request status received. "
+		std::cout << "Request status received (arm is " << ArmStateMachine::name(arm_state.state()) << "). "
 				  << " Sending payload " 
 				  << output.to_json().dump().c_str() << std::endl;
-		publish_message(COMMANDS_TOPIC, output.to_json().dump().c_str());
+		publish_command(output);
 		break;
 	case ARM_CONNECT: //user wants to connect to the arm to become the owner
 		std::cout << "Request to connect received: "
 				  << receivedCommand.to_json().dump().c_str()
 				  << std::endl;
 
-		if (!owner.is_valid())
+		connected = client != NO_CLIENT && arm_state.transition(STATE_MASK(ARM_IDLE), ARM_HOMING, client);
+		// the owner of an arm in ARM_ERROR connects again to recover it (searching home)
+		recovering = !connected && from_owner && arm_state.clear_error(client);
+		if (connected || recovering)
 		{
-			owner = receivedCommand.client;
 			output.signal = ARM_CONNECTED;
-			output.client = owner;
+			output.client = receivedCommand.client;
 			std::cout 	<< "Arm's owner is " 
-						<< owner.to_json().dump().c_str()
+						<< output.client.to_json().dump().c_str()
 						<< std::endl;
 
-			publish_message(COMMANDS_TOPIC, output.to_json().dump().c_str());
+			publish_command(output);
 			
 			std::cout << "Moving arm to home..." << std::endl;
+			current_trace = receivedCommand.trace;
 
-			int err = pthread_create(&search_home_thread, NULL, &search_home_threaded_function, NULL);
-			pthread_detach(search_home_thread);
-
-			// handle err?
+			if (!start_command_thread(search_home_thread, &search_home_threaded_function, client))
+			{
+				// the arm goes back to the state before the command, with an error
+				arm_state.transition(STATE_MASK(ARM_HOMING), recovering ? ARM_ERROR : ARM_IDLE, client);
+				output.signal = recovering ? ARM_STATUS : ARM_DISCONNECTED;
+				output.error = true;
+				publish_command(output);
+				if (!recovering)
+				{
+					arm_state.release(client);
+				}
+			}
 		}
 		else
 		{
+			// a refused client is not kept (unless it already owns the arm)
+			arm_state.release(client);
 			std::cout << "Connection refused. Arm is busy" << std::endl;
 		}
 
@@ -297,73 +1301,82 @@ void handle_commands_message(const struct mosquitto_message *message){
 	case ARM_MOVE_TO_POINT: //user requested to move the arm to a single point
 		std::cout << "Move to point request received. " << std::endl;
 
-		if (owner.is_valid())
+		// only owner can do that, when the arm is stopped. Otherwise ==> ignore
+		if (!receivedCommand.point.is_empty() && from_owner &&
+			arm_state.transition(ready, ARM_MOVING, client))
 		{
-			Client client = receivedCommand.client;
-			if (owner == client) // only owner can do that
-			{
-				Point target = receivedCommand.point;
-				if (!target.is_empty())
-				{
-					current_point = target;
-					int err = pthread_create(&move_to_point_thread, NULL, &move_to_point_threaded_function, NULL);
-					pthread_detach(move_to_point_thread);
-
-					// handle err?
-				}
-			}
-			else
+			current_point = receivedCommand.point;
+			current_trace = receivedCommand.trace;
+			arm_motion.reset_cancel();
+			if (!start_command_thread(move_to_point_thread, &move_to_point_threaded_function, client))
 			{
-				// other client is trying to move the arm ==> ignore
+				// the arm does not move. The client is told with an error
+				current_point = Point();
+				finish_command(STATE_MASK(ARM_MOVING), client);
+				output.client = receivedCommand.client;
+				output.error = true;
+				publish_command(output);
 			}
 		}
-		else
+		else if (from_owner)
 		{
-			// arm has no owner ==> ignore
+			std::cout << "Arm is " << ArmStateMachine::name(arm_state.state()) << ". Move ignored" << std::endl;
 		}
 		break;
 	case ARM_APPLY_TRAJECTORY:  //user requested to apply a trajectory
 		std::cout << "Apply trajectory received. " << std::endl;
-		if (owner.is_valid())
+
+		// only owner can do that, when the arm is stopped. Otherwise ==> ignore
+		if (from_owner && arm_state.transition(ready, ARM_EXECUTING, client))
 		{
-			Client client = receivedCommand.client;
-			if (owner == client) //only owner can do that
-			{
-				current_trajectory = receivedCommand.trajectory;
-				int err = pthread_create(&apply_trajectory_thread, NULL, &apply_trajectory_threaded_function, NULL);
-				pthread_detach(apply_trajectory_thread);
+			current_trace = receivedCommand.trace;
+			start_trajectory(receivedCommand.trajectory, points, receivedCommand.simplify, client, false);
+		}
+		else if (from_owner)
+		{
+			std::cout << "Arm is " << ArmStateMachine::name(arm_state.state()) << ". Trajectory ignored" << std::endl;
+		}
+		break;
+	case ARM_APPLY_CARTESIAN_TRAJECTORY:  //user requested to apply a trajectory of cartesian waypoints
+		std::cout << "Apply cartesian trajectory received. " << std::endl;
 
-				// handle err?
-			}
-			else
-			{
-				// other client is trying to move the arm ==> ignore
-			}
+		// only owner can do that, when the arm is stopped. Otherwise ==> ignore
+		if (from_owner && arm_state.transition(STATE_MASK(ARM_OWNED), ARM_EXECUTING, client))
+		{
+			// the waypoints are expanded (inverse kinematics) by the trajectory thread
+			current_trace = receivedCommand.trace;
+			start_trajectory(receivedCommand.trajectory, points, receivedCommand.simplify, client, true);
 		}
-		else
+		else if (from_owner)
 		{
-			// arm has no owner ==> ignore
+			std::cout << "Arm is " << ArmStateMachine::name(arm_state.state()) << ". Trajectory ignored" << std::endl;
 		}
 		break;
 	case ARM_CANCEL_TRAJECTORY: //user requested to cancel trajectory execution
 		std::cout << "Cancel trajectory received. " << std::endl;
-		if (owner.is_valid())
+		if (from_owner) // only owner can do that
 		{
-			Client client = receivedCommand.client;
-			if (owner == client) // only owner can do that
+			if (arm_state.transition(STATE_MASK(ARM_EXECUTING), ARM_CANCELLING, client))
+			{
+				// preempts the current movement. ARM_CANCELED_TRAJECTORY is sent
+				// by the trajectory thread when the arm has actually stopped
+				cancel_trace = receivedCommand.trace;
+				arm_motion.cancel();
+			}
+			else
 			{
-				executing_trajectory = false;
+				// nothing is being executed
 				output.signal = ARM_CANCELED_TRAJECTORY;
-				output.client = owner;
-				output.error = error_state;
+				output.client = receivedCommand.client;
+				output.error = arm_state.error();
 
-				publish_message(COMMANDS_TOPIC, output.to_json().dump().c_str());
+				publish_command(output);
 				std::cout << "Trajectory cancelled. " << std::endl;
 			}
 		}
 		else
 		{
-			// arm has no owner ==> ignore
+			// arm has no owner or other client is trying to cancel ==> ignore
 		}
 		break;
 	case ARM_DISCONNECT: //user requested to disconnect from the arm
@@ -372,13 +1385,26 @@ void handle_commands_message(const struct mosquitto_message *message){
 		std::cout << "Request disconnect received: " 
 			<< receivedCommand.to_json().dump().c_str()
 			<< std::endl;
-		if (c == owner) // only owner can do that
+		ArmStateKind previous;
+		// only owner can do that. While a command is running the arm is not released until
+		// its thread stops (ARM_RELEASING), so a new owner cannot start another command on
+		// the joints. Only the message thread starts commands, so a failed first transition
+		// leaves the arm stopped (ARM_OWNED or ARM_ERROR)
+		if (from_owner && (arm_state.transition(COMMAND_RUNNING_STATE, ARM_RELEASING, client, &previous) ||
+						   arm_state.transition(ANY_OWNED_STATE, ARM_IDLE, client, &previous)))
 		{
-			owner = Client();
+			// a released arm does not keep moving. Homing cannot be interrupted: the
+			// arm is released when home has been searched
+			if (previous == ARM_MOVING || previous == ARM_EXECUTING)
+			{
+				arm_motion.cancel();
+			}
 			output.signal = ARM_DISCONNECTED;
 			output.client = c;
+			// not released while the arm is ARM_RELEASING (release_command does it)
+			arm_state.release(client);
 
-			publish_message(COMMANDS_TOPIC, output.to_json().dump().c_str());
+			publish_command(output);
 			std::cout 	<< "Client disconnected " 
 						<< output.to_json().dump().c_str()
 						<< std::endl;
@@ -388,26 +1414,137 @@ void handle_commands_message(const struct mosquitto_message *message){
 		// incluir default
 		// default:
 	}
+
+	//the handle of an old client is only kept while its command holds the arm
+	if (legacy && arm_state.owner() != client)
+	{
+		arm_state.release(client);
+	}
 }
 
+/**
+ * Function that executes a command whose points (if any) are in the command
+ **/
+void dispatch_command(CommandObject &receivedCommand){
+	FlatTrajectory points = FlatTrajectory();
+	dispatch_command(receivedCommand, points);
+}
 
 /**
- * The callback function invoked by mosquitto when notifying all applications subscribed
- * on specific topics  
-**/
-void message_callback(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message)
-{
+ * Function that says if the trajectory of a received command has to be
+ * decoded: only the trajectories of the owner of the arm are executed
+ **/
+bool trajectory_wanted(CommandsSignal signal, const Client &client){
+	uint32_t handle = arm_state.find(client.id);
+	return handle != NO_CLIENT && handle == arm_state.owner();
+}
 
-	/**
-	 * If the message contains a signal then it has been sent from some application
-	 * the follows the async specification (the new model/flow). Otherwise, the server
-	 * must handle the message as before. 
-	**/
-	bool new_flow = has_signal((char *) message->payload);
+/**
+ * Function that handles messages delivered on channel ROBOT_NAME/commands.
+ * The command is decoded while it is read (the points of a trajectory go
+ * straight into a flat buffer), and malformed commands are ignored
+ **/
+void handle_commands_message(const struct mosquitto_message *message){
+	CommandObject receivedCommand = CommandObject(ARM_CHECK_STATUS);
+	FlatTrajectory points = FlatTrajectory();
+	if (!stream_command((const char *)message->payload, message->payloadlen, receivedCommand, points, trajectory_wanted))
+	{
+		std::cout << "Ignoring malformed command of " << message->payloadlen << " bytes" << std::endl;
+		return;
+	}
+	//cartesian waypoints are expanded from a list of points. Points in joint
+	//space are executed from the flat buffer, without copying them
+	if (receivedCommand.signal == ARM_APPLY_CARTESIAN_TRAJECTORY)
+	{
+		points.to_points(receivedCommand.trajectory.points);
+		points.clear();
+	}
+
+	//a traced command gets the instants it was received
+	if (!receivedCommand.trace.is_empty())
+	{
+		receivedCommand.trace.received = message_received;
+		receivedCommand.trace.received_monotonic = message_received_monotonic;
+	}
+
+	dispatch_command(receivedCommand, points);
+}
+
+/**
+ * Function that handles a command already parsed in the message arena
+ * (--command-decoder arena)
+ **/
+void handle_commands_message(const arena_json &parsed){
+	CommandObject receivedCommand = CommandObject(ARM_CHECK_STATUS);
+	if (!command_from_json(parsed, receivedCommand))
+	{
+		std::cout << "Ignoring malformed command " << parsed.dump() << std::endl;
+		return;
+	}
+
+	if (!receivedCommand.trace.is_empty())
+	{
+		receivedCommand.trace.received = message_received;
+		receivedCommand.trace.received_monotonic = message_received_monotonic;
+	}
+
+	dispatch_command(receivedCommand);
+}
+
+/**
+ * Function that handles a command encoded with the compact codec
+ **/
+void handle_encoded_message(const struct mosquitto_message *message){
+	if (std::strcmp(message->topic, COMMANDS_TOPIC.c_str()) != 0)
+	{
+		return;
+	}
+	CommandObject receivedCommand = CommandObject(ARM_CHECK_STATUS);
+	if (!decode_command((const char *)message->payload, message->payloadlen, receivedCommand))
+	{
+		std::cout << "Ignoring malformed encoded command of " << message->payloadlen << " bytes" << std::endl;
+		return;
+	}
+	receivedCommand.error = arm_state.error();
+
+	dispatch_command(receivedCommand);
+}
+
+/**
+ * Function that handles messages in the old format [type,mode,url,n,sleep].
+ * The message is tokenized in place (without modifying the payload) and
+ * translated into the equivalent command of the async API.
+ **/
+void handle_legacy_message(const struct mosquitto_message *message){
+	LegacyCommand legacy;
+	if (!parse_legacy_command((const char *)message->payload, message->payloadlen, legacy))
+	{
+		std::cout << "Ignoring malformed message on topic " << message->topic << std::endl;
+		return;
+	}
+
+	CommandObject receivedCommand = CommandObject(ARM_CHECK_STATUS);
+	if (!legacy_to_command(legacy, measured_point(Point()), receivedCommand))
+	{
+		std::cout << "Legacy command type " << legacy.type
+				  << " has no equivalent in the async API" << std::endl;
+		return;
+	}
+
+	dispatch_command(receivedCommand);
+}
+
+
+/**
+ * Function that sends a received message to its handler, depending on the
+ * format, the topic and the signal. Commands already parsed in the message
+ * arena are given in parsed (NULL if they have to be decoded)
+ **/
+void route_message(const struct mosquitto_message *message, bool new_flow, int sig, const arena_json *parsed)
+{
 	if(new_flow){
 		//this is the logic for processing messages in the new model
 		bool match = std::strcmp(message->topic,"metainfo") == 0;
-		int sig = extract_signal((char *)message->payload);
 		if(match){
 			if(sig == ARM_GET_METAINFO){
 				handle_metainfo_message((char *)message->payload);
@@ -415,7 +1552,9 @@ void message_callback(struct mosquitto *mosq, void *obj, const struct mosquitto_
 
 		} else {
 			match = std::strcmp(message->topic,COMMANDS_TOPIC.c_str()) == 0;
-			if (match){
+			if (match && parsed != NULL){
+				handle_commands_message(*parsed);
+			} else if (match){
 				handle_commands_message(message);
 			}
 		}
@@ -423,21 +1562,217 @@ void message_callback(struct mosquitto *mosq, void *obj, const struct mosquitto_
 	} else {
 
 		/**
-		 * TODO: This is the sapce to put all the old code where the robot
-		 * received messages with a different structure of the async API 
+		 * Messages with the old structure [type,mode,url,n,sleep] are translated
+		 * into the async API and handled by the same code as the new model. Old
+		 * clients are all seen as the client LEGACY_CLIENT_ID
 		**/
+		bool match = std::strcmp(message->topic,LEGACY_COMMANDS_TOPIC.c_str()) == 0 ||
+					 std::strcmp(message->topic,COMMANDS_TOPIC.c_str()) == 0;
+		if (match){
+			handle_legacy_message(message);
+		}
+	}
+}
+
+/**
+ * The callback function invoked by mosquitto when notifying all applications subscribed
+ * on specific topics  
+**/
+void message_callback(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message)
+{
+	std::lock_guard<std::mutex> lock(dispatch_mutex);
+	message_received = TraceContext::wall_clock();
+	message_received_monotonic = TraceContext::monotonic();
+
+	//the server only subscribes on metainfo and commands topics, so everything is captured
+	if (session_capture.is_open())
+	{
+		session_capture.record(message->topic, message->payload, message->payloadlen);
+	}
+
+	long allocations = allocation_count();
+	long arena_blocks = 0;
+	size_t arena_bytes = 0;
+
+	/**
+	 * If the message contains a signal then it has been sent from some application
+	 * the follows the async specification (the new model/flow). Otherwise, the server
+	 * must handle the message as before. 
+	**/
+	if (is_encoded(message->payload, message->payloadlen))
+	{
+		//commands encoded with the compact codec (advertised in metainfo)
+		handle_encoded_message(message);
+	}
+	else if (stream_commands && std::strcmp(message->topic, COMMANDS_TOPIC.c_str()) == 0 &&
+			 is_json_object(message->payload, message->payloadlen))
+	{
+		//commands are decoded while they are read, without building a document
+		handle_commands_message(message);
+	}
+	else if (message_arena_size > 0)
+	{
+		if (message_arena == NULL)
+		{
+			message_arena = new MessageArena(message_arena_size);
+		}
+
+		//the payload is parsed once, and all its nodes are released at once
+		ArenaScope scope(message_arena);
+		const char *payload = (const char *)message->payload;
+		arena_json parsed = arena_json::parse(payload, payload + message->payloadlen, nullptr, false);
+		arena_json::const_iterator signal = parsed.is_object() ? parsed.find("signal") : parsed.end();
+		bool new_flow = signal != parsed.end();
+		int sig = new_flow && signal->is_number_integer() ? signal->get<int>() : 0;
+		route_message(message, new_flow, sig, &parsed);
+		arena_blocks = message_arena->blocks();
+		arena_bytes = message_arena->used();
+	}
+	else
+	{
+		bool new_flow = has_signal((char *) message->payload);
+		int sig = new_flow ? extract_signal((char *)message->payload) : 0;
+		route_message(message, new_flow, sig, NULL);
 	}
 
+	message_stats.record(allocation_count() - allocations, arena_blocks, arena_bytes);
+}
+
+
+/**
+ * Function that handles a message of a local client exactly as a message
+ * delivered by the broker on the same topic
+ **/
+void local_message(const std::string &topic, const char *payload, size_t length)
+{
+	struct mosquitto_message message;
+	memset(&message, 0, sizeof(message));
+	message.topic = (char *)topic.c_str();
+	message.payload = (void *)payload;
+	message.payloadlen = (int)length;
+	message_callback(mosq, NULL, &message);
 }
 
+/**
+ * Function that reads the command line options of the server:
+ * --progress-rate <hz>  maximum rate of progress messages (0 = unlimited)
+ * --blend-tolerance <degrees>  maximum deviation at the corners of trajectories (0 = no blending)
+ * --record <prefix>  records the joints into the files prefix.N.rec
+ * --record-rate <hz>  sampling rate of the recording
+ * --capture <file>  captures the received messages into file
+ * --telemetry-qos <qos>  QoS of the moved and progress messages
+ * --publish-window <n>  messages in flight above which telemetry is shed
+ * --publish-queue <n>  messages waiting to be published above which telemetry is discarded
+ * --message-arena <bytes>  size of the arena where messages are parsed (0 = heap)
+ * --command-decoder <stream|arena>  decodes commands while reading them or parses them in the arena
+ * --moved-batch <n>  points of each encoded batch on ROBOT_NAME/moved/batch (0 = no batches)
+ * --miss-threshold <n>  deadline misses of a movement that raise the timing alert
+ * --outage-buffer <n>  messages kept while the broker is unreachable
+ * --local-socket <path>  accepts the commands of local clients on a Unix-domain socket
+ * --local-socket-mode <octal>  permissions of the local socket (default 0600)
+ * --simplify <degrees>  simplifies the trajectories that do not request it (0 = only on request)
+ **/
+void parse_arguments(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--progress-rate") == 0 && i + 1 < argc)
+		{
+			progress_max_rate = atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--blend-tolerance") == 0 && i + 1 < argc)
+		{
+			blend_tolerance = atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+		{
+			record_prefix = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--record-rate") == 0 && i + 1 < argc)
+		{
+			record_rate = atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			session_capture.open(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--telemetry-qos") == 0 && i + 1 < argc)
+		{
+			telemetry_qos = atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--publish-window") == 0 && i + 1 < argc)
+		{
+			publisher.set_high_water(atol(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--publish-queue") == 0 && i + 1 < argc)
+		{
+			publisher_thread.set_limit(atol(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--message-arena") == 0 && i + 1 < argc)
+		{
+			message_arena_size = atol(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--command-decoder") == 0 && i + 1 < argc)
+		{
+			stream_commands = std::strcmp(argv[++i], "arena") != 0;
+		}
+		else if (std::strcmp(argv[i], "--moved-batch") == 0 && i + 1 < argc)
+		{
+			moved_batch_size = atol(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--miss-threshold") == 0 && i + 1 < argc)
+		{
+			miss_threshold = atol(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--outage-buffer") == 0 && i + 1 < argc)
+		{
+			publisher.set_outage_limit(atol(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--local-socket") == 0 && i + 1 < argc)
+		{
+			local_socket_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--local-socket-mode") == 0 && i + 1 < argc)
+		{
+			local_socket_mode = (mode_t)strtol(argv[++i], NULL, 8);
+		}
+		else if (std::strcmp(argv[i], "--simplify") == 0 && i + 1 < argc)
+		{
+			simplify_tolerance = atof(argv[++i]);
+		}
+		else
+		{
+			std::cout << "Ignoring unknown option " << argv[i] << std::endl;
+		}
+	}
+}
 
 int main(int argc, char *argv[])
 {
 
-	uint8_t reconnect = true;
 	char clientid[24];
 	int rc = 0;
 
+	parse_arguments(argc, argv);
+	configure_controllers();
+	arm_motion.set_reader(read_simulated_encoders);
+	arm_motion.set_settling(SETTLE_TOLERANCE, SETTLE_TIME_US, SETTLE_TIMEOUT_US);
+	std::vector<double> minimum;
+	std::vector<double> maximum;
+	for (const JointInfo &joint : METAINFOS)
+	{
+		// the minimum of metainfo may be greater than the maximum
+		minimum.push_back(std::min(joint.minimum, joint.maximum));
+		maximum.push_back(std::max(joint.minimum, joint.maximum));
+	}
+	arm_motion.set_range(minimum, maximum);
+
+	EncoderRecorder recorder = EncoderRecorder(read_simulated_joints, record_rate, record_prefix);
+	if (!record_prefix.empty())
+	{
+		recorder.start();
+	}
+
 	signal(SIGINT, handle_signal);
 	signal(SIGTERM, handle_signal);
 
@@ -450,42 +1785,80 @@ int main(int argc, char *argv[])
 	if (mosq)
 	{
 		mosquitto_message_callback_set(mosq, message_callback);
-    
-		rc = mosquitto_connect(mosq, mqtt_host, mqtt_port, 60);
-
-		//subscribe on all relevant topics
-        subscribe_all_topics();
+		mosquitto_publish_callback_set(mosq, publish_callback);
+		mosquitto_connect_callback_set(mosq, connect_callback);
+		mosquitto_disconnect_callback_set(mosq, disconnect_callback);
+
+		//the topic names never change after this; they are subscribed (and the
+		//metainfo published) once connected
+		build_topics();
+		configure_publisher();
+		publisher.disconnected();
+		publisher_thread.start(deliver_message);
+		if (!local_socket_path.empty())
+		{
+			local_transport.start(local_socket_path, local_message, local_socket_mode);
+		}
 
-		//publishes the metainfo of the robot
-		MetaInfoObject mi = initial_metainfoobj();
-		publish_message(META_INFO,mi.to_json().dump().c_str());
-		std::cout << "Metainfo published: " << mi.to_json().dump().c_str()
+		rc = mosquitto_connect(mosq, mqtt_host, mqtt_port, BROKER_KEEPALIVE);
+		std::cout << "Metainfo: " << initial_metainfoobj().to_json().dump().c_str()
 				  << std::endl
 				  << std::endl
 				  << "Server ready to send/receive messages "
 				  << std::endl
 				  << std::endl;
 
-		rc = mosquitto_loop_start(mosq);
+		//the network loop runs here: when the connection is lost the server
+		//reconnects with backoff while movements go on in their own threads
 		while (run)
 		{
-			
-			if (run && rc)
+			if (rc == MOSQ_ERR_SUCCESS)
+			{
+				rc = mosquitto_loop(mosq, NETWORK_LOOP_TIMEOUT_MS, 1);
+			}
+			if (run && rc != MOSQ_ERR_SUCCESS)
 			{
-				printf("connection error!\n");
-				sleep(1);
-				mosquitto_reconnect(mosq);
+				publisher.disconnected();
+				long delay = reconnect_backoff.next_delay();
+				std::cout << "Broker unreachable (" << mosquitto_strerror(rc) << "), reconnecting in "
+						  << delay << " ms" << std::endl;
+				wait_reconnect(delay);
+				if (run)
+				{
+					rc = mosquitto_reconnect(mosq);
+				}
 			}
-            else
-            {
-                //printf("server conected to mosquitto broker!\n");
-            }
 		}
-		mosquitto_loop_stop(mosq,true);
+		rc = MOSQ_ERR_SUCCESS;
+		publisher_thread.stop();
+		local_transport.stop();
+		mosquitto_disconnect(mosq);
 		mosquitto_destroy(mosq);
 	}
 
 	mosquitto_lib_cleanup();
 
+	if (!record_prefix.empty())
+	{
+		recorder.stop();
+		std::cout << "Recorded " << recorder.written << " samples ("
+				  << recorder.dropped << " dropped)" << std::endl;
+	}
+	std::cout << "Publisher: " << publisher.to_json().dump() << ", queue " << publisher_thread.max_queued
+			  << " messages at most, " << publisher_thread.discarded << " discarded" << std::endl;
+	std::cout << "Messages: " << message_stats.to_json().dump() << std::endl;
+	std::cout << "Controller registers: " << controller_registers.to_json().dump() << std::endl;
+	std::cout << "Broker: " << broker_connections.load() << " connections, " << broker_disconnections.load()
+			  << " lost" << std::endl;
+	if (!local_socket_path.empty())
+	{
+		std::cout << "Local clients: " << local_transport.to_json().dump() << std::endl;
+	}
+	if (session_capture.is_open())
+	{
+		session_capture.close();
+		std::cout << "Captured " << session_capture.captured << " messages" << std::endl;
+	}
+
 	return rc;
 }
\ No newline at end of file
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""
+Generates the JSON encoders and decoders of the messages of the controller
+from the AsyncAPI document (edscorbot-async-api.yaml), so the document is the
+only definition of the wire format.
+
+For every object schema it generates, for the class of the same name in
+server-defs.hpp:
+  void wire_write(std::string &out, const <Schema> &v)
+  bool wire_read(WireReader &in, <Schema> &v)
+Properties are mapped to members with snake_case names (maxVelocity is
+max_velocity) and the types of the members are checked against the schema
+at compile time. For every integer enum it checks the values of the enum of
+the same name.
+
+Usage: asyncapi_codegen.py <asyncapi document> <output header>
+"""
+
+import os
+import re
+import sys
+
+import yaml
+
+
+def member_name(prop):
+    return re.sub(r"([A-Z])", r"_\1", prop).lower()
+
+
+def ref_name(schema):
+    return schema["$ref"].split("/")[-1]
+
+
+class Generator:
+    def __init__(self, schemas):
+        self.schemas = schemas
+        self.lines = []
+
+    def emit(self, line=""):
+        self.lines.append(line)
+
+    def is_enum(self, name):
+        return "enum" in self.schemas[name]
+
+    def kind(self, schema):
+        """number, integer, boolean, string, enum:<Name>, object:<Name> or array"""
+        if "$ref" in schema:
+            name = ref_name(schema)
+            return ("enum:" if self.is_enum(name) else "object:") + name
+        kind = schema.get("type")
+        if kind not in ("number", "integer", "boolean", "string", "array"):
+            raise ValueError("unsupported schema %r" % schema)
+        return kind
+
+    def enum_values(self, name):
+        values = []
+        for entry in self.schemas[name]["enum"]:
+            match = re.match(r"^\s*(\w+)\s*=\s*(-?\d+)\s*$", str(entry))
+            if not match:
+                raise ValueError("enum %s: entries must be NAME = value, not %r" % (name, entry))
+            values.append((match.group(1), int(match.group(2))))
+        return values
+
+    def generate(self, source):
+        objects = [n for n, s in self.schemas.items() if s.get("type") == "object"]
+        enums = [n for n in self.schemas if self.is_enum(n)]
+
+        self.emit("// Generated by src/tools/asyncapi_codegen.py from %s. Do not edit." % source)
+        self.emit("#ifndef MESSAGES_GEN_HPP")
+        self.emit("#define MESSAGES_GEN_HPP")
+        self.emit()
+        # the header is generated in the build tree: the path is relative to src
+        self.emit('#include "include/wire-defs.hpp"')
+        self.emit()
+
+        for name in enums:
+            self.emit("// %s" % name)
+            for value_name, value in self.enum_values(name):
+                self.emit('static_assert(%s == %d, "%s differs from the AsyncAPI document");'
+                          % (value_name, value, value_name))
+            self.emit()
+            self.emit("inline bool wire_read(WireReader &in, %s &v)" % name)
+            self.emit("{")
+            self.emit("    int value;")
+            self.emit("    if (!in.read_integer(value))")
+            self.emit("    {")
+            self.emit("        return false;")
+            self.emit("    }")
+            self.emit("    v = (%s)value;" % name)
+            self.emit("    return true;")
+            self.emit("}")
+            self.emit()
+            self.emit("inline void wire_write(std::string &out, %s v)" % name)
+            self.emit("{")
+            self.emit("    wire_write_integer(out, (int)v);")
+            self.emit("}")
+            self.emit()
+
+        # objects refer to each other
+        for name in objects:
+            self.emit("inline void wire_write(std::string &out, const %s &v);" % name)
+            self.emit("inline bool wire_read(WireReader &in, %s &v);" % name)
+        self.emit()
+
+        for name in objects:
+            self.generate_writer(name)
+            self.generate_reader(name)
+
+        self.emit("#endif")
+        return "\n".join(self.lines) + "\n"
+
+    def properties(self, name):
+        schema = self.schemas[name]
+        required = set(schema.get("required", []))
+        for prop, prop_schema in schema.get("properties", {}).items():
+            yield prop, member_name(prop), prop_schema, prop in required
+
+    def generate_writer(self, name):
+        self.emit("/**")
+        self.emit(" * %s" % name)
+        self.emit(" **/")
+        self.emit("inline void wire_write(std::string &out, const %s &v)" % name)
+        self.emit("{")
+        self.emit("    bool first = true;")
+        self.emit("    out += '{';")
+        for prop, member, schema, required in self.properties(name):
+            kind = self.kind(schema)
+            indent = "    "
+            # optional objects and arrays are written only if they have content
+            optional = not required and (kind.startswith("object:") or kind == "array")
+            if optional:
+                self.emit("    if (wire_present(v.%s))" % member)
+                self.emit("    {")
+                indent = "        "
+            self.emit('%swire_write_key(out, first, "%s");' % (indent, prop))
+            self.emit("%s%s;" % (indent, self.write_value(kind, schema, "v." + member)))
+            if optional:
+                self.emit("    }")
+        self.emit("    out += '}';")
+        self.emit("}")
+        self.emit()
+
+    def write_value(self, kind, schema, value):
+        if kind == "number":
+            return "wire_write_number(out, %s)" % value
+        if kind == "integer":
+            return "wire_write_integer(out, %s)" % value
+        if kind == "boolean":
+            return "wire_write_bool(out, %s)" % value
+        if kind == "string":
+            return "wire_write_string(out, %s)" % value
+        if kind == "array":
+            item = self.kind(schema["items"])
+            if item.startswith("enum:"):
+                item = "integer"
+            return "wire_write_%s_array(out, %s)" % (item.split(":")[0], value)
+        return "wire_write(out, %s)" % value
+
+    def read_value(self, kind, schema, value):
+        if kind == "number":
+            return "in.read_number(%s)" % value
+        if kind == "integer":
+            return "in.read_integer(%s)" % value
+        if kind == "boolean":
+            return "in.read_bool(%s)" % value
+        if kind == "string":
+            return "in.read_string(%s)" % value
+        if kind == "array":
+            item = self.kind(schema["items"])
+            if item.startswith("enum:"):
+                item = "integer"
+            return "wire_read_%s_array(in, %s)" % (item.split(":")[0], value)
+        return "wire_read(in, %s)" % value
+
+    def generate_reader(self, name):
+        props = list(self.properties(name))
+        self.emit("inline bool wire_read(WireReader &in, %s &v)" % name)
+        self.emit("{")
+        for prop, member, schema, required in props:
+            if required:
+                self.emit("    bool has_%s = false;" % member)
+        self.emit("    std::string_view key;")
+        self.emit("    if (!in.begin_object())")
+        self.emit("    {")
+        self.emit("        return false;")
+        self.emit("    }")
+        self.emit("    for (bool first = true; in.next_key(key, first); first = false)")
+        self.emit("    {")
+        keyword = "if"
+        for prop, member, schema, required in props:
+            self.emit('        %s (key == "%s")' % (keyword, prop))
+            self.emit("        {")
+            self.emit("            if (!%s)" % self.read_value(self.kind(schema), schema, "v." + member))
+            self.emit("            {")
+            self.emit("                return false;")
+            self.emit("            }")
+            if required:
+                self.emit("            has_%s = true;" % member)
+            self.emit("        }")
+            keyword = "else if"
+        if props:
+            self.emit("        else if (!in.skip_value())")
+        else:
+            self.emit("        if (!in.skip_value())")
+        self.emit("        {")
+        self.emit("            return false;")
+        self.emit("        }")
+        self.emit("    }")
+        checks = ["!in.failed()"] + ["has_%s" % m for _, m, _, r in props if r]
+        self.emit("    return %s;" % " && ".join(checks))
+        self.emit("}")
+        self.emit()
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write("Usage: asyncapi_codegen.py <asyncapi document> <output header>\n")
+        return 1
+    with open(sys.argv[1]) as document:
+        spec = yaml.safe_load(document)
+    code = Generator(spec["components"]["schemas"]).generate(os.path.basename(sys.argv[1]))
+
+    output = sys.argv[2]
+    if os.path.dirname(output):
+        os.makedirs(os.path.dirname(output), exist_ok=True)
+    # the header is rewritten only if it changes, so it does not trigger rebuilds
+    if os.path.exists(output):
+        with open(output) as current:
+            if current.read() == code:
+                return 0
+    with open(output, "w") as header:
+        header.write(code)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "../impl/motion-impls.cpp"
+
+/**
+ * Latency harness of the controller. It measures, without broker nor
+ * clients, the latencies of the motion path of the server:
+ *
+ * cancel - time from a cancel request to its detection by the control
+ *          loop (preemption) and to the arm being stopped
+ * ticks - delay of the ticks of the control loop with respect to their
+ *         schedule, time spent in each tick and deadline misses
+ *
+ * Usage: latency_harness [runs]
+ **/
+
+#define DEFAULT_RUNS 20
+
+/**
+ * Prints minimum, average, percentile 99 and maximum of a set of samples
+ **/
+void print_statistics(const char *name, const char *unit, std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for (double s : samples)
+	{
+		sum += s;
+	}
+	size_t p99 = std::min(samples.size() - 1, (size_t)(samples.size() * 0.99));
+	std::cout << name
+			  << " min " << samples.front() << unit
+			  << " avg " << sum / samples.size() << unit
+			  << " p99 " << samples[p99] << unit
+			  << " max " << samples.back() << unit
+			  << std::endl;
+}
+
+/**
+ * Cancels movements at random instants and measures cancel-to-preempt
+ * and cancel-to-stop latencies
+ **/
+void cancel_latency(int runs)
+{
+	std::vector<double> preempt;
+	std::vector<double> stop;
+	std::vector<double> delay;
+	std::vector<double> work;
+	long ticks = 0;
+	long misses = 0;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<double> instant(0.1, 0.9);
+	std::vector<double> home = std::vector<double>(6, 0.0);
+	std::vector<double> target = {90.0, 45.0, -60.0, 30.0, 180.0, 50.0};
+
+	for (int i = 0; i < runs; i++)
+	{
+		ArmMotion motion = ArmMotion(6, CONTROL_PERIOD_US, CANCEL_DECELERATION);
+		PointToPointProfile profile = PointToPointProfile(home, target, DEFAULT_MOVE_DURATION);
+		MotionResult result = MOTION_DONE;
+
+		std::thread executor([&]
+							 { result = motion.execute(profile); });
+		std::this_thread::sleep_for(std::chrono::duration<double>(DEFAULT_MOVE_DURATION * instant(random)));
+		motion.cancel();
+		executor.join();
+
+		if (result == MOTION_CANCELED)
+		{
+			preempt.push_back(std::chrono::duration<double, std::micro>(motion.preempt_time - motion.cancel_time).count());
+			stop.push_back(std::chrono::duration<double, std::milli>(motion.stop_time - motion.cancel_time).count());
+		}
+		// percentile 99 of each run
+		delay.push_back(motion.timing.period_error.percentile(0.99) / 1000.0);
+		work.push_back(motion.timing.tick_work.percentile(0.99) / 1000.0);
+		ticks += motion.timing.ticks.load();
+		misses += motion.timing.misses.load();
+	}
+
+	std::cout << "Cancel latency (" << preempt.size() << " runs, period "
+			  << CONTROL_PERIOD_US << " us, deceleration " << CANCEL_DECELERATION << " deg/s^2)" << std::endl;
+	print_statistics("  cancel-to-preempt", " us", preempt);
+	print_statistics("  cancel-to-stop   ", " ms", stop);
+	std::cout << "Ticks (" << ticks << " ticks, " << misses << " deadline misses, p99 of each run)" << std::endl;
+	print_statistics("  tick delay       ", " us", delay);
+	print_statistics("  tick work        ", " us", work);
+}
+
+int main(int argc, char *argv[])
+{
+	int runs = DEFAULT_RUNS;
+	if (argc > 1)
+	{
+		runs = atoi(argv[1]);
+	}
+
+	cancel_latency(runs);
+
+	return 0;
+}
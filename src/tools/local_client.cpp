@@ -0,0 +1,70 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include "../impl/server-impls.cpp"
+#include "../impl/socket-impls.cpp"
+
+/**
+ * A client of the local transport of the server (option --local-socket).
+ * It sends a message on a topic and prints every message received for a
+ * while, with the time elapsed since the message was sent:
+ *
+ * Usage: local_client <socket> <topic> <payload> [seconds]
+ *
+ * e.g. local_client /tmp/edscorbot.sock EDScorbotSim/commands '{"signal":3}'
+ **/
+
+#define DEFAULT_LISTEN_SECONDS 1.0
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: local_client <socket> <topic> <payload> [seconds]" << std::endl;
+		return 1;
+	}
+	double seconds = argc > 4 ? atof(argv[4]) : DEFAULT_LISTEN_SECONDS;
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+	{
+		std::cerr << "Cannot connect to " << argv[1] << ": " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!write_local_frame(fd, argv[2], argv[3], strlen(argv[3])))
+	{
+		std::cerr << "Cannot send the message" << std::endl;
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point until = start + std::chrono::microseconds((long)(seconds * 1e6));
+	std::string topic;
+	std::string payload;
+	while (std::chrono::steady_clock::now() < until)
+	{
+		long left = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now()).count();
+		struct pollfd input = {fd, POLLIN, 0};
+		if (poll(&input, 1, (int)std::max(0L, left)) <= 0)
+		{
+			continue;
+		}
+		if (!read_local_frame(fd, topic, payload))
+		{
+			std::cerr << "Connection closed by the server" << std::endl;
+			break;
+		}
+		double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		printf("%10.1f us  %s %s\n", elapsed, topic.c_str(), payload.c_str());
+	}
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include "../impl/server-impls.cpp"
+#include "../impl/publisher-impls.cpp"
+
+/**
+ * Stress test of the queue of the publisher thread (PublisherThread), meant
+ * to be run under ThreadSanitizer (cmake option EDS_TSAN, or -fsanitize=thread).
+ * In every round several producers post bursts of messages at once, a
+ * quarter of them control messages and the rest droppable, to a consumer
+ * that is slow from time to time, so the queue fills up and the consumer
+ * goes to sleep and is woken up many times. It checks that:
+ *
+ * - every control message is delivered, and the messages of each producer
+ *   are delivered in the order they were posted
+ * - every message posted is either delivered or discarded
+ * - the consumer never misses a wake up: after each round the queue is
+ *   emptied without any other message being posted
+ *
+ * Usage: publisher_stress [rounds] [producers]
+ * It exits with 1 if a check fails
+ **/
+
+#define DEFAULT_ROUNDS 200
+#define DEFAULT_PRODUCERS 8
+#define BURST_MESSAGES 500
+#define STRESS_QUEUE_LIMIT 256
+
+/**
+ * The time (MILLISECONDS) the queue has to be emptied after a round. A
+ * consumer sleeping with messages in the queue does not empty it
+ **/
+#define DRAIN_TIMEOUT_MS 2000
+
+/**
+ * The state of the messages of each producer seen by the consumer (only the
+ * consumer thread touches it)
+ **/
+struct ProducerState
+{
+	long last;
+	long control;
+	bool ordered;
+};
+
+std::vector<ProducerState> producers;
+
+void deliver(const std::string &topic, const std::string &payload)
+{
+	size_t p = (size_t)std::atol(topic.c_str() + 1);
+	long sequence = std::atol(payload.c_str());
+	ProducerState &state = producers[p];
+	if (sequence <= state.last)
+	{
+		state.ordered = false;
+	}
+	state.last = sequence;
+	if (sequence % 4 == 0)
+	{
+		state.control++;
+	}
+	// a slow consumer from time to time, so the queue fills up
+	if (sequence % 997 == 0)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+}
+
+/**
+ * Posts a burst of messages numbered from first
+ **/
+void produce(PublisherThread *queue, size_t p, long first, long *discarded)
+{
+	std::string topic = "p" + std::to_string(p);
+	for (long i = first; i < first + BURST_MESSAGES; i++)
+	{
+		bool control = i % 4 == 0;
+		if (!queue->post(topic, std::to_string(i), !control))
+		{
+			(*discarded)++;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = argc > 1 ? std::atoi(argv[1]) : DEFAULT_ROUNDS;
+	size_t count = argc > 2 ? (size_t)std::atoi(argv[2]) : DEFAULT_PRODUCERS;
+	producers = std::vector<ProducerState>(count, ProducerState{-1, 0, true});
+
+	PublisherThread queue;
+	queue.set_limit(STRESS_QUEUE_LIMIT);
+	queue.start(deliver);
+
+	std::vector<long> discarded = std::vector<long>(count, 0);
+	long lost_wakeups = 0;
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		std::vector<std::thread> threads;
+		for (size_t p = 0; p < count; p++)
+		{
+			threads.push_back(std::thread(produce, &queue, p, (long)r * BURST_MESSAGES, &discarded[p]));
+		}
+		for (std::thread &t : threads)
+		{
+			t.join();
+		}
+
+		std::chrono::steady_clock::time_point deadline =
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(DRAIN_TIMEOUT_MS);
+		while (queue.delivered.load() != queue.posted.load() && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		if (queue.delivered.load() != queue.posted.load())
+		{
+			lost_wakeups++;
+		}
+	}
+	queue.stop();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	bool ok = lost_wakeups == 0;
+	long total_discarded = 0;
+	long expected_control = (long)rounds * BURST_MESSAGES / 4;
+	for (size_t p = 0; p < count; p++)
+	{
+		total_discarded += discarded[p];
+		if (!producers[p].ordered || producers[p].control != expected_control)
+		{
+			std::cout << "producer " << p << ": " << producers[p].control << " of " << expected_control
+					  << " control messages delivered" << (producers[p].ordered ? "" : ", out of order") << std::endl;
+			ok = false;
+		}
+	}
+	long attempted = (long)rounds * BURST_MESSAGES * count;
+	if (queue.posted.load() + total_discarded != attempted || queue.discarded.load() != total_discarded)
+	{
+		std::cout << "posted " << queue.posted.load() << " + discarded " << total_discarded << " != "
+				  << attempted << " messages" << std::endl;
+		ok = false;
+	}
+
+	std::cout << "publisher_stress: " << count << " producers, " << attempted << " messages in " << seconds
+			  << " s: " << queue.delivered.load() << " delivered, " << total_discarded << " discarded, queue "
+			  << queue.max_queued.load() << " messages at most, " << lost_wakeups << " lost wake ups: "
+			  << (ok ? "OK" : "FAILED") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include "../impl/recorder-impls.cpp"
+
+/**
+ * Exports the samples of recording files (see EncoderRecorder) in a time
+ * window as CSV (one line per sample: time in microseconds since the epoch
+ * followed by the counters of each joint) or JSON (an array of objects
+ * {"time": ..., "counts": [...]}) to the standard output.
+ *
+ * Usage: recorder_export [--from <seconds>] [--to <seconds>] [--format csv|json] files...
+ * where the times are seconds since the epoch and files are given from the
+ * oldest to the newest (e.g. recording.*.rec sorted by number)
+ **/
+
+int main(int argc, char *argv[])
+{
+	int64_t from_us = std::numeric_limits<int64_t>::min();
+	int64_t to_us = std::numeric_limits<int64_t>::max();
+	bool json_format = false;
+	std::vector<const char *> files;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+		{
+			from_us = (int64_t)(atof(argv[++i]) * 1e6);
+		}
+		else if (std::strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+		{
+			to_us = (int64_t)(atof(argv[++i]) * 1e6);
+		}
+		else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			json_format = std::strcmp(argv[++i], "json") == 0;
+		}
+		else
+		{
+			files.push_back(argv[i]);
+		}
+	}
+	if (files.empty())
+	{
+		std::cerr << "Usage: recorder_export [--from <seconds>] [--to <seconds>] [--format csv|json] files..." << std::endl;
+		return 1;
+	}
+
+	bool first = true;
+	if (json_format)
+	{
+		printf("[\n");
+	}
+	else
+	{
+		printf("time");
+		for (int j = 1; j <= RECORDER_JOINTS; j++)
+		{
+			printf(",J%d", j);
+		}
+		printf("\n");
+	}
+
+	std::vector<int64_t> times;
+	std::vector<int32_t> counts;
+	for (const char *name : files)
+	{
+		FILE *file = fopen(name, "rb");
+		RecordingHeader header;
+		if (file == NULL || !read_recording_header(file, header))
+		{
+			std::cerr << "Skipping " << name << ": not a recording file" << std::endl;
+			if (file != NULL)
+			{
+				fclose(file);
+			}
+			continue;
+		}
+
+		// a truncated last block (the server was killed while writing) ends the file
+		while (read_recording_block(file, header, from_us, to_us, times, counts))
+		{
+			size_t count = times.size();
+			for (size_t i = 0; i < count; i++)
+			{
+				if (times[i] < from_us || times[i] > to_us)
+				{
+					continue;
+				}
+				if (json_format)
+				{
+					printf("%s{\"time\":%lld,\"counts\":[", first ? "" : ",\n", (long long)times[i]);
+					for (size_t j = 0; j < header.joints; j++)
+					{
+						printf("%s%d", j == 0 ? "" : ",", counts[j * count + i]);
+					}
+					printf("]}");
+				}
+				else
+				{
+					printf("%lld", (long long)times[i]);
+					for (size_t j = 0; j < header.joints; j++)
+					{
+						printf(",%d", counts[j * count + i]);
+					}
+					printf("\n");
+				}
+				first = false;
+			}
+		}
+		fclose(file);
+	}
+
+	if (json_format)
+	{
+		printf("\n]\n");
+	}
+	return 0;
+}
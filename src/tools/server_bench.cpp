@@ -0,0 +1,723 @@
+#include <iostream>
+#include <vector>
+#include <list>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include "../impl/server-impls.cpp"
+#include "../impl/motion-impls.cpp"
+#include "../impl/planner-impls.cpp"
+#include "../impl/kinematics-impls.cpp"
+#include "../impl/recorder-impls.cpp"
+#include "../impl/wire-impls.cpp"
+#include "../impl/stream-impls.cpp"
+#include "../impl/arena-impls.cpp"
+#include "../include/EDScorbot.hpp"
+
+/**
+ * Throughput benchmarks of the processing stages of the server, without
+ * broker nor clients.
+ *
+ * Usage: server_bench [benchmark] [recording file]
+ * where benchmark is one of: retime, fk, ik, model, codec, messages, stream,
+ * simplify, sendref (all of them if omitted). The codec benchmark uses the joints of a recording file (option
+ * --record of simulated_server) if given, or a random trajectory
+ **/
+
+#define BENCH_POINTS 1000
+#define BENCH_REPETITIONS 200
+
+/**
+ * Builds a smooth random trajectory with the given number of points,
+ * inside the limits of the joints of the arm
+ **/
+std::list<Point> random_trajectory(size_t points, unsigned seed)
+{
+	std::vector<JointInfo> joints = joint_limits();
+	std::mt19937 random(seed);
+	std::normal_distribution<double> step(0.0, 0.5);
+	std::list<Point> result;
+	std::vector<double> q = std::vector<double>(joints.size(), 0.0);
+	std::vector<double> v = std::vector<double>(joints.size(), 0.0);
+	for (size_t i = 0; i < points; i++)
+	{
+		for (size_t j = 0; j < joints.size(); j++)
+		{
+			double low = std::min(joints[j].minimum, joints[j].maximum);
+			double high = std::max(joints[j].minimum, joints[j].maximum);
+			v[j] = 0.9 * v[j] + step(random);
+			q[j] = std::max(low, std::min(high, q[j] + v[j]));
+		}
+		result.push_back(Point(q));
+	}
+	return result;
+}
+
+/**
+ * Prints the time per operation and the throughput of a benchmark
+ **/
+void report(const char *name, double seconds, double operations, const char *unit)
+{
+	std::cout << name << ": " << seconds * 1e6 / operations << " us per " << unit
+			  << ", " << operations / seconds << " " << unit << "s/s" << std::endl;
+}
+
+/**
+ * Retiming of trajectories (retime_trajectory) of BENCH_POINTS points
+ **/
+void bench_retime()
+{
+	FlatTrajectory points = FlatTrajectory::from_points(random_trajectory(BENCH_POINTS, 7));
+	std::vector<JointInfo> limits = joint_limits();
+	std::vector<double> start = std::vector<double>(limits.size(), 0.0);
+	TrajectoryTiming timing;
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < BENCH_REPETITIONS; i++)
+	{
+		retime_trajectory(start, points, limits, DEFAULT_BLEND_TOLERANCE, timing);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	std::cout << "retime (" << BENCH_POINTS << " points): blended " << timing.total
+			  << " s, point to point " << timing.point_to_point_total << " s" << std::endl;
+	report("retime", seconds, BENCH_REPETITIONS, "trajectory");
+}
+
+/**
+ * Copies the joints J1..J5 of a trajectory column by column (all values of
+ * J1, then all values of J2, ...) as expected by forward_kinematics_batch
+ **/
+std::vector<double> joint_columns(const std::list<Point> &points)
+{
+	std::vector<double> columns = std::vector<double>(KIN_JOINTS * points.size());
+	size_t i = 0;
+	for (const Point &p : points)
+	{
+		for (size_t j = 0; j < KIN_JOINTS; j++)
+		{
+			columns[j * points.size() + i] = p.coordinates[j];
+		}
+		i++;
+	}
+	return columns;
+}
+
+/**
+ * Forward kinematics of trajectories of BENCH_POINTS points, point by point
+ * (forward_kinematics) and as a whole (forward_kinematics_batch)
+ **/
+void bench_fk()
+{
+	std::list<Point> points = random_trajectory(BENCH_POINTS, 7);
+	std::vector<double> columns = joint_columns(points);
+	std::vector<double> poses = std::vector<double>(KIN_POSE * BENCH_POINTS);
+	double checksum = 0.0;
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < BENCH_REPETITIONS; i++)
+	{
+		size_t k = 0;
+		for (const Point &p : points)
+		{
+			forward_kinematics(p.coordinates.data(), &poses[KIN_POSE * k++]);
+		}
+		checksum += poses[0];
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("fk", seconds, (double)BENCH_REPETITIONS * BENCH_POINTS, "pose");
+
+	begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < BENCH_REPETITIONS; i++)
+	{
+		forward_kinematics_batch(columns.data(), BENCH_POINTS, poses.data());
+		checksum += poses[0];
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("fk batch", seconds, (double)BENCH_REPETITIONS * BENCH_POINTS, "pose");
+
+	// keeps the compiler from removing the loops
+	if (checksum == 0.0)
+	{
+		std::cout << std::endl;
+	}
+}
+
+/**
+ * Inverse kinematics of the poses of a trajectory of BENCH_POINTS points,
+ * each solve starting from the solution of the previous point (warm) or
+ * always from the same configuration (cold)
+ **/
+void bench_ik()
+{
+	std::list<Point> points = random_trajectory(BENCH_POINTS, 7);
+	std::vector<double> columns = joint_columns(points);
+	std::vector<double> pose_columns = std::vector<double>(KIN_POSE * BENCH_POINTS);
+	forward_kinematics_batch(columns.data(), BENCH_POINTS, pose_columns.data());
+
+	std::vector<double> poses = std::vector<double>(KIN_POSE * BENCH_POINTS);
+	for (size_t i = 0; i < BENCH_POINTS; i++)
+	{
+		for (size_t k = 0; k < KIN_POSE; k++)
+		{
+			poses[KIN_POSE * i + k] = pose_columns[k * BENCH_POINTS + i];
+		}
+	}
+
+	const char *names[] = {"ik warm", "ik cold"};
+	for (int warm = 1; warm >= 0; warm--)
+	{
+		long iterations = 0;
+		long failures = 0;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < BENCH_REPETITIONS; r++)
+		{
+			double joints[KIN_JOINTS] = {0.0, 30.0, -60.0, 0.0, 0.0};
+			for (size_t i = 0; i < BENCH_POINTS; i++)
+			{
+				if (!warm)
+				{
+					double initial[KIN_JOINTS] = {0.0, 30.0, -60.0, 0.0, 0.0};
+					std::copy(initial, initial + KIN_JOINTS, joints);
+				}
+				int n = 0;
+				if (!inverse_kinematics(&poses[KIN_POSE * i], joints, &n))
+				{
+					failures++;
+				}
+				iterations += n;
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		double solves = (double)BENCH_REPETITIONS * BENCH_POINTS;
+
+		std::cout << names[1 - warm] << ": " << iterations / solves << " iterations per solve, "
+				  << failures << " failures" << std::endl;
+		report(names[1 - warm], seconds, solves, "solve");
+	}
+}
+
+/**
+ * Conversion of positions into references and parsing of points, with the
+ * runtime sized Point and per joint switch (angle_to_ref) against the fixed
+ * size paths of the model of the arm (EDScorbotModel). Both paths must give
+ * the same references and coordinates: it returns false if they differ
+ **/
+bool bench_model()
+{
+	std::list<Point> points = random_trajectory(BENCH_POINTS, 11);
+	std::vector<std::string> payloads;
+	for (Point p : points)
+	{
+		payloads.push_back(p.to_json().dump());
+	}
+
+	long checksum = 0;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		for (const Point &p : points)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				checksum += angle_to_ref(j + 1, p.coordinates[j]);
+			}
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("refs runtime", seconds, (double)BENCH_REPETITIONS * BENCH_POINTS, "point");
+
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		for (const Point &p : points)
+		{
+			EDScorbotModel::Joints position;
+			EDScorbotModel::from_coordinates(p.coordinates, position);
+			EDScorbotModel::References refs = EDScorbotModel::to_refs(position);
+			for (int j = 0; j < 4; j++)
+			{
+				checksum -= refs[j];
+			}
+		}
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("refs model", seconds, (double)BENCH_REPETITIONS * BENCH_POINTS, "point");
+
+	// the coordinates are added in the same order, so equal coordinates give equal sums
+	double runtime_sum = 0;
+	double model_sum = 0;
+	begin = std::chrono::steady_clock::now();
+	for (const std::string &payload : payloads)
+	{
+		Point p = Point::from_json_string(payload);
+		runtime_sum += p.coordinates[0];
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("parse runtime", seconds, BENCH_POINTS, "point");
+
+	begin = std::chrono::steady_clock::now();
+	for (const std::string &payload : payloads)
+	{
+		EDScorbotModel::Joints position;
+		EDScorbotModel::parse_point(json::parse(payload), position);
+		model_sum += position[0];
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("parse model", seconds, BENCH_POINTS, "point");
+
+	bool same = checksum == 0 && runtime_sum == model_sum;
+	std::cout << "model differences: references " << checksum << ", coordinates " << runtime_sum - model_sum << ": "
+			  << (same ? "OK" : "FAILED") << std::endl;
+	return same;
+}
+
+/**
+ * Reads the joints of (at most) the first max_points samples of a recording
+ * file as a trajectory
+ **/
+std::list<Point> recorded_trajectory(const char *path, size_t max_points)
+{
+	std::list<Point> result;
+	FILE *file = fopen(path, "rb");
+	RecordingHeader header;
+	if (file == NULL || !read_recording_header(file, header))
+	{
+		std::cerr << "Cannot read recording " << path << std::endl;
+		if (file != NULL)
+		{
+			fclose(file);
+		}
+		return result;
+	}
+	std::vector<int64_t> times;
+	std::vector<int32_t> counts;
+	while (result.size() < max_points && read_recording_block(file, header, INT64_MIN, INT64_MAX, times, counts))
+	{
+		// the counts are stored by columns (joint by joint)
+		for (size_t i = 0; i < times.size() && result.size() < max_points; i++)
+		{
+			std::vector<double> coordinates = std::vector<double>(EDScorbotModel::joints, 0.0);
+			for (size_t j = 0; j < EDScorbotModel::joints && j < header.joints; j++)
+			{
+				coordinates[j] = EDScorbotModel::ref_to_angle(j, counts[j * times.size() + i]);
+			}
+			result.push_back(Point(coordinates));
+		}
+	}
+	fclose(file);
+	return result;
+}
+
+/**
+ * Size and decoding time of trajectories encoded as JSON and with the
+ * compact codec (delta-varint)
+ **/
+void bench_codec(const char *recording)
+{
+	CommandObject command = CommandObject(ARM_APPLY_TRAJECTORY);
+	command.client = Client("bench");
+	command.trajectory.points = recording != NULL ? recorded_trajectory(recording, 100 * BENCH_POINTS)
+												  : random_trajectory(BENCH_POINTS, 13);
+	size_t points = command.trajectory.points.size();
+	if (points == 0)
+	{
+		return;
+	}
+
+	std::string text = command.to_json().dump();
+	std::string encoded;
+	CodecInfo codec = compact_codec();
+	encode_command(command, codec, encoded);
+	std::cout << "codec: " << points << " points, JSON " << text.size() << " bytes ("
+			  << (double)text.size() / points << " per point), encoded " << encoded.size() << " bytes ("
+			  << (double)encoded.size() / points << " per point), " << (double)text.size() / encoded.size()
+			  << " times smaller" << std::endl;
+
+	int repetitions = std::max(1, (int)(BENCH_REPETITIONS * BENCH_POINTS / 10 / points));
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		CommandObject decoded = CommandObject::from_json_string(text);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("decode JSON", seconds, (double)repetitions * points, "point");
+
+	CommandObject decoded = CommandObject(ARM_CHECK_STATUS);
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		decoded = CommandObject(ARM_CHECK_STATUS);
+		decode_command(encoded.data(), encoded.size(), decoded);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("decode codec", seconds, (double)repetitions * points, "point");
+
+	// the quantization error is at most half the resolution of each joint
+	double worst = 0.0;
+	std::list<Point>::const_iterator original = command.trajectory.points.begin();
+	for (const Point &p : decoded.trajectory.points)
+	{
+		for (size_t j = 0; j < p.coordinates.size(); j++)
+		{
+			worst = std::max(worst, std::fabs(p.coordinates[j] - original->coordinates[j]) / codec.resolution[j]);
+		}
+		++original;
+	}
+	std::cout << "codec: largest quantization error " << worst << " resolutions" << std::endl;
+}
+
+/**
+ * Encodes and decodes a message with nlohmann::json and with the encoders
+ * generated from the AsyncAPI document, and checks both give the same JSON
+ **/
+template <typename T>
+void bench_message(const char *name, T &message, int repetitions)
+{
+	std::string text = message.to_json().dump();
+	std::string generated = wire_encode(message);
+	T decoded = message;
+	bool same = json::parse(text) == json::parse(generated) && wire_decode(text.data(), text.size(), decoded) &&
+				json::parse(wire_encode(decoded)) == json::parse(text);
+	std::cout << "messages: " << name << ", " << text.size() << " bytes, "
+			  << (same ? "same JSON" : "DIFFERENT JSON") << std::endl;
+
+	std::string label = std::string(name) + " encode json";
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		text = message.to_json().dump();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report(label.c_str(), seconds, repetitions, "message");
+
+	label = std::string(name) + " encode generated";
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		generated = wire_encode(message);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report(label.c_str(), seconds, repetitions, "message");
+
+	label = std::string(name) + " decode json";
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		decoded = T::from_json_string(text);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report(label.c_str(), seconds, repetitions, "message");
+
+	label = std::string(name) + " decode generated";
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		wire_decode(text.data(), text.size(), decoded);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report(label.c_str(), seconds, repetitions, "message");
+}
+
+void bench_messages()
+{
+	MovedObject moved = MovedObject(Point({10.5, -20.25, 30.0, 0.125, 0.0, 50.0}));
+	moved.client = Client("bench");
+	bench_message("moved", moved, 100 * BENCH_REPETITIONS);
+
+	ProgressObject progress = ProgressObject(120, BENCH_POINTS, 1.2, 8.8, 0.05);
+	progress.client = Client("bench");
+	bench_message("progress", progress, 100 * BENCH_REPETITIONS);
+
+	CommandObject command = CommandObject(ARM_APPLY_TRAJECTORY);
+	command.client = Client("bench");
+	command.trajectory.points = random_trajectory(BENCH_POINTS, 17);
+	bench_message("trajectory", command, BENCH_REPETITIONS / 10);
+}
+
+/**
+ * Bytes taken by a list of points: a node per point (its links and the Point)
+ * plus the coordinates of each point. The overhead of the allocator is left out
+ **/
+size_t list_bytes(const std::list<Point> &points)
+{
+	size_t bytes = 0;
+	for (const Point &p : points)
+	{
+		bytes += 2 * sizeof(void *) + sizeof(Point) + p.coordinates.capacity() * sizeof(double);
+	}
+	return bytes;
+}
+
+/**
+ * Decoding of a command with a trajectory of 50 * BENCH_POINTS points: the
+ * memory of the document of nlohmann::json (measured in an arena big enough
+ * to hold it) against the flat buffer of stream_command, and the time of the
+ * decoders. The executor takes the flat buffer (trimmed to its points), so
+ * it is what stays resident while the trajectory runs. The list of points
+ * built by the other decoders is reported too
+ **/
+void bench_stream()
+{
+	CommandObject command = CommandObject(ARM_APPLY_TRAJECTORY);
+	command.client = Client("bench");
+	command.trajectory.points = random_trajectory(50 * BENCH_POINTS, 19);
+	size_t points = command.trajectory.points.size();
+	std::string text = wire_encode(command);
+
+	MessageArena arena = MessageArena(64 * text.size());
+	size_t document_bytes;
+	{
+		ArenaScope scope(&arena);
+		arena_json parsed = arena_json::parse(text.data(), text.data() + text.size(), nullptr, false);
+		document_bytes = arena.used();
+	}
+	FlatTrajectory flat = FlatTrajectory();
+	CommandObject streamed = CommandObject(ARM_CHECK_STATUS);
+	bool ok = stream_command(text.data(), text.size(), streamed, flat);
+	size_t flat_bytes = flat.coordinates.capacity() * sizeof(double);
+	streamed.trajectory.points.clear();
+	flat.to_points(streamed.trajectory.points);
+	std::cout << "stream: " << points << " points, payload " << text.size() << " bytes, document "
+			  << document_bytes << " bytes, flat buffer " << flat_bytes << " bytes, list of points "
+			  << list_bytes(streamed.trajectory.points) << " bytes"
+			  << (ok && streamed == command ? "" : ", DIFFERENT COMMAND") << std::endl;
+
+	int repetitions = std::max(1, BENCH_REPETITIONS / 50);
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		CommandObject decoded = CommandObject::from_json_string(text);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("decode document", seconds, (double)repetitions * points, "point");
+
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		CommandObject decoded = CommandObject(ARM_CHECK_STATUS);
+		stream_command(text.data(), text.size(), decoded, flat);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("decode stream", seconds, (double)repetitions * points, "point");
+
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		CommandObject decoded = CommandObject(ARM_CHECK_STATUS);
+		stream_command(text.data(), text.size(), decoded, flat);
+		flat.to_points(decoded.trajectory.points);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("decode stream into points", seconds, (double)repetitions * points, "point");
+
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < repetitions; r++)
+	{
+		ArenaScope scope(&arena);
+		arena_json parsed = arena_json::parse(text.data(), text.data() + text.size(), nullptr, false);
+		CommandObject decoded = CommandObject(ARM_CHECK_STATUS);
+		command_from_json(parsed, decoded);
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("decode arena into points", seconds, (double)repetitions * points, "point");
+}
+
+/**
+ * Simplification (simplify_trajectory) of a trajectory like the ones recorded
+ * by teach-in tools: BENCH_POINTS / 10 waypoints sampled 50 times per segment,
+ * with noise of the encoders. For several tolerances it gives the points
+ * kept, the time to simplify and the estimated execution times
+ **/
+void bench_simplify()
+{
+	std::list<Point> waypoints = random_trajectory(BENCH_POINTS / 10, 23);
+	std::vector<JointInfo> limits = joint_limits();
+	std::vector<double> start = std::vector<double>(limits.size(), 0.0);
+	std::mt19937 random(29);
+	std::normal_distribution<double> noise(0.0, 0.02);
+	FlatTrajectory recorded = FlatTrajectory();
+	recorded.joints = waypoints.front().coordinates.size();
+	std::vector<double> previous = waypoints.front().coordinates;
+	for (const Point &w : waypoints)
+	{
+		for (int k = 1; k <= 50; k++)
+		{
+			std::vector<double> q = previous;
+			for (size_t j = 0; j < q.size(); j++)
+			{
+				q[j] += (w.coordinates[j] - previous[j]) * k / 50.0 + noise(random);
+			}
+			recorded.coordinates.insert(recorded.coordinates.end(), q.begin(), q.end());
+		}
+		previous = w.coordinates;
+	}
+
+	TrajectoryTiming timing;
+	retime_trajectory(start, recorded, limits, DEFAULT_BLEND_TOLERANCE, timing);
+	std::cout << "simplify: " << recorded.size() << " points, estimated " << timing.total << " s blended, "
+			  << timing.point_to_point_total << " s point to point" << std::endl;
+
+	double tolerances[] = {0.1, 0.5, 1.0};
+	for (bool timed : {false, true})
+	{
+		for (double tolerance : tolerances)
+		{
+			FlatTrajectory points;
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			for (int r = 0; r < BENCH_REPETITIONS / 20; r++)
+			{
+				points = recorded;
+				simplify_trajectory(points, std::vector<double>(1, tolerance), timed);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			retime_trajectory(start, points, limits, DEFAULT_BLEND_TOLERANCE, timing);
+			std::cout << "  tolerance " << tolerance << (timed ? " timed" : "") << ": " << points.size()
+					  << " points kept in " << seconds * 1e3 / (BENCH_REPETITIONS / 20) << " ms, estimated "
+					  << timing.total << " s blended, " << timing.point_to_point_total << " s point to point"
+					  << std::endl;
+		}
+	}
+}
+
+/**
+ * The joint as it was before JointController: the values of the controller
+ * in a map looked up by name, the address looked up by motor name, and the
+ * joint passed by value (copying the map) to EDScorbot::sendRef
+ **/
+struct MappedJoint
+{
+	std::thread *t;
+	int address;
+	int jnum;
+	std::string id;
+	std::map<std::string, int> controller = {
+		{"EI_FD_bank3_18bits", 0},
+		{"PD_FD_bank3_22bits", 0},
+		{"PI_FD_bank3_18bits", 0},
+		{"leds", 0},
+		{"ref", 0},
+		{"spike_expansor", 0}};
+};
+
+std::map<std::string, int> mapped_addresses = {
+	{"M1", 0x00}, {"M2", 0x20}, {"M3", 0x40}, {"M4", 0x60}, {"M5", 0x80}, {"M6", 0xA0}};
+
+/**
+ * A write of the memory mapped interface as sendCommand16 does it
+ **/
+inline int write_command16(uint8_t address, uint8_t b1, uint8_t b2, volatile int *mem)
+{
+	*mem = (address << 16) | (b1 << 8) | b2;
+	return 0;
+}
+
+__attribute__((noinline)) int mapped_send_ref(int ref, MappedJoint j, volatile int *mem)
+{
+	j.controller["ref"] = ref;
+	int address = mapped_addresses[j.id] + REF_ADDR;
+	return write_command16(address, (ref >> 8) & 0xFF, ref & 0xFF, mem);
+}
+
+__attribute__((noinline)) int flat_send_ref(int ref, EDScorbotJoint &j, volatile int *mem)
+{
+	j.controller.ref = ref;
+	return write_command16(j.address + JointController::ref_offset, (ref >> 8) & 0xFF, ref & 0xFF, mem);
+}
+
+/**
+ * Overhead of EDScorbot::sendRef (without the access to the FPGA) with the
+ * joints of the arm as they were (MappedJoint) and with JointController,
+ * sending the references of a trajectory of BENCH_POINTS points
+ **/
+void bench_sendref()
+{
+	std::list<Point> points = random_trajectory(BENCH_POINTS, 13);
+	std::vector<int> refs;
+	for (const Point &p : points)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			refs.push_back(angle_to_ref(j + 1, p.coordinates[j]));
+		}
+	}
+	volatile int mem = 0;
+
+	std::vector<MappedJoint> mapped(4);
+	for (int j = 0; j < 4; j++)
+	{
+		mapped[j].jnum = j + 1;
+		mapped[j].id = "M" + std::to_string(j + 1);
+		mapped[j].address = mapped_addresses[mapped[j].id];
+	}
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		for (size_t i = 0; i < refs.size(); i++)
+		{
+			mapped_send_ref(refs[i], mapped[i % 4], &mem);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("sendRef mapped", seconds, (double)BENCH_REPETITIONS * refs.size(), "ref");
+
+	std::vector<EDScorbotJoint> flat = {{"M1", 1}, {"M2", 2}, {"M3", 3}, {"M4", 4}};
+	begin = std::chrono::steady_clock::now();
+	for (int r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		for (size_t i = 0; i < refs.size(); i++)
+		{
+			flat_send_ref(refs[i], flat[i % 4], &mem);
+		}
+	}
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	report("sendRef flat", seconds, (double)BENCH_REPETITIONS * refs.size(), "ref");
+	std::cout << "sizeof joint: mapped " << sizeof(MappedJoint) << " bytes (+ " << mapped[0].controller.size()
+			  << " map nodes), flat " << sizeof(EDScorbotJoint) << " bytes" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *selected = argc > 1 ? argv[1] : NULL;
+	bool ok = true;
+
+	if (selected == NULL || std::strcmp(selected, "retime") == 0)
+	{
+		bench_retime();
+	}
+	if (selected == NULL || std::strcmp(selected, "fk") == 0)
+	{
+		bench_fk();
+	}
+	if (selected == NULL || std::strcmp(selected, "ik") == 0)
+	{
+		bench_ik();
+	}
+	if (selected == NULL || std::strcmp(selected, "model") == 0)
+	{
+		ok = bench_model() && ok;
+	}
+	if (selected == NULL || std::strcmp(selected, "codec") == 0)
+	{
+		bench_codec(argc > 2 ? argv[2] : NULL);
+	}
+	if (selected == NULL || std::strcmp(selected, "messages") == 0)
+	{
+		bench_messages();
+	}
+	if (selected == NULL || std::strcmp(selected, "stream") == 0)
+	{
+		bench_stream();
+	}
+	if (selected == NULL || std::strcmp(selected, "simplify") == 0)
+	{
+		bench_simplify();
+	}
+	if (selected == NULL || std::strcmp(selected, "sendref") == 0)
+	{
+		bench_sendref();
+	}
+
+	return ok ? 0 : 1;
+}
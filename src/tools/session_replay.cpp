@@ -0,0 +1,122 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+
+// the replay runs the whole server (without its main) to feed message_callback
+#define main simulated_server_main
+#include "../mqtt_server/simulated_server.cpp"
+#undef main
+
+/**
+ * Replays a capture of the messages received by the server (option
+ * --capture of simulated_server) through message_callback, without broker
+ * nor clients, and reports the throughput and the processing time of each
+ * message. Messages published by the server are discarded (there is no
+ * connection to a broker).
+ *
+ * Usage: session_replay [--fast] [--message-arena <bytes>] <capture file>
+ * --fast  replays as fast as possible instead of at the original timing
+ * --message-arena <bytes>  size of the arena where messages are parsed (0 = heap)
+ **/
+
+/**
+ * Prints minimum, average, percentiles 50 and 99 and maximum of a set of samples
+ **/
+void print_statistics(const char *name, const char *unit, std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	double sum = 0;
+	for (double s : samples)
+	{
+		sum += s;
+	}
+	size_t p50 = samples.size() / 2;
+	size_t p99 = std::min(samples.size() - 1, (size_t)(samples.size() * 0.99));
+	std::cout << name
+			  << " min " << samples.front() << unit
+			  << " avg " << sum / samples.size() << unit
+			  << " p50 " << samples[p50] << unit
+			  << " p99 " << samples[p99] << unit
+			  << " max " << samples.back() << unit
+			  << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	bool fast = false;
+	const char *path = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--fast") == 0)
+		{
+			fast = true;
+		}
+		else if (std::strcmp(argv[i], "--message-arena") == 0 && i + 1 < argc)
+		{
+			message_arena_size = atol(argv[++i]);
+		}
+		else
+		{
+			path = argv[i];
+		}
+	}
+	FILE *file = path == NULL ? NULL : fopen(path, "rb");
+	CaptureHeader header;
+	if (file == NULL || !read_capture_header(file, header))
+	{
+		std::cerr << "Usage: session_replay [--fast] [--message-arena <bytes>] <capture file>" << std::endl;
+		return 1;
+	}
+
+	mosquitto_lib_init();
+	mosq = mosquitto_new("session_replay", true, NULL);
+	build_topics();
+	configure_publisher();
+	publisher_thread.start(deliver_message);
+
+	std::vector<double> processing;
+	CapturedMessage captured;
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	while (read_captured_message(file, captured))
+	{
+		if (!fast)
+		{
+			std::this_thread::sleep_until(started + std::chrono::microseconds(captured.time_us));
+		}
+
+		// mosquitto delivers payloads terminated with '\0' (std::string is)
+		struct mosquitto_message message;
+		memset(&message, 0, sizeof(message));
+		message.topic = &captured.topic[0];
+		message.payload = &captured.payload[0];
+		message.payloadlen = captured.payload.size();
+
+		std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+		message_callback(mosq, NULL, &message);
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - before;
+		processing.push_back(elapsed.count());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	fclose(file);
+	publisher_thread.stop();
+
+	std::cout << "Replayed " << processing.size() << " messages in " << seconds << " s ("
+			  << processing.size() / seconds << " messages/s)" << std::endl;
+	print_statistics("processing", " us", processing);
+	std::cout << "Publisher: " << publisher.to_json().dump() << std::endl;
+	std::cout << "Messages: " << message_stats.to_json().dump() << std::endl;
+
+	// stops a trajectory still being executed before leaving
+	arm_motion.cancel();
+	mosquitto_destroy(mosq);
+	mosquitto_lib_cleanup();
+	return 0;
+}